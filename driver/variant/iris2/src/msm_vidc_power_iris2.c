@@ -10,11 +10,20 @@
 #include "msm_vidc_debug.h"
 #include "msm_vidc_dt.h"
 
+/*
+ * Decoder input sizes change every frame, the model cache is keyed on
+ * them rounded up so only real bitrate changes rerun the models. The
+ * models themselves always run on the raw values.
+ */
+#define MODEL_DATA_SIZE_ALIGN SZ_4K
+#define MODEL_BITRATE_ALIGN (MODEL_DATA_SIZE_ALIGN * 8)
+
 u64 msm_vidc_calc_freq_iris2(struct msm_vidc_inst *inst, u32 data_size)
 {
 	u64 freq = 0;
 	struct msm_vidc_core* core;
 	struct msm_vidc_power* power;
+	struct msm_vidc_power_model *model;
 	u64 vsp_cycles = 0, vpp_cycles = 0, fw_cycles = 0;
 	u64 fw_vpp_cycles = 0, bitrate = 0;
 	u32 vpp_cycles_per_mb;
@@ -23,7 +32,7 @@ u64 msm_vidc_calc_freq_iris2(struct msm_vidc_inst *inst, u32 data_size)
 	u32 base_cycles = 0;
 	u32 fps;
 	u32 prio_val;
-	u32 buf_timetamps_fps, mbpf;
+	u32 buf_timetamps_fps, mbpf, key_size;
 
 	if (!inst || !inst->core || !inst->capabilities) {
 		d_vpr_e("%s: invalid params\n", __func__);
@@ -59,6 +68,15 @@ u64 msm_vidc_calc_freq_iris2(struct msm_vidc_inst *inst, u32 data_size)
 		inst->priority_level = MSM_VIDC_PRIORITY_LOW;
 	}
 
+	key_size = inst->domain == MSM_VIDC_DECODER ?
+		ALIGN(data_size, MODEL_DATA_SIZE_ALIGN) : 0;
+
+	model = &power->model;
+	if (model->freq_valid && model->mbpf == mbpf && model->fps == fps &&
+		model->data_size == key_size &&
+		model->has_bframe == inst->has_bframe)
+		return model->freq;
+
 	mbs_per_second = mbpf * fps;
 
 	/*
@@ -186,6 +204,13 @@ u64 msm_vidc_calc_freq_iris2(struct msm_vidc_inst *inst, u32 data_size)
 	i_vpr_p(inst, "%s: filled len %d, required freq %llu, fps %u, mbpf %u\n",
 		__func__, data_size, freq, fps, mbpf);
 
+	model->mbpf = mbpf;
+	model->fps = fps;
+	model->data_size = key_size;
+	model->has_bframe = inst->has_bframe;
+	model->freq = freq;
+	model->freq_valid = true;
+
 	return freq;
 }
 
@@ -724,15 +749,59 @@ static u64 __calculate(struct msm_vidc_inst* inst, struct vidc_bus_vote_data *d)
 	return value;
 }
 
+/* all model inputs but bitrate, which the caller compares normalized */
+static bool __bus_vote_data_equal(struct vidc_bus_vote_data *a,
+	struct vidc_bus_vote_data *b)
+{
+	return a->domain == b->domain &&
+		a->codec == b->codec &&
+		a->power_mode == b->power_mode &&
+		a->num_formats == b->num_formats &&
+		a->color_formats[0] == b->color_formats[0] &&
+		a->color_formats[1] == b->color_formats[1] &&
+		a->input_height == b->input_height &&
+		a->input_width == b->input_width &&
+		a->output_height == b->output_height &&
+		a->output_width == b->output_width &&
+		a->rotation == b->rotation &&
+		a->compression_ratio == b->compression_ratio &&
+		a->complexity_factor == b->complexity_factor &&
+		a->input_cr == b->input_cr &&
+		a->lcu_size == b->lcu_size &&
+		a->fps == b->fps &&
+		a->work_mode == b->work_mode &&
+		a->use_sys_cache == b->use_sys_cache &&
+		a->b_frames_enabled == b->b_frames_enabled &&
+		a->num_vpp_pipes == b->num_vpp_pipes;
+}
+
 int msm_vidc_calc_bw_iris2(struct msm_vidc_inst *inst,
 		struct vidc_bus_vote_data *vidc_data)
 {
 	int value = 0;
+	int key_bitrate;
+	struct msm_vidc_power_model *model;
 
-	if (!vidc_data)
+	if (!inst || !vidc_data)
 		return value;
 
+	key_bitrate = vidc_data->domain == MSM_VIDC_DECODER ?
+		ALIGN(vidc_data->bitrate, MODEL_BITRATE_ALIGN) :
+		vidc_data->bitrate;
+
+	model = &inst->power.model;
+	if (model->bw_valid && model->bw.bitrate == key_bitrate &&
+		__bus_vote_data_equal(&model->bw, vidc_data)) {
+		vidc_data->calc_bw_ddr = model->bw.calc_bw_ddr;
+		vidc_data->calc_bw_llcc = model->bw.calc_bw_llcc;
+		return value;
+	}
+
 	value = __calculate(inst, vidc_data);
 
+	model->bw = *vidc_data;
+	model->bw.bitrate = key_bitrate;
+	model->bw_valid = true;
+
 	return value;
 }
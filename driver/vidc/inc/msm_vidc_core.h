@@ -7,8 +7,11 @@
 #define _MSM_VIDC_CORE_H_
 
 #include <linux/platform_device.h>
+#include <linux/kfifo.h>
+#include <linux/xarray.h>
 
 #include "msm_vidc_internal.h"
+#include "msm_vidc_memory.h"
 
 struct msm_vidc_core;
 
@@ -49,12 +52,107 @@ struct msm_video_device {
 	struct video_device                    vdev;
 };
 
+/*
+ * Packets which did not fit in cmdq, resubmitted in order once firmware
+ * frees up space. Protected by core->cmdq_lock.
+ */
+struct msm_vidc_cmdq_pending {
+	u8                    *slots;
+	u32                    slot_size;
+	u32                    num_slots;
+	u32                    head;
+	u32                    count;
+	wait_queue_head_t      wait;
+	u64                    queued;
+	u64                    waits;
+	u64                    timeouts;
+};
+
+/*
+ * dbgq is drained by a worker into ring, which has a single writer under
+ * lock and a single reader under read_lock. lock also keeps the queues
+ * alive while dbgq is read.
+ */
+struct msm_vidc_fw_log {
+	struct work_struct     work;
+	struct mutex           lock;
+	struct mutex           read_lock;
+	u8                    *packet;
+	DECLARE_KFIFO_PTR(ring, u8);
+	u64                    dropped;
+};
+
+/*
+ * Internal buffers released by a session stay allocated and mapped here,
+ * per region and size class, for the next session to pick up. Holds at
+ * most max_bytes; emptied when the core is deinitialized.
+ */
+struct msm_vidc_buffer_cache {
+	struct mutex           lock;
+	struct list_head       bucket[MSM_VIDC_REGION_MAX][INTERNAL_BUF_CACHE_CLASSES];
+	u64                    max_bytes;
+	u64                    bytes;
+	u64                    hits;
+	u64                    misses;
+};
+
 struct msm_vidc_core_power {
 	u64 clk_freq;
 	u64 bw_ddr;
 	u64 bw_llcc;
 };
 
+/*
+ * Sum of the clock votes of active sessions, updated by each session as
+ * it votes, under core->lock. list is in vote order, so sessions which
+ * stopped queueing drift to the head and are dropped from there.
+ */
+struct msm_vidc_clk_aggregate {
+	struct list_head       list; /* of inst->power.clk_node */
+	u64                    freq;
+	u32                    incr_count; /* sessions asking dcvs increment */
+	u32                    hold_count; /* sessions not asking decrement */
+	u32                    count;
+};
+
+/*
+ * Clock and bus votes are sent down only when they move away from the
+ * current vote: up by more than up_percent (0, any increase, by default),
+ * or down by more than down_percent and no sooner than down_window_ms
+ * after the last vote. Votes held back are counted as suppressed.
+ */
+struct msm_vidc_vote_filter {
+	u32 up_percent;
+	u32 down_percent;
+	u32 down_window_ms;
+	u64 clk_vote_ns;
+	u64 bus_vote_ns;
+	u64 clk_votes;
+	u64 clk_suppressed;
+	u64 bus_votes;
+	u64 bus_suppressed;
+};
+
+/*
+ * Once the msgq rate crosses rate_threshold msgs/sec the irq thread keeps
+ * polling msgq for up to budget rounds, sleeping interval_us between them,
+ * and re-enables the irq after the queue stays empty for a few rounds.
+ */
+struct msm_vidc_msgq_poll {
+	bool enable;
+	u32 budget;
+	u32 interval_us;
+	u32 idle_rounds;
+	u32 rate_threshold;
+	u32 rate;
+	u64 last_wakeup_ns;
+	u64 interrupts;
+	u64 polls;
+	u64 poll_hits;
+	u64 messages;
+	u32 max_messages;
+};
+
 enum msm_vidc_core_state {
 	MSM_VIDC_CORE_DEINIT       = 0,
 	MSM_VIDC_CORE_INIT_WAIT    = 1,
@@ -67,11 +165,15 @@ struct msm_vidc_core {
 	struct v4l2_device                     v4l2_dev;
 	struct list_head                       instances;
 	struct list_head                       dangling_instances;
+	struct xarray                          session_xa; /* session_id -> inst, rcu lookup */
+	struct kmem_cache                     *pool_cache[MSM_MEM_POOL_MAX];
 	struct dentry                         *debugfs_parent;
 	struct dentry                         *debugfs_root;
 	char                                   fw_version[MAX_NAME_LENGTH];
 	enum msm_vidc_core_state               state;
 	struct mutex                           lock;
+	struct mutex                           cmdq_lock;
+	struct msm_vidc_cmdq_pending           cmdq_pending;
 	struct msm_vidc_dt                    *dt;
 	struct msm_vidc_platform              *platform;
 	u8 __iomem                            *register_base_addr;
@@ -79,6 +181,7 @@ struct msm_vidc_core {
 	u32                                    spur_count;
 	u32                                    reg_count;
 	bool                                   power_enabled;
+	bool                                   cmdq_fastpath;
 	u32                                    codecs_count;
 	struct msm_vidc_core_capability       *capabilities;
 	struct msm_vidc_inst_capability       *inst_caps;
@@ -87,10 +190,23 @@ struct msm_vidc_core {
 	struct msm_vidc_iface_q_info           iface_queues[VIDC_IFACEQ_NUMQ];
 	struct delayed_work                    pm_work;
 	struct workqueue_struct               *pm_workq;
-	struct workqueue_struct               *batch_workq;
+	struct workqueue_struct               *response_workq;
+	struct workqueue_struct               *dbgq_workq;
+	struct msm_vidc_fw_log                 fw_log;
+	struct msm_vidc_buffer_cache           buffer_cache;
+	struct dma_heap                       *dma_heaps[MSM_VIDC_REGION_MAX];
+	struct msm_vidc_mem_stats              mem_stats;
+	u64                                    mem_limit; /* admission, 0: off */
+	u32                                    delayed_unmap_high; /* 0: by res */
+	u32                                    delayed_unmap_low;
+	u32                                    cache_op_types;
+	u32                                    dcvs_policy; /* new sessions */
 	struct delayed_work                    fw_unload_work;
 	struct work_struct                     ssr_work;
 	struct msm_vidc_core_power             power;
+	struct msm_vidc_clk_aggregate          clk_aggr;
+	struct msm_vidc_vote_filter            vote_filter;
+	struct msm_vidc_msgq_poll              msgq_poll;
 	struct msm_vidc_ssr                    ssr;
 	bool                                   smmu_fault_handled;
 	u32                                    skip_pc_count;
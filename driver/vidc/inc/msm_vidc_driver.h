@@ -288,6 +288,8 @@ int msm_vidc_get_internal_buffers(struct msm_vidc_inst *inst,
 	enum msm_vidc_buffer_type buffer_type);
 int msm_vidc_create_internal_buffers(struct msm_vidc_inst *inst,
 		enum msm_vidc_buffer_type buffer_type);
+int msm_vidc_create_internal_buffers_set(struct msm_vidc_inst *inst,
+	const enum msm_vidc_buffer_type *buffer_types, u32 num_types);
 int msm_vidc_queue_internal_buffers(struct msm_vidc_inst *inst,
 		enum msm_vidc_buffer_type buffer_type);
 int msm_vidc_alloc_and_queue_session_internal_buffers(struct msm_vidc_inst *inst,
@@ -352,6 +354,10 @@ int msm_vidc_get_delayed_unmap(struct msm_vidc_inst *inst,
 	struct msm_vidc_map *map);
 int msm_vidc_put_delayed_unmap(struct msm_vidc_inst *inst,
 	struct msm_vidc_map *map);
+void msm_vidc_pin_delayed_unmap(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buf);
+void msm_vidc_unpin_delayed_unmap(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buf);
 void msm_vidc_update_stats(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffer *buf, enum msm_vidc_debugfs_event etype);
 void msm_vidc_stats_handler(struct work_struct *work);
@@ -373,6 +379,15 @@ int msm_vidc_flush_delayed_unmap_buffers(struct msm_vidc_inst *inst,
 		enum msm_vidc_buffer_type type);
 struct msm_vidc_buffer *get_meta_buffer(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffer *vbuf);
+struct msm_vidc_buffer *msm_vidc_find_buffer_by_index(struct msm_vidc_inst *inst,
+	enum msm_vidc_buffer_type type, u32 index);
+struct msm_vidc_buffer *msm_vidc_find_buffer_by_addr(struct msm_vidc_inst *inst,
+	enum msm_vidc_buffer_type type, u64 device_addr, u32 data_offset);
+struct msm_vidc_buffer *msm_vidc_find_ro_buffer(struct msm_vidc_inst *inst,
+	u64 device_addr);
+void msm_vidc_dpb_list_reset(struct msm_vidc_inst *inst);
+bool msm_vidc_is_dpb_buffer(struct msm_vidc_inst *inst,
+	u64 device_addr, u32 data_offset);
 struct msm_vidc_inst *get_inst_ref(struct msm_vidc_core *core,
 		struct msm_vidc_inst *instance);
 struct msm_vidc_inst *get_inst(struct msm_vidc_core *core,
@@ -218,6 +218,7 @@ struct msm_vidc_dt {
 	struct bus_set bus_set;
 	struct reset_set reset_set;
 	struct list_head context_banks;
+	struct context_bank_info *cb_region[MSM_VIDC_REGION_MAX];
 	struct mutex cb_lock;
 	const char *fw_name;
 	int fw_cookie;
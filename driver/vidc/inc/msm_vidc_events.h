@@ -292,6 +292,38 @@ DEFINE_EVENT(msm_vidc_buffer_dma_ops, msm_vidc_dma_buffer,
 	TP_ARGS(buffer_op, dmabuf, size, kvaddr, buf_name, secure, region)
 );
 
+DECLARE_EVENT_CLASS(msm_vidc_memory_usage,
+
+	TP_PROTO(const char *op, s64 size, u64 core_alloc, u64 core_map),
+
+	TP_ARGS(op, size, core_alloc, core_map),
+
+	TP_STRUCT__entry(
+		__field(const char *, op)
+		__field(s64, size)
+		__field(u64, core_alloc)
+		__field(u64, core_map)
+	),
+
+	TP_fast_assign(
+		__entry->op = op;
+		__entry->size = size;
+		__entry->core_alloc = core_alloc;
+		__entry->core_map = core_map;
+	),
+
+	TP_printk(
+		"%s: size %lld, core allocated %llu, core mapped %llu\n",
+		__entry->op, __entry->size, __entry->core_alloc, __entry->core_map)
+);
+
+DEFINE_EVENT(msm_vidc_memory_usage, msm_vidc_memory_usage,
+
+	TP_PROTO(const char *op, s64 size, u64 core_alloc, u64 core_map),
+
+	TP_ARGS(op, size, core_alloc, core_map)
+);
+
 #endif
 
 /* This part must be outside protection */
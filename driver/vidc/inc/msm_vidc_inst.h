@@ -39,6 +39,20 @@ struct msm_vidc_allocations_info {
 	struct msm_vidc_allocations     vpss;
 };
 
+/*
+ * Decoder output maps whose only reference is the delayed unmap one and
+ * which firmware does not hold as read only, least recently used first.
+ */
+struct msm_vidc_map_lru {
+	struct list_head                list;
+	u32                             count;
+	u32                             high;
+	u32                             low;
+	u64                             hits;
+	u64                             misses;
+	u64                             evictions;
+};
+
 struct msm_vidc_mappings_info {
 	struct msm_vidc_mappings        input;
 	struct msm_vidc_mappings        output;
@@ -52,6 +66,8 @@ struct msm_vidc_mappings_info {
 	struct msm_vidc_mappings        dpb;
 	struct msm_vidc_mappings        persist;
 	struct msm_vidc_mappings        vpss;
+	DECLARE_HASHTABLE(index, DMABUF_HASH_BITS); /* all maps, by dmabuf */
+	struct msm_vidc_map_lru         lru;
 };
 
 struct msm_vidc_buffers_info {
@@ -69,6 +85,7 @@ struct msm_vidc_buffers_info {
 	struct msm_vidc_buffers        dpb;
 	struct msm_vidc_buffers        persist;
 	struct msm_vidc_buffers        vpss;
+	struct msm_vidc_buffer_index   index;
 };
 
 enum msm_vidc_inst_state {
@@ -94,6 +111,7 @@ struct msm_vidc_inst {
 	enum msm_vidc_codec_type           codec;
 	void                              *core;
 	struct kref                        kref;
+	struct rcu_head                    rcu;
 	u32                                session_id;
 	u8                                 debug_str[24];
 	void                              *packet;
@@ -125,14 +143,18 @@ struct msm_vidc_inst {
 	struct msm_vidc_subscription_params       subcr_params[MAX_PORT];
 	struct msm_vidc_hfi_frame_info     hfi_frame_info;
 	struct msm_vidc_decode_batch       decode_batch;
+	struct msm_vidc_cmd_batch          cmd_batch;
+	struct msm_vidc_hfi_dispatch       hfi_dispatch;
 	struct msm_vidc_decode_vpp_delay   decode_vpp_delay;
 	struct msm_vidc_session_idle       session_idle;
 	struct delayed_work                response_work;
 	struct delayed_work                stats_work;
-	struct workqueue_struct           *response_workq;
 	struct list_head                   response_works; /* list of struct response_work */
+	struct list_head                   free_response_works; /* list of struct response_work */
+	struct response_work               response_work_slots[MAX_RESPONSE_WORKS];
 	struct list_head                   enc_input_crs;
 	struct list_head                   dmabuf_tracker; /* list of struct msm_memory_dmabuf */
+	DECLARE_HASHTABLE(dmabuf_index, DMABUF_HASH_BITS); /* dmabuf_tracker, by dmabuf */
 	bool                               once_per_session_set;
 	bool                               ipsc_properties_set;
 	bool                               opsc_properties_set;
@@ -141,6 +163,7 @@ struct msm_vidc_inst {
 	struct debug_buf_count             debug_count;
 	struct msm_vidc_statistics         stats;
 	struct msm_vidc_inst_capability   *capabilities;
+	struct msm_vidc_mem_stats          mem_stats;
 	struct completion                  completions[MAX_SIGNAL];
 	enum priority_level                priority_level;
 	u32                                firmware_priority;
@@ -148,7 +171,7 @@ struct msm_vidc_inst {
 	u64                                last_qbuf_time_ns;
 	bool                               vb2q_init;
 	u32                                max_input_data_size;
-	u32                                dpb_list_payload[MAX_DPB_LIST_ARRAY_SIZE];
+	struct msm_vidc_dpb_list           dpb_list;
 	u32                                max_map_output_count;
 	u32                                auto_framerate;
 	bool                               has_bframe;
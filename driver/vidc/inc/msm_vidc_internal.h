@@ -8,6 +8,7 @@
 
 #include <linux/bits.h>
 #include <linux/workqueue.h>
+#include <linux/hashtable.h>
 #include <media/v4l2-dev.h>
 #include <media/v4l2-device.h>
 #include <media/v4l2-ioctl.h>
@@ -74,6 +75,9 @@
 #define DCVS_WINDOW 16
 #define ENC_FPS_WINDOW 3
 #define DEC_FPS_WINDOW 10
+#define MAX_FPS_WINDOW DEC_FPS_WINDOW /* largest of the windows above */
+/* weight 1/(1 << shift) of a new window fps in the averaged fps */
+#define FPS_EMA_SHIFT 2
 /* Superframe can have maximum of 32 frames */
 #define VIDC_SUPERFRAME_MAX 32
 #define COLOR_RANGE_UNSPECIFIED (-1)
@@ -128,7 +132,35 @@
 #define SW_PC_DELAY_VALUE             (HW_RESPONSE_TIMEOUT_VALUE + 500)
 #define FW_UNLOAD_DELAY_VALUE         (SW_PC_DELAY_VALUE + 1500)
 
+/* define msgq polling defaults */
+#define MSGQ_POLL_BUDGET_VALUE        (32)
+#define MSGQ_POLL_INTERVAL_US_VALUE   (200)
+#define MSGQ_POLL_IDLE_ROUNDS_VALUE   (4)
+#define MSGQ_POLL_RATE_VALUE          (2000)
+
+/* clock and bus vote hysteresis, in percent of the current vote */
+#define VOTE_UP_PERCENT_VALUE         (0)
+#define VOTE_DOWN_PERCENT_VALUE       (10)
+#define VOTE_DOWN_WINDOW_MS_VALUE     (100)
+
+/* host side packets held back while cmdq is full */
+#define CMDQ_PENDING_SLOTS            (32)
+#define CMDQ_PENDING_WAIT_MS          (5)
+
+/* firmware log ring exported through debugfs */
+#define FW_LOG_RING_SIZE              (64 * 1024)
+
+/* internal buffers kept mapped across sessions, bucketed by ilog2(size) */
+#define INTERNAL_BUF_CACHE_MAX_VALUE  (32 * 1024 * 1024)
+#define INTERNAL_BUF_CACHE_CLASSES    (32)
+
+/* BIT(enum msm_vidc_buffer_type) of buffers synced for cpu over payload */
+#define CACHE_OP_BUFFER_TYPES_VALUE \
+	(BIT(MSM_VIDC_BUF_INPUT_META) | BIT(MSM_VIDC_BUF_OUTPUT_META))
+
 #define MAX_MAP_OUTPUT_COUNT 64
+/* idle delayed unmap mappings are trimmed down to this % of the high mark */
+#define DELAYED_UNMAP_LOW_PERCENT 75
 #define MAX_DPB_COUNT 32
  /*
   * max dpb count in firmware = 16
@@ -138,6 +170,8 @@
   */
 #define MAX_DPB_LIST_ARRAY_SIZE (16 * 4)
 #define MAX_DPB_LIST_PAYLOAD_SIZE (16 * 4 * 4)
+#define MAX_DPB_LIST_ENTRIES (MAX_DPB_LIST_ARRAY_SIZE / 4)
+#define DPB_LIST_HASH_BITS 5
 
 enum msm_vidc_domain_type {
 	MSM_VIDC_ENCODER           = BIT(0),
@@ -211,6 +245,7 @@ enum msm_vidc_buffer_region {
 	MSM_VIDC_SECURE_PIXEL,
 	MSM_VIDC_SECURE_NONPIXEL,
 	MSM_VIDC_SECURE_BITSTREAM,
+	MSM_VIDC_REGION_MAX,
 };
 
 enum msm_vidc_port_type {
@@ -565,6 +600,12 @@ enum msm_vidc_cache_op {
 	MSM_VIDC_CACHE_CLEAN_INVALIDATE,
 };
 
+enum msm_vidc_dcvs_policy {
+	MSM_VIDC_DCVS_POLICY_THRESHOLD   = 0,
+	MSM_VIDC_DCVS_POLICY_PREDICTIVE,
+	MSM_VIDC_DCVS_POLICY_MAX,
+};
+
 enum msm_vidc_dcvs_flags {
 	MSM_VIDC_DCVS_INCR               = BIT(0),
 	MSM_VIDC_DCVS_DECR               = BIT(1),
@@ -728,6 +769,21 @@ struct msm_vidc_decode_batch {
 	struct delayed_work    work;
 };
 
+/* a response header holds at most one hfi_packet per 32 bytes */
+#define MAX_HFI_RESPONSE_PACKETS (VIDC_IFACEQ_VAR_HUGE_PKT_SIZE / 32)
+
+/* per range packet lists built while walking a session response once */
+struct msm_vidc_hfi_dispatch {
+	u16                    offset[MAX_HFI_RESPONSE_PACKETS];
+	u16                    next[MAX_HFI_RESPONSE_PACKETS];
+};
+
+struct msm_vidc_cmd_batch {
+	bool                   enable;
+	bool                   pending_intr;
+	u32                    num_packets;
+};
+
 enum msm_vidc_power_mode {
 	VIDC_POWER_NORMAL = 0,
 	VIDC_POWER_LOW,
@@ -756,6 +812,31 @@ struct vidc_bus_vote_data {
 	u32 num_vpp_pipes;
 };
 
+/* inputs of the predictive dcvs policy, see msm_vidc_power.c */
+struct msm_vidc_dcvs_history {
+	u32                    depth[DCVS_WINDOW]; /* bufs with fw per qbuf */
+	u32                    head;
+	u32                    count;
+	u32                    depth_sum;
+	u64                    last_done_ns;
+	u64                    busy_ns; /* EMA of fw time per frame */
+};
+
+/*
+ * Inputs and results of the last run of the variant clock and bus models,
+ * dropped whenever a capability of the session changes.
+ */
+struct msm_vidc_power_model {
+	bool                   freq_valid;
+	u32                    mbpf;
+	u32                    fps;
+	u32                    data_size; /* decoder only, 4K aligned */
+	bool                   has_bframe;
+	u64                    freq;
+	bool                   bw_valid;
+	struct vidc_bus_vote_data bw; /* key, calc_bw_* hold the results */
+};
+
 struct msm_vidc_power {
 	enum msm_vidc_power_mode power_mode;
 	u32                    buffer_counter;
@@ -771,6 +852,18 @@ struct msm_vidc_power {
 	u32                    dcvs_flags;
 	u32                    fw_cr;
 	u32                    fw_cf;
+	enum msm_vidc_dcvs_policy dcvs_policy;
+	struct msm_vidc_dcvs_history dcvs_history;
+	struct list_head       clk_node; /* on core->clk_aggr while voting */
+	u64                    aggr_freq; /* vote counted in core->clk_aggr */
+	u32                    aggr_flags;
+	struct msm_vidc_power_model model;
+};
+
+/* bytes allocated from dma heaps and mapped to context banks */
+struct msm_vidc_mem_stats {
+	atomic64_t                  alloc_bytes;
+	atomic64_t                  map_bytes;
 };
 
 struct msm_vidc_alloc {
@@ -782,30 +875,53 @@ struct msm_vidc_alloc {
 	u8                          map_kernel:1;
 	struct dma_buf             *dmabuf;
 	void                       *kvaddr;
+	struct msm_vidc_mem_stats  *owner; /* session charged, if any */
 };
 
 struct msm_vidc_allocations {
 	struct list_head            list; // list of "struct msm_vidc_alloc"
 };
 
+/* allocated and mapped internal buffer parked in the core cache */
+struct msm_vidc_cached_buffer {
+	struct list_head            list;
+	enum msm_vidc_buffer_region region;
+	u8                          secure:1;
+	u8                          map_kernel:1;
+	struct dma_buf             *dmabuf;
+	void                       *kvaddr;
+	u64                         device_addr;
+	struct sg_table            *table;
+	struct dma_buf_attachment  *attach;
+};
+
 struct msm_vidc_map {
 	struct list_head            list;
+	struct hlist_node           hnode;
+	struct list_head            lru; /* on inst->mappings.lru while idle */
 	enum msm_vidc_buffer_type   type;
 	enum msm_vidc_buffer_region region;
 	struct dma_buf             *dmabuf;
 	u32                         refcount;
+	u32                         pinned; /* read only/release buffers */
 	u64                         device_addr;
 	struct sg_table            *table;
 	struct dma_buf_attachment  *attach;
 	u32                         skip_delayed_unmap:1;
+	struct msm_vidc_mem_stats  *owner; /* session charged, if any */
 };
 
 struct msm_vidc_mappings {
 	struct list_head            list; // list of "struct msm_vidc_map"
 };
 
+/* dmabuf tracker entries and mappings hashed by struct dma_buf pointer */
+#define DMABUF_HASH_BITS 6
+
 struct msm_vidc_buffer {
 	struct list_head                   list;
+	struct hlist_node                  index_node;
+	struct hlist_node                  addr_node;
 	enum msm_vidc_buffer_type          type;
 	u32                                index;
 	int                                fd;
@@ -828,20 +944,41 @@ struct msm_vidc_buffers {
 	bool                   reuse;
 };
 
-struct msm_vidc_sort {
-	struct list_head       list;
-	u64                    val;
+/* external (vb2) buffers hashed by vb2 index and by device address */
+#define BUFFER_INDEX_HASH_BITS 6
+
+struct msm_vidc_buffer_index {
+	DECLARE_HASHTABLE(index, BUFFER_INDEX_HASH_BITS);
+	DECLARE_HASHTABLE(addr, BUFFER_INDEX_HASH_BITS);
+	DECLARE_HASHTABLE(read_only, BUFFER_INDEX_HASH_BITS); /* by addr */
 };
 
-struct msm_vidc_timestamp {
-	struct msm_vidc_sort   sort;
-	u64                    rank;
+/* last dpb list reported by firmware, hashed by base address */
+struct msm_vidc_dpb_entry {
+	struct hlist_node           node;
+	u64                         device_addr;
+	u32                         data_offset;
 };
 
+struct msm_vidc_dpb_list {
+	DECLARE_HASHTABLE(index, DPB_LIST_HASH_BITS);
+	struct msm_vidc_dpb_entry   entries[MAX_DPB_LIST_ENTRIES];
+	u32                         count;
+};
+
+/*
+ * Sliding window of the last buffer timestamps in us: ring in arrival
+ * order to find the one to drop, sorted copy to undo reordering.
+ * fps is Q16 from the median delta of the window, avg_fps its EMA.
+ */
 struct msm_vidc_timestamps {
-	struct list_head       list;
+	u64                    ring[MAX_FPS_WINDOW];
+	u64                    sorted[MAX_FPS_WINDOW];
+	u32                    head;
 	u32                    count;
-	u64                    rank;
+	u64                    fps;
+	u64                    avg_fps;
+	u32                    prev_auto_fps;
 };
 
 enum msm_vidc_allow {
@@ -858,6 +995,9 @@ enum response_work_type {
 	RESP_WORK_LAST_FLAG,
 };
 
+/* preallocated per instance, data holds up to VIDC_IFACEQ_VAR_HUGE_PKT_SIZE */
+#define MAX_RESPONSE_WORKS 4
+
 struct response_work {
 	struct list_head        list;
 	enum response_work_type type;
@@ -13,6 +13,7 @@ struct msm_vidc_inst;
 
 struct msm_memory_dmabuf {
 	struct list_head       list;
+	struct hlist_node      hnode;
 	struct dma_buf        *dmabuf;
 	u32                    refcount;
 };
@@ -21,7 +22,6 @@ enum msm_memory_pool_type {
 	MSM_MEM_POOL_BUFFER  = 0,
 	MSM_MEM_POOL_MAP,
 	MSM_MEM_POOL_ALLOC,
-	MSM_MEM_POOL_TIMESTAMP,
 	MSM_MEM_POOL_DMABUF,
 	MSM_MEM_POOL_MAX,
 };
@@ -36,6 +36,8 @@ struct msm_memory_alloc_header {
 struct msm_memory_pool {
 	u32                    size;
 	char                  *name;
+	struct kmem_cache     *cache;
+	bool                   reset; /* zero object on reuse from free pool */
 	struct list_head       free_pool; /* list of struct msm_memory_alloc_header */
 	struct list_head       busy_pool; /* list of struct msm_memory_alloc_header */
 };
@@ -54,7 +56,23 @@ void msm_vidc_memory_put_dmabuf(struct msm_vidc_inst *inst,
 	struct dma_buf *dmabuf);
 void msm_vidc_memory_put_dmabuf_completely(struct msm_vidc_inst *inst,
 	struct msm_memory_dmabuf *buf);
+void msm_vidc_buffer_cache_init(struct msm_vidc_core *core);
+void msm_vidc_buffer_cache_deinit(struct msm_vidc_core *core);
+void msm_vidc_dma_heaps_init(struct msm_vidc_core *core);
+void msm_vidc_dma_heaps_deinit(struct msm_vidc_core *core);
+int msm_vidc_memory_cache_operations(struct msm_vidc_inst *inst,
+	struct dma_buf *dbuf, enum msm_vidc_cache_op cache_op,
+	unsigned long offset, unsigned long size);
+void msm_vidc_buffer_cache_flush(struct msm_vidc_core *core);
+int msm_vidc_memory_clear(struct msm_vidc_alloc *mem);
+bool msm_vidc_buffer_cache_get(struct msm_vidc_core *core,
+	struct msm_vidc_alloc *alloc, struct msm_vidc_map *map);
+bool msm_vidc_buffer_cache_put(struct msm_vidc_core *core,
+	struct msm_vidc_alloc *alloc, struct msm_vidc_map *map);
+int msm_memory_caches_init(struct msm_vidc_core *core);
+void msm_memory_caches_deinit(struct msm_vidc_core *core);
 int msm_memory_pools_init(struct msm_vidc_inst *inst);
+void msm_memory_pools_prewarm(struct msm_vidc_inst *inst);
 void msm_memory_pools_deinit(struct msm_vidc_inst *inst);
 void *msm_memory_alloc(struct msm_vidc_inst *inst,
 	enum msm_memory_pool_type type);
@@ -254,4 +254,8 @@ int msm_vidc_get_inst_load(struct msm_vidc_inst *inst);
 int msm_vidc_get_mbps(struct msm_vidc_inst *inst);
 int msm_vidc_scale_power(struct msm_vidc_inst *inst, bool scale_buses);
 void msm_vidc_power_data_reset(struct msm_vidc_inst *inst);
+void msm_vidc_dcvs_frame_done(struct msm_vidc_inst *inst);
+void msm_vidc_power_model_invalidate(struct msm_vidc_inst *inst);
+void msm_vidc_clk_aggregate_remove_locked(struct msm_vidc_core *core,
+	struct msm_vidc_inst *inst);
 #endif
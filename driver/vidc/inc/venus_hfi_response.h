@@ -20,6 +20,10 @@ void handle_session_response_work_handler(struct work_struct *work);
 int handle_session_response_work(struct msm_vidc_inst *inst,
 	struct response_work *work);
 int cancel_response_work(struct msm_vidc_inst *inst);
+int init_response_works(struct msm_vidc_inst *inst);
+void deinit_response_works(struct msm_vidc_inst *inst);
+void put_response_work(struct msm_vidc_inst *inst,
+	struct response_work *work);
 int handle_system_error(struct msm_vidc_core *core,
 	struct hfi_packet *pkt);
 void fw_coredump(struct msm_vidc_core *core);
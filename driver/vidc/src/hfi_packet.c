@@ -405,7 +405,7 @@ int hfi_packet_sys_init(struct msm_vidc_core *core,
 
 	rc = hfi_create_header(pkt, pkt_size,
 				   0 /*session_id*/,
-				   core->header_id++);
+				   0);
 	if (rc)
 		goto err_sys_init;
 
@@ -419,7 +419,7 @@ int hfi_packet_sys_init(struct msm_vidc_core *core,
 				   HFI_HOST_FLAGS_NON_DISCARDABLE),
 				   HFI_PAYLOAD_U32,
 				   HFI_PORT_NONE,
-				   core->packet_id++,
+				   0,
 				   &payload,
 				   sizeof(u32));
 	if (rc)
@@ -433,7 +433,7 @@ int hfi_packet_sys_init(struct msm_vidc_core *core,
 				   HFI_HOST_FLAGS_NONE,
 				   HFI_PAYLOAD_U32,
 				   HFI_PORT_NONE,
-				   core->packet_id++,
+				   0,
 				   &payload,
 				   sizeof(u32));
 	if (rc)
@@ -447,7 +447,7 @@ int hfi_packet_sys_init(struct msm_vidc_core *core,
 				   HFI_HOST_FLAGS_NONE,
 				   HFI_PAYLOAD_U32,
 				   HFI_PORT_NONE,
-				   core->packet_id++,
+				   0,
 				   &payload,
 				   sizeof(u32));
 	if (rc)
@@ -461,7 +461,7 @@ int hfi_packet_sys_init(struct msm_vidc_core *core,
 				   HFI_HOST_FLAGS_NONE,
 				   HFI_PAYLOAD_U32,
 				   HFI_PORT_NONE,
-				   core->packet_id++,
+				   0,
 				   &payload,
 				   sizeof(u32));
 	if (rc)
@@ -475,7 +475,7 @@ int hfi_packet_sys_init(struct msm_vidc_core *core,
 				   HFI_HOST_FLAGS_NONE,
 				   HFI_PAYLOAD_U32,
 				   HFI_PORT_NONE,
-				   core->packet_id++,
+				   0,
 				   &payload,
 				   sizeof(u32));
 	if (rc)
@@ -489,7 +489,7 @@ int hfi_packet_sys_init(struct msm_vidc_core *core,
 				   HFI_HOST_FLAGS_NONE,
 				   HFI_PAYLOAD_U32,
 				   HFI_PORT_NONE,
-				   core->packet_id++,
+				   0,
 				   &payload,
 				   sizeof(u32));
 	if (rc)
@@ -503,7 +503,7 @@ int hfi_packet_sys_init(struct msm_vidc_core *core,
 				   HFI_HOST_FLAGS_NONE,
 				   HFI_PAYLOAD_U32,
 				   HFI_PORT_NONE,
-				   core->packet_id++,
+				   0,
 				   &payload,
 				   sizeof(u32));
 	if (rc)
@@ -517,7 +517,7 @@ int hfi_packet_sys_init(struct msm_vidc_core *core,
 				   HFI_HOST_FLAGS_NONE,
 				   HFI_PAYLOAD_U32,
 				   HFI_PORT_NONE,
-				   core->packet_id++,
+				   0,
 				   &payload,
 				   sizeof(u32));
 	if (rc)
@@ -543,7 +543,7 @@ int hfi_packet_image_version(struct msm_vidc_core *core,
 
 	rc = hfi_create_header(pkt, pkt_size,
 				   0 /*session_id*/,
-				   core->header_id++);
+				   0);
 	if (rc)
 		goto err_img_version;
 
@@ -555,7 +555,7 @@ int hfi_packet_image_version(struct msm_vidc_core *core,
 				   HFI_HOST_FLAGS_GET_PROPERTY),
 				   HFI_PAYLOAD_NONE,
 				   HFI_PORT_NONE,
-				   core->packet_id++,
+				   0,
 				   NULL, 0);
 	if (rc)
 		goto err_img_version;
@@ -580,7 +580,7 @@ int hfi_packet_sys_pc_prep(struct msm_vidc_core *core,
 
 	rc = hfi_create_header(pkt, pkt_size,
 			   0 /*session_id*/,
-			   core->header_id++);
+			   0);
 	if (rc)
 		goto err_sys_pc;
 
@@ -590,7 +590,7 @@ int hfi_packet_sys_pc_prep(struct msm_vidc_core *core,
 				   HFI_HOST_FLAGS_NONE,
 				   HFI_PAYLOAD_NONE,
 				   HFI_PORT_NONE,
-				   core->packet_id++,
+				   0,
 				   NULL, 0);
 	if (rc)
 		goto err_sys_pc;
@@ -616,7 +616,7 @@ int hfi_packet_sys_debug_config(struct msm_vidc_core *core,
 
 	rc = hfi_create_header(pkt, pkt_size,
 				   0 /*session_id*/,
-				   core->header_id++);
+				   0);
 	if (rc)
 		goto err_debug;
 
@@ -627,7 +627,7 @@ int hfi_packet_sys_debug_config(struct msm_vidc_core *core,
 				   HFI_HOST_FLAGS_NONE,
 				   HFI_PAYLOAD_U32_ENUM,
 				   HFI_PORT_NONE,
-				   core->packet_id++,
+				   0,
 				   &payload,
 				   sizeof(u32));
 	if (rc)
@@ -640,7 +640,7 @@ int hfi_packet_sys_debug_config(struct msm_vidc_core *core,
 				   HFI_HOST_FLAGS_NONE,
 				   HFI_PAYLOAD_U32_ENUM,
 				   HFI_PORT_NONE,
-				   core->packet_id++,
+				   0,
 				   &payload,
 				   sizeof(u32));
 	if (rc)
@@ -658,17 +658,15 @@ int hfi_packet_session_command(struct msm_vidc_inst *inst,
 	u32 payload_type, void *payload, u32 payload_size)
 {
 	int rc = 0;
-	struct msm_vidc_core *core;
 
 	if (!inst || !inst->core || !inst->packet) {
 		d_vpr_e("%s: Invalid params\n", __func__);
 		return -EINVAL;
 	}
-	core = inst->core;
 
 	rc = hfi_create_header(inst->packet, inst->packet_size,
 				   session_id,
-				   core->header_id++);
+				   0);
 	if (rc)
 		goto err_cmd;
 
@@ -678,7 +676,7 @@ int hfi_packet_session_command(struct msm_vidc_inst *inst,
 				flags,
 				payload_type,
 				port,
-				core->packet_id++,
+				0,
 				payload,
 				payload_size);
 	if (rc)
@@ -705,7 +703,7 @@ int hfi_packet_sys_intraframe_powercollapse(struct msm_vidc_core* core,
 
 	rc = hfi_create_header(pkt, pkt_size,
 		0 /*session_id*/,
-		core->header_id++);
+		0);
 	if (rc)
 		goto err;
 
@@ -717,7 +715,7 @@ int hfi_packet_sys_intraframe_powercollapse(struct msm_vidc_core* core,
 		HFI_HOST_FLAGS_NONE,
 		HFI_PAYLOAD_U32,
 		HFI_PORT_NONE,
-		core->packet_id++,
+		0,
 		&payload,
 		sizeof(u32));
 	if (rc)
@@ -67,7 +67,7 @@ static const u32 msm_vdec_output_subscribe_for_properties[] = {
 	HFI_PROP_CABAC_SESSION,
 };
 
-static const u32 msm_vdec_internal_buffer_type[] = {
+static const enum msm_vidc_buffer_type msm_vdec_internal_buffer_type[] = {
 	MSM_VIDC_BUF_BIN,
 	MSM_VIDC_BUF_COMV,
 	MSM_VIDC_BUF_NON_COMV,
@@ -837,16 +837,9 @@ static int msm_vdec_get_output_internal_buffers(struct msm_vidc_inst *inst)
 
 static int msm_vdec_create_input_internal_buffers(struct msm_vidc_inst *inst)
 {
-	int rc = 0;
-	u32 i = 0;
-
-	for (i = 0; i < ARRAY_SIZE(msm_vdec_internal_buffer_type); i++) {
-		rc = msm_vidc_create_internal_buffers(inst, msm_vdec_internal_buffer_type[i]);
-		if (rc)
-			return rc;
-	}
-
-	return 0;
+	return msm_vidc_create_internal_buffers_set(inst,
+		msm_vdec_internal_buffer_type,
+		ARRAY_SIZE(msm_vdec_internal_buffer_type));
 }
 
 static int msm_vdec_create_output_internal_buffers(struct msm_vidc_inst *inst)
@@ -1485,7 +1478,7 @@ static int schedule_batch_work(struct msm_vidc_inst *inst)
 		return -EINVAL;
 	}
 	core = inst->core;
-	mod_delayed_work(core->batch_workq, &inst->decode_batch.work,
+	mod_delayed_work(core->response_workq, &inst->decode_batch.work,
 		msecs_to_jiffies(core->capabilities[DECODE_BATCH_TIMEOUT].value));
 
 	return 0;
@@ -1652,6 +1645,21 @@ static int msm_vdec_subscribe_output_port_settings_change(struct msm_vidc_inst *
 	return rc;
 }
 
+/* debugfs overrides win over the resolution based max map output count */
+static void msm_vdec_update_map_watermarks(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_core *core = inst->core;
+	struct msm_vidc_map_lru *lru = &inst->mappings.lru;
+
+	lru->high = core->delayed_unmap_high ?
+		core->delayed_unmap_high : inst->max_map_output_count;
+	lru->low = core->delayed_unmap_low ?
+		core->delayed_unmap_low :
+		lru->high * DELAYED_UNMAP_LOW_PERCENT / 100;
+	if (lru->low > lru->high)
+		lru->low = lru->high;
+}
+
 static int msm_vdec_update_max_map_output_count(struct msm_vidc_inst *inst)
 {
 	int rc = 0;
@@ -1685,7 +1693,10 @@ static int msm_vdec_update_max_map_output_count(struct msm_vidc_inst *inst)
 		count = 64;
 
 	inst->max_map_output_count = count;
-	i_vpr_h(inst, "%s: count: %d\n", __func__, inst->max_map_output_count);
+	msm_vdec_update_map_watermarks(inst);
+	i_vpr_h(inst, "%s: count: %d, lru high %u low %u\n", __func__,
+		inst->max_map_output_count, inst->mappings.lru.high,
+		inst->mappings.lru.low);
 
 	return rc;
 }
@@ -1849,8 +1860,6 @@ static int msm_vdec_release_nonref_buffers(struct msm_vidc_inst *inst)
 	int rc = 0;
 	u32 fw_ro_count = 0, nonref_ro_count = 0;
 	struct msm_vidc_buffer *ro_buf, *rel_buf, *dummy;
-	int i = 0;
-	bool found = false;
 
 	if (!inst) {
 		d_vpr_e("%s: invalid params\n", __func__);
@@ -1866,23 +1875,12 @@ static int msm_vdec_release_nonref_buffers(struct msm_vidc_inst *inst)
 
 	/*
 	 * Mark those buffers present in read_only list as non-reference
-	 * if that buffer is not part of dpb_list_payload
+	 * if that buffer is not part of firmware dpb list
 	 * count such non-ref read only buffers as nonref_ro_count
-	 * dpb_list_payload details:
-	 * payload[0-1]           : 64 bits base_address of DPB-1
-	 * payload[2]             : 32 bits addr_offset  of DPB-1
-	 * payload[3]             : 32 bits data_offset  of DPB-1
 	 */
 	list_for_each_entry(ro_buf, &inst->buffers.read_only.list, list) {
-		found = false;
-		for (i = 0; (i + 3) < MAX_DPB_LIST_ARRAY_SIZE; i = i + 4) {
-			if (ro_buf->device_addr == inst->dpb_list_payload[i] &&
-				ro_buf->data_offset == inst->dpb_list_payload[i + 3]) {
-				found = true;
-				break;
-			}
-		}
-		if (!found) {
+		if (!msm_vidc_is_dpb_buffer(inst, ro_buf->device_addr,
+				ro_buf->data_offset)) {
 			ro_buf->attr &= ~MSM_VIDC_ATTR_READ_ONLY;
 			nonref_ro_count++;
 		}
@@ -1899,6 +1897,7 @@ static int msm_vdec_release_nonref_buffers(struct msm_vidc_inst *inst)
 	 */
 	list_for_each_entry_safe(ro_buf, dummy, &inst->buffers.read_only.list, list) {
 		if (!(ro_buf->attr & MSM_VIDC_ATTR_READ_ONLY)) {
+			hash_del(&ro_buf->addr_node);
 			list_del(&ro_buf->list);
 			INIT_LIST_HEAD(&ro_buf->list);
 			list_add_tail(&ro_buf->list, &inst->buffers.release.list);
@@ -1929,6 +1928,7 @@ int msm_vdec_handle_release_buffer(struct msm_vidc_inst *inst,
 	}
 
 	print_vidc_buffer(VIDC_LOW, "low ", "release done", inst, buf);
+	msm_vidc_unpin_delayed_unmap(inst, buf);
 	/* delete the buffer from release list */
 	list_del(&buf->list);
 	msm_memory_free(inst, buf);
@@ -1936,76 +1936,36 @@ int msm_vdec_handle_release_buffer(struct msm_vidc_inst *inst,
 	return rc;
 }
 
-static bool is_valid_removable_buffer(struct msm_vidc_inst *inst,
-	struct msm_vidc_map *map)
-{
-	bool found = false;
-	struct msm_vidc_buffer *buf;
-
-	if (!inst || !map) {
-		d_vpr_e("%s: invalid params\n", __func__);
-		return -EINVAL;
-	}
-
-	if (map->refcount != 1)
-		return false;
-
-	list_for_each_entry(buf, &inst->buffers.read_only.list, list) {
-		if (map->device_addr == buf->device_addr) {
-			found = true;
-			break;
-		}
-	}
-
-	list_for_each_entry(buf, &inst->buffers.release.list, list) {
-		if (map->device_addr == buf->device_addr) {
-			found = true;
-			break;
-		}
-	}
-
-	if (!found)
-		return true;
-
-	return false;
-}
-
 static int msm_vidc_unmap_excessive_mappings(struct msm_vidc_inst *inst)
 {
 	int rc = 0;
-	struct msm_vidc_map *map, *temp;
-	u32 refcount_one_bufs_count = 0;
+	struct msm_vidc_map_lru *lru;
+	struct msm_vidc_map *map;
 
 	if (!inst) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return -EINVAL;
 	}
+	lru = &inst->mappings.lru;
 
 	/*
-	 * count entries from map list which are not present in
-	 * read_only buffers list, not present in release list
-	 * and whose refcount is 1.these are excess mappings
-	 * present due to delayed unmap feature.
+	 * lru holds the excess mappings left by delayed unmap feature:
+	 * refcount 1 and not in read_only or release buffers list.
+	 * once above high mark, unmap least recently used down to low mark.
 	 */
-	list_for_each_entry(map, &inst->mappings.output.list, list) {
-		if (is_valid_removable_buffer(inst, map))
-			refcount_one_bufs_count++;
-	}
-
-	if (refcount_one_bufs_count <= inst->max_map_output_count)
+	if (lru->count <= lru->high)
 		return 0;
 
-	/* unmap these buffers as they are stale entries */
-	list_for_each_entry_safe(map, temp, &inst->mappings.output.list, list) {
-		if (is_valid_removable_buffer(inst, map)) {
-			i_vpr_l(inst,
-				"%s: type %11s, device_addr %#x, refcount %d, region %d\n",
-				__func__, buf_name(map->type), map->device_addr,
-				map->refcount, map->region);
-			rc = msm_vidc_put_delayed_unmap(inst, map);
-			if (rc)
-				return rc;
-		}
+	while (lru->count > lru->low) {
+		map = list_first_entry(&lru->list, struct msm_vidc_map, lru);
+		i_vpr_l(inst,
+			"%s: type %11s, device_addr %#x, refcount %d, region %d\n",
+			__func__, buf_name(map->type), map->device_addr,
+			map->refcount, map->region);
+		lru->evictions++;
+		rc = msm_vidc_put_delayed_unmap(inst, map);
+		if (rc)
+			return rc;
 	}
 	return rc;
 }
@@ -2802,6 +2762,7 @@ int msm_vdec_inst_init(struct msm_vidc_inst *inst)
 			inst->buffers.output.extra_count;
 	inst->buffers.output.size = f->fmt.pix_mp.plane_fmt[0].sizeimage;
 	inst->max_map_output_count = MAX_MAP_OUTPUT_COUNT;
+	msm_vdec_update_map_watermarks(inst);
 
 	f = &inst->fmts[OUTPUT_META_PORT];
 	f->type = OUTPUT_META_PLANE;
@@ -43,7 +43,7 @@ static const u32 msm_venc_output_subscribe_for_properties[] = {
 	HFI_PROP_WORST_COMPRESSION_RATIO,
 };
 
-static const u32 msm_venc_output_internal_buffer_type[] = {
+static const enum msm_vidc_buffer_type msm_venc_output_internal_buffer_type[] = {
 	MSM_VIDC_BUF_BIN,
 	MSM_VIDC_BUF_COMV,
 	MSM_VIDC_BUF_NON_COMV,
@@ -51,7 +51,7 @@ static const u32 msm_venc_output_internal_buffer_type[] = {
 	MSM_VIDC_BUF_DPB,
 };
 
-static const u32 msm_venc_input_internal_buffer_type[] = {
+static const enum msm_vidc_buffer_type msm_venc_input_internal_buffer_type[] = {
 	MSM_VIDC_BUF_VPSS,
 };
 
@@ -563,21 +563,14 @@ static int msm_venc_get_input_internal_buffers(struct msm_vidc_inst *inst)
 
 static int msm_venc_create_input_internal_buffers(struct msm_vidc_inst *inst)
 {
-	int i, rc = 0;
-
 	if (!inst || !inst->core) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return -EINVAL;
 	}
 
-	for (i = 0; i < ARRAY_SIZE(msm_venc_input_internal_buffer_type); i++) {
-		rc = msm_vidc_create_internal_buffers(inst,
-			msm_venc_input_internal_buffer_type[i]);
-		if (rc)
-			return rc;
-	}
-
-	return rc;
+	return msm_vidc_create_internal_buffers_set(inst,
+		msm_venc_input_internal_buffer_type,
+		ARRAY_SIZE(msm_venc_input_internal_buffer_type));
 }
 
 static int msm_venc_queue_input_internal_buffers(struct msm_vidc_inst *inst)
@@ -622,21 +615,14 @@ static int msm_venc_get_output_internal_buffers(struct msm_vidc_inst *inst)
 
 static int msm_venc_create_output_internal_buffers(struct msm_vidc_inst *inst)
 {
-	int i, rc = 0;
-
 	if (!inst || !inst->core) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return -EINVAL;
 	}
 
-	for (i = 0; i < ARRAY_SIZE(msm_venc_output_internal_buffer_type); i++) {
-		rc = msm_vidc_create_internal_buffers(inst,
-			msm_venc_output_internal_buffer_type[i]);
-		if (rc)
-			return rc;
-	}
-
-	return 0;
+	return msm_vidc_create_internal_buffers_set(inst,
+		msm_venc_output_internal_buffer_type,
+		ARRAY_SIZE(msm_venc_output_internal_buffer_type));
 }
 
 static int msm_venc_queue_output_internal_buffers(struct msm_vidc_inst *inst)
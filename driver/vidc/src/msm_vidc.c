@@ -846,7 +846,7 @@ void *msm_vidc_open(void *vidc_core, u32 session_type)
 		return NULL;
 	}
 	INIT_LIST_HEAD(&inst->response_works);
-	INIT_LIST_HEAD(&inst->timestamps.list);
+	INIT_LIST_HEAD(&inst->free_response_works);
 	INIT_LIST_HEAD(&inst->buffers.input.list);
 	INIT_LIST_HEAD(&inst->buffers.input_meta.list);
 	INIT_LIST_HEAD(&inst->buffers.output.list);
@@ -881,21 +881,32 @@ void *msm_vidc_open(void *vidc_core, u32 session_type)
 	INIT_LIST_HEAD(&inst->mappings.dpb.list);
 	INIT_LIST_HEAD(&inst->mappings.persist.list);
 	INIT_LIST_HEAD(&inst->mappings.vpss.list);
+	INIT_LIST_HEAD(&inst->mappings.lru.list);
+	INIT_LIST_HEAD(&inst->power.clk_node);
 	INIT_LIST_HEAD(&inst->children.list);
 	INIT_LIST_HEAD(&inst->firmware.list);
 	INIT_LIST_HEAD(&inst->enc_input_crs);
 	INIT_LIST_HEAD(&inst->dmabuf_tracker);
+	hash_init(inst->dmabuf_index);
+	hash_init(inst->mappings.index);
+	hash_init(inst->buffers.index.index);
+	hash_init(inst->buffers.index.addr);
+	hash_init(inst->buffers.index.read_only);
+	hash_init(inst->dpb_list.index);
 	for (i = 0; i < MAX_SIGNAL; i++)
 		init_completion(&inst->completions[i]);
 
-	inst->response_workq = create_singlethread_workqueue("response_workq");
-	if (!inst->response_workq) {
-		i_vpr_e(inst, "%s: create input_psc_workq failed\n", __func__);
-		goto error;
-	}
-
+	/*
+	 * response, stats and decode batch works run on the shared
+	 * core->response_workq; a work item never runs concurrently
+	 * with itself, so per instance ordering is preserved.
+	 */
 	INIT_DELAYED_WORK(&inst->response_work, handle_session_response_work_handler);
 	INIT_DELAYED_WORK(&inst->stats_work, msm_vidc_stats_handler);
+	if (init_response_works(inst)) {
+		i_vpr_e(inst, "%s: response works allocation failed\n", __func__);
+		goto error;
+	}
 
 	inst->capabilities = kzalloc(sizeof(struct msm_vidc_inst_capability), GFP_KERNEL);
 	if (!inst->capabilities) {
@@ -911,6 +922,8 @@ void *msm_vidc_open(void *vidc_core, u32 session_type)
 	if (rc)
 		goto error;
 
+	msm_memory_pools_prewarm(inst);
+
 	rc = msm_vidc_vb2_queue_init(inst);
 	if (rc)
 		goto error;
@@ -12,6 +12,7 @@
 #include "msm_vidc_driver.h"
 #include "msm_venc.h"
 #include "msm_vidc_platform.h"
+#include "msm_vidc_power.h"
 
 #define CAP_TO_8BIT_QP(a) {          \
 	if ((a) < 0)                 \
@@ -312,11 +313,14 @@ int msm_vidc_update_cap_value(struct msm_vidc_inst *inst, u32 cap,
 		return -EINVAL;
 	}
 
-	if (inst->capabilities->cap[cap].value != adjusted_val)
+	if (inst->capabilities->cap[cap].value != adjusted_val) {
 		i_vpr_h(inst,
 			"%s: updated database: name: %s, value: %#x -> %#x\n",
 			func, cap_name(cap),
 			inst->capabilities->cap[cap].value, adjusted_val);
+		/* power models read capabilities, drop their results */
+		msm_vidc_power_model_invalidate(inst);
+	}
 
 	inst->capabilities->cap[cap].value = adjusted_val;
 
@@ -3563,6 +3567,10 @@ int msm_vidc_set_v4l2_properties(struct msm_vidc_inst *inst)
 	i_vpr_h(inst, "%s()\n", __func__);
 	capability = inst->capabilities;
 
+	rc = venus_hfi_batch_begin(inst);
+	if (rc)
+		goto exit;
+
 	list_for_each_entry_safe(curr_node, tmp_node,
 			&inst->firmware.list, list) {
 
@@ -3573,12 +3581,14 @@ int msm_vidc_set_v4l2_properties(struct msm_vidc_inst *inst)
 		rc = capability->cap[curr_node->cap_id].set(inst,
 			curr_node->cap_id);
 		if (rc)
-			goto exit;
+			break;
 
 		list_del(&curr_node->list);
 		kfree(curr_node);
 	}
 
+	rc = venus_hfi_batch_end(inst, rc);
+
 exit:
 	msm_vidc_free_capabililty_list(inst, FW_LIST);
 
@@ -189,6 +189,33 @@ static ssize_t core_info_read(struct file* file, char __user* buf,
 	cur += write_str(cur, end - cur,
 		"register_size: %u\n", core->dt->register_size);
 	cur += write_str(cur, end - cur, "irq: %u\n", core->dt->irq);
+	cur += write_str(cur, end - cur,
+		"cmdq pending: %u queued: %llu waits: %llu timeouts: %llu\n",
+		core->cmdq_pending.count, core->cmdq_pending.queued,
+		core->cmdq_pending.waits, core->cmdq_pending.timeouts);
+	cur += write_str(cur, end - cur, "fw log dropped: %llu\n",
+		core->fw_log.dropped);
+	cur += write_str(cur, end - cur,
+		"msgq interrupts: %llu polls: %llu poll hits: %llu messages: %llu\n",
+		core->msgq_poll.interrupts, core->msgq_poll.polls,
+		core->msgq_poll.poll_hits, core->msgq_poll.messages);
+	cur += write_str(cur, end - cur,
+		"msgq messages per wakeup: %llu max: %u rate: %u/s\n",
+		core->msgq_poll.interrupts ? div64_u64(core->msgq_poll.messages,
+		core->msgq_poll.interrupts) : 0,
+		core->msgq_poll.max_messages, core->msgq_poll.rate);
+	cur += write_str(cur, end - cur,
+		"memory allocated: %lld mapped: %lld limit: %llu\n",
+		atomic64_read(&core->mem_stats.alloc_bytes),
+		atomic64_read(&core->mem_stats.map_bytes), core->mem_limit);
+	cur += write_str(cur, end - cur,
+		"internal buffer cache: %llu bytes hits: %llu misses: %llu\n",
+		core->buffer_cache.bytes, core->buffer_cache.hits,
+		core->buffer_cache.misses);
+	cur += write_str(cur, end - cur,
+		"clock votes: %llu suppressed: %llu bus votes: %llu suppressed: %llu\n",
+		core->vote_filter.clk_votes, core->vote_filter.clk_suppressed,
+		core->vote_filter.bus_votes, core->vote_filter.bus_suppressed);
 
 	len = simple_read_from_buffer(buf, count, ppos,
 		dbuf, cur - dbuf);
@@ -202,6 +229,31 @@ static const struct file_operations core_info_fops = {
 	.read = core_info_read,
 };
 
+static ssize_t fw_log_read(struct file *file, char __user *buf,
+	size_t count, loff_t *ppos)
+{
+	struct msm_vidc_core *core = file->private_data;
+	unsigned int copied = 0;
+	int rc = 0;
+
+	if (!core) {
+		d_vpr_e("%s: invalid params %pK\n", __func__, core);
+		return 0;
+	}
+
+	/* consuming read, records are removed from the ring */
+	mutex_lock(&core->fw_log.read_lock);
+	rc = kfifo_to_user(&core->fw_log.ring, buf, count, &copied);
+	mutex_unlock(&core->fw_log.read_lock);
+
+	return rc ? rc : copied;
+}
+
+static const struct file_operations fw_log_fops = {
+	.open = simple_open,
+	.read = fw_log_read,
+};
+
 static ssize_t stats_delay_write_ms(struct file *filp, const char __user *buf,
 		size_t count, loff_t *ppos)
 {
@@ -363,6 +415,38 @@ struct dentry *msm_vidc_debugfs_init_core(void *core_in)
 		d_vpr_e("debugfs_create_file: fail\n");
 		goto failed_create_dir;
 	}
+	if (!debugfs_create_file("fw_log", 0400, dir, core, &fw_log_fops)) {
+		d_vpr_e("debugfs_create_file: fail\n");
+		goto failed_create_dir;
+	}
+	debugfs_create_bool("msgq_poll_enable", 0644, dir,
+			&core->msgq_poll.enable);
+	debugfs_create_u32("msgq_poll_budget", 0644, dir,
+			&core->msgq_poll.budget);
+	debugfs_create_u32("msgq_poll_interval_us", 0644, dir,
+			&core->msgq_poll.interval_us);
+	debugfs_create_u32("msgq_poll_idle_rounds", 0644, dir,
+			&core->msgq_poll.idle_rounds);
+	debugfs_create_u32("msgq_poll_rate_threshold", 0644, dir,
+			&core->msgq_poll.rate_threshold);
+	debugfs_create_u64("internal_buffer_cache_max", 0644, dir,
+			&core->buffer_cache.max_bytes);
+	debugfs_create_u64("memory_admission_limit", 0644, dir,
+			&core->mem_limit);
+	debugfs_create_u32("delayed_unmap_high", 0644, dir,
+			&core->delayed_unmap_high);
+	debugfs_create_u32("delayed_unmap_low", 0644, dir,
+			&core->delayed_unmap_low);
+	debugfs_create_x32("cache_op_buffer_types", 0644, dir,
+			&core->cache_op_types);
+	debugfs_create_u32("dcvs_policy", 0644, dir,
+			&core->dcvs_policy);
+	debugfs_create_u32("vote_up_percent", 0644, dir,
+			&core->vote_filter.up_percent);
+	debugfs_create_u32("vote_down_percent", 0644, dir,
+			&core->vote_filter.down_percent);
+	debugfs_create_u32("vote_down_window_ms", 0644, dir,
+			&core->vote_filter.down_window_ms);
 failed_create_dir:
 	return dir;
 }
@@ -428,6 +512,14 @@ static ssize_t inst_info_read(struct file *file, char __user *buf,
 	cur += write_str(cur, end - cur, "state: %d\n", inst->state);
 	cur += write_str(cur, end - cur, "secure: %d\n",
 		is_secure_session(inst));
+	cur += write_str(cur, end - cur, "memory allocated: %lld mapped: %lld\n",
+		atomic64_read(&inst->mem_stats.alloc_bytes),
+		atomic64_read(&inst->mem_stats.map_bytes));
+	cur += write_str(cur, end - cur,
+		"delayed unmap: idle %u high %u low %u hits %llu misses %llu evictions %llu\n",
+		inst->mappings.lru.count, inst->mappings.lru.high,
+		inst->mappings.lru.low, inst->mappings.lru.hits,
+		inst->mappings.lru.misses, inst->mappings.lru.evictions);
 	cur += write_str(cur, end - cur, "-----------Formats-------------\n");
 	for (i = 0; i < MAX_PORT; i++) {
 		if (i != INPUT_PORT && i != OUTPUT_PORT)
@@ -5,6 +5,7 @@
 
 #include <linux/iommu.h>
 #include <linux/workqueue.h>
+#include <linux/hash.h>
 #include <media/v4l2_vidc_extensions.h>
 #include "msm_media_info.h"
 
@@ -1408,7 +1409,7 @@ int msm_vidc_update_property_cap(struct msm_vidc_inst *inst, u32 hfi_id,
 		break;
 	case HFI_PROP_DPB_LIST:
 		if (!allow)
-			memset(inst->dpb_list_payload, 0, MAX_DPB_LIST_ARRAY_SIZE);
+			msm_vidc_dpb_list_reset(inst);
 		msm_vidc_update_cap_value(inst, DPB_LIST, allow, __func__);
 		break;
 	default:
@@ -1660,9 +1661,7 @@ static int msm_vidc_discard_pending_ipsc(struct msm_vidc_inst *inst)
 			/* override the psc properties again if ipsc discarded */
 			inst->ipsc_properties_set = false;
 
-			list_del(&resp_work->list);
-			kfree(resp_work->data);
-			kfree(resp_work);
+			put_response_work(inst, resp_work);
 		}
 	}
 
@@ -1698,9 +1697,7 @@ static int msm_vidc_process_pending_ipsc(struct msm_vidc_inst *inst,
 					*new_state = MSM_VIDC_DRC;
 				}
 			}
-			list_del(&resp_work->list);
-			kfree(resp_work->data);
-			kfree(resp_work);
+			put_response_work(inst, resp_work);
 			/* list contains max only one ipsc at anytime */
 			break;
 		}
@@ -2050,7 +2047,7 @@ int msm_vidc_process_readonly_buffers(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffer *buf)
 {
 	int rc = 0;
-	struct msm_vidc_buffer *ro_buf, *dummy;
+	struct msm_vidc_buffer *ro_buf;
 	struct msm_vidc_buffers *ro_buffers;
 
 	if (!inst || !buf) {
@@ -2070,18 +2067,41 @@ int msm_vidc_process_readonly_buffers(struct msm_vidc_inst *inst,
 	 * if present: add ro flag to buf and remove from ro_buffers list
 	 * if not present: do nothing
 	 */
-	list_for_each_entry_safe(ro_buf, dummy, &ro_buffers->list, list) {
-		if (ro_buf->device_addr == buf->device_addr) {
-			buf->attr |= MSM_VIDC_ATTR_READ_ONLY;
-			print_vidc_buffer(VIDC_LOW, "low ", "ro buf removed", inst, ro_buf);
-			list_del(&ro_buf->list);
-			msm_memory_free(inst, ro_buf);
-			break;
-		}
+	ro_buf = msm_vidc_find_ro_buffer(inst, buf->device_addr);
+	if (ro_buf) {
+		buf->attr |= MSM_VIDC_ATTR_READ_ONLY;
+		print_vidc_buffer(VIDC_LOW, "low ", "ro buf removed", inst, ro_buf);
+		msm_vidc_unpin_delayed_unmap(inst, ro_buf);
+		hash_del(&ro_buf->addr_node);
+		list_del(&ro_buf->list);
+		msm_memory_free(inst, ro_buf);
 	}
 	return rc;
 }
 
+static void msm_vidc_map_lru_del(struct msm_vidc_inst *inst,
+	struct msm_vidc_map *map)
+{
+	if (list_empty(&map->lru))
+		return;
+
+	list_del_init(&map->lru);
+	inst->mappings.lru.count--;
+}
+
+/* map is idle: only the delayed unmap reference is left */
+static void msm_vidc_map_lru_add(struct msm_vidc_inst *inst,
+	struct msm_vidc_map *map)
+{
+	if (!map->skip_delayed_unmap || map->refcount != 1 || map->pinned)
+		return;
+	if (!list_empty(&map->lru))
+		return;
+
+	list_add_tail(&map->lru, &inst->mappings.lru.list);
+	inst->mappings.lru.count++;
+}
+
 int msm_vidc_memory_unmap_completely(struct msm_vidc_inst *inst,
 	struct msm_vidc_map *map)
 {
@@ -2101,6 +2121,8 @@ int msm_vidc_memory_unmap_completely(struct msm_vidc_inst *inst,
 			break;
 		if (!map->refcount) {
 			msm_vidc_memory_put_dmabuf(inst, map->dmabuf);
+			msm_vidc_map_lru_del(inst, map);
+			hash_del(&map->hnode);
 			list_del(&map->list);
 			msm_memory_free(inst, map);
 			break;
@@ -2112,10 +2134,7 @@ int msm_vidc_memory_unmap_completely(struct msm_vidc_inst *inst,
 int msm_vidc_set_auto_framerate(struct msm_vidc_inst *inst, u64 timestamp)
 {
 	struct msm_vidc_core *core;
-	struct msm_vidc_timestamp *ts;
-	struct msm_vidc_timestamp *prev = NULL;
-	u32 counter = 0, prev_fr = 0, curr_fr = 0;
-	u64 time_us = 0;
+	u32 curr_fr = 0;
 	int rc = 0;
 
 	if (!inst || !inst->core || !inst->capabilities) {
@@ -2132,24 +2151,20 @@ int msm_vidc_set_auto_framerate(struct msm_vidc_inst *inst, u64 timestamp)
 	if (rc)
 		goto exit;
 
-	list_for_each_entry(ts, &inst->timestamps.list, sort.list) {
-		if (prev) {
-			time_us = ts->sort.val - prev->sort.val;
-			prev_fr = curr_fr;
-			curr_fr = time_us ? DIV64_U64_ROUND_CLOSEST(USEC_PER_SEC, time_us) << 16 :
-					inst->auto_framerate;
-			if (curr_fr > inst->capabilities->cap[FRAME_RATE].max)
-				curr_fr = inst->capabilities->cap[FRAME_RATE].max;
-		}
-		prev = ts;
-		counter++;
-	}
-
-	if (counter < ENC_FPS_WINDOW)
+	if (inst->timestamps.count < ENC_FPS_WINDOW)
 		goto exit;
 
+	/* whole fps from the window median, unchanged if no spacing yet */
+	curr_fr = inst->timestamps.fps ?
+		(u32)min_t(u64, (inst->timestamps.fps + (1 << 15)) >> 16,
+			U16_MAX) << 16 :
+		inst->auto_framerate;
+	if (curr_fr > inst->capabilities->cap[FRAME_RATE].max)
+		curr_fr = inst->capabilities->cap[FRAME_RATE].max;
+
 	/* if framerate changed and stable for 2 frames, set to firmware */
-	if (curr_fr == prev_fr && curr_fr != inst->auto_framerate) {
+	if (curr_fr == inst->timestamps.prev_auto_fps &&
+			curr_fr != inst->auto_framerate) {
 		i_vpr_l(inst, "%s: updated fps:  %u -> %u\n", __func__,
 				inst->auto_framerate >> 16, curr_fr >> 16);
 		rc = venus_hfi_session_property(inst,
@@ -2166,157 +2181,119 @@ int msm_vidc_set_auto_framerate(struct msm_vidc_inst *inst, u64 timestamp)
 		}
 		inst->auto_framerate = curr_fr;
 	}
+	inst->timestamps.prev_auto_fps = curr_fr;
 exit:
 	return rc;
 }
 
 int msm_vidc_calc_window_avg_framerate(struct msm_vidc_inst *inst)
 {
-	struct msm_vidc_timestamp *ts;
-	struct msm_vidc_timestamp *prev = NULL;
-	u32 counter = 0;
-	u64 ts_ms = 0;
-
 	if (!inst) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return -EINVAL;
 	}
 
-	list_for_each_entry(ts, &inst->timestamps.list, sort.list) {
-		if (prev) {
-			if (ts->sort.val == prev->sort.val)
-				continue;
-
-			ts_ms += div_u64(ts->sort.val - prev->sort.val, 1000000);
-			counter++;
-		}
-		prev = ts;
-	}
-
-	return ts_ms ? (1000 * counter) / ts_ms : 0;
+	return (int)((inst->timestamps.avg_fps + (1 << 15)) >> 16);
 }
 
-static int msm_vidc_insert_sort(struct list_head *head,
-	struct msm_vidc_sort *entry)
+/* first index in sorted[0..count) whose value is not less than val */
+static u32 msm_vidc_ts_lower_bound(struct msm_vidc_timestamps *ts, u64 val)
 {
-	struct msm_vidc_sort *first, *node;
-	struct msm_vidc_sort *prev = NULL;
-	bool is_inserted = false;
-
-	if (!head || !entry) {
-		d_vpr_e("%s: invalid params\n", __func__);
-		return -EINVAL;
-	}
-
-	if (list_empty(head)) {
-		list_add(&entry->list, head);
-		return 0;
-	}
-
-	first = list_first_entry(head, struct msm_vidc_sort, list);
-	if (entry->val < first->val) {
-		list_add(&entry->list, head);
-		return 0;
-	}
+	u32 lo = 0, hi = ts->count, mid;
 
-	list_for_each_entry(node, head, list) {
-		if (prev &&
-			entry->val >= prev->val && entry->val <= node->val) {
-			list_add(&entry->list, &prev->list);
-			is_inserted = true;
-			break;
-		}
-		prev = node;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (ts->sorted[mid] < val)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
 
-	if (!is_inserted && prev)
-		list_add(&entry->list, &prev->list);
-
-	return 0;
+	return lo;
 }
 
-static struct msm_vidc_timestamp *msm_vidc_get_least_rank_ts(struct msm_vidc_inst *inst)
+/*
+ * Median spacing of the sorted window: reordered (B frame) and jittery
+ * timestamps only move the tails, dropped or repeated ones are ignored.
+ */
+static u64 msm_vidc_ts_median_delta(struct msm_vidc_timestamps *ts)
 {
-	struct msm_vidc_timestamp *ts, *final = NULL;
-	u64 least_rank = INT_MAX;
+	u64 delta[MAX_FPS_WINDOW], d;
+	u32 i, j, n = 0;
 
-	if (!inst) {
-		d_vpr_e("%s: Invalid params\n", __func__);
-		return NULL;
-	}
-
-	list_for_each_entry(ts, &inst->timestamps.list, sort.list) {
-		if (ts->rank < least_rank) {
-			least_rank = ts->rank;
-			final = ts;
-		}
+	for (i = 1; i < ts->count; i++) {
+		d = ts->sorted[i] - ts->sorted[i - 1];
+		if (!d)
+			continue;
+		/* insertion sort, the window is tiny */
+		for (j = n; j > 0 && delta[j - 1] > d; j--)
+			delta[j] = delta[j - 1];
+		delta[j] = d;
+		n++;
 	}
 
-	return final;
+	return n ? delta[(n - 1) / 2] : 0;
 }
 
 int msm_vidc_flush_ts(struct msm_vidc_inst *inst)
 {
-	struct msm_vidc_timestamp *temp, *ts = NULL;
-
 	if (!inst) {
 		d_vpr_e("%s: Invalid params\n", __func__);
 		return -EINVAL;
 	}
 
-	list_for_each_entry_safe(ts, temp, &inst->timestamps.list, sort.list) {
-		i_vpr_l(inst, "%s: flushing ts: val %lld, rank %%lld\n",
-			__func__, ts->sort.val, ts->rank);
-		list_del(&ts->sort.list);
-		msm_memory_free(inst, ts);
-	}
-	inst->timestamps.count = 0;
-	inst->timestamps.rank = 0;
+	i_vpr_l(inst, "%s: flushing %u ts, avg fps %llu\n", __func__,
+		inst->timestamps.count, inst->timestamps.avg_fps >> 16);
+	memset(&inst->timestamps, 0, sizeof(inst->timestamps));
 
 	return 0;
 }
 
 int msm_vidc_update_timestamp(struct msm_vidc_inst *inst, u64 timestamp)
 {
-	struct msm_vidc_timestamp *ts;
-	int rc = 0;
-	u32 window_size = 0;
+	struct msm_vidc_timestamps *ts;
+	u32 window_size = 0, i;
+	u64 delta, fps;
 
 	if (!inst) {
 		d_vpr_e("%s: Invalid params\n", __func__);
 		return -EINVAL;
 	}
-
-	ts = msm_memory_alloc(inst, MSM_MEM_POOL_TIMESTAMP);
-	if (!ts) {
-		i_vpr_e(inst, "%s: ts alloc failed\n", __func__);
-		return -ENOMEM;
-	}
-
-	INIT_LIST_HEAD(&ts->sort.list);
-	ts->sort.val = timestamp;
-	ts->rank = inst->timestamps.rank++;
-	rc = msm_vidc_insert_sort(&inst->timestamps.list, &ts->sort);
-	if (rc)
-		return rc;
-	inst->timestamps.count++;
+	ts = &inst->timestamps;
 
 	if (is_encode_session(inst))
 		window_size = ENC_FPS_WINDOW;
 	else
 		window_size = DEC_FPS_WINDOW;
 
-	/* keep sliding window */
-	if (inst->timestamps.count > window_size) {
-		ts = msm_vidc_get_least_rank_ts(inst);
-		if (!ts) {
-			i_vpr_e(inst, "%s: least rank ts is NULL\n", __func__);
-			return -EINVAL;
-		}
-		inst->timestamps.count--;
-		list_del(&ts->sort.list);
-		msm_memory_free(inst, ts);
+	/* keep sliding window: drop the oldest arrival */
+	if (ts->count >= window_size) {
+		i = msm_vidc_ts_lower_bound(ts, ts->ring[ts->head]);
+		memmove(&ts->sorted[i], &ts->sorted[i + 1],
+			(ts->count - i - 1) * sizeof(ts->sorted[0]));
+		ts->count--;
 	}
+	ts->ring[ts->head] = timestamp;
+	ts->head = (ts->head + 1) % window_size;
+
+	i = msm_vidc_ts_lower_bound(ts, timestamp);
+	memmove(&ts->sorted[i + 1], &ts->sorted[i],
+		(ts->count - i) * sizeof(ts->sorted[0]));
+	ts->sorted[i] = timestamp;
+	ts->count++;
+
+	delta = msm_vidc_ts_median_delta(ts);
+	if (!delta)
+		return 0;
+
+	fps = div64_u64(((u64)USEC_PER_SEC << 16) + delta / 2, delta);
+	ts->fps = fps;
+	if (!ts->avg_fps)
+		ts->avg_fps = fps;
+	else if (fps > ts->avg_fps)
+		ts->avg_fps += (fps - ts->avg_fps) >> FPS_EMA_SHIFT;
+	else
+		ts->avg_fps -= (ts->avg_fps - fps) >> FPS_EMA_SHIFT;
 
 	return 0;
 }
@@ -2353,6 +2330,7 @@ int msm_vidc_put_delayed_unmap(struct msm_vidc_inst *inst, struct msm_vidc_map *
 		return -EINVAL;
 	}
 
+	msm_vidc_map_lru_del(inst, map);
 	map->skip_delayed_unmap = 0;
 	rc = msm_vidc_memory_unmap(inst->core, map);
 	if (rc)
@@ -2360,6 +2338,7 @@ int msm_vidc_put_delayed_unmap(struct msm_vidc_inst *inst, struct msm_vidc_map *
 
 	if (!map->refcount) {
 		msm_vidc_memory_put_dmabuf(inst, map->dmabuf);
+		hash_del(&map->hnode);
 		list_del(&map->list);
 		msm_memory_free(inst, map);
 	}
@@ -2390,31 +2369,77 @@ int msm_vidc_unmap_buffers(struct msm_vidc_inst *inst,
 	return rc;
 }
 
+/*
+ * every map on an inst->mappings list is also hashed by dmabuf in
+ * inst->mappings.index, type tells which list it belongs to
+ */
+static struct msm_vidc_map *msm_vidc_find_map(struct msm_vidc_inst *inst,
+	enum msm_vidc_buffer_type type, struct dma_buf *dmabuf)
+{
+	struct msm_vidc_map *map;
+
+	hash_for_each_possible(inst->mappings.index, map, hnode, (unsigned long)dmabuf) {
+		if (map->dmabuf == dmabuf && map->type == type)
+			return map;
+	}
+
+	return NULL;
+}
+
+/*
+ * firmware holds a decoder output buffer as read only (and then in the
+ * release list) without a driver mapping reference, keep it off the lru
+ */
+void msm_vidc_pin_delayed_unmap(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buf)
+{
+	struct msm_vidc_map *map;
+
+	if (!inst || !buf) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return;
+	}
+
+	map = msm_vidc_find_map(inst, buf->type, buf->dmabuf);
+	if (!map)
+		return;
+
+	map->pinned++;
+	msm_vidc_map_lru_del(inst, map);
+}
+
+void msm_vidc_unpin_delayed_unmap(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buf)
+{
+	struct msm_vidc_map *map;
+
+	if (!inst || !buf) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return;
+	}
+
+	map = msm_vidc_find_map(inst, buf->type, buf->dmabuf);
+	if (!map || !map->pinned)
+		return;
+
+	map->pinned--;
+	msm_vidc_map_lru_add(inst, map);
+}
+
 int msm_vidc_unmap_driver_buf(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffer *buf)
 {
 	int rc = 0;
-	struct msm_vidc_mappings *mappings;
 	struct msm_vidc_map *map = NULL;
-	bool found = false;
 
 	if (!inst || !buf) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return -EINVAL;
 	}
 
-	mappings = msm_vidc_get_mappings(inst, buf->type, __func__);
-	if (!mappings)
-		return -EINVAL;
-
 	/* sanity check to see if it was not removed */
-	list_for_each_entry(map, &mappings->list, list) {
-		if (map->dmabuf == buf->dmabuf) {
-			found = true;
-			break;
-		}
-	}
-	if (!found) {
+	map = msm_vidc_find_map(inst, buf->type, buf->dmabuf);
+	if (!map) {
 		print_vidc_buffer(VIDC_ERR, "err ", "no buf in mappings", inst, buf);
 		return -EINVAL;
 	}
@@ -2428,8 +2453,12 @@ int msm_vidc_unmap_driver_buf(struct msm_vidc_inst *inst,
 	/* finally delete if refcount is zero */
 	if (!map->refcount) {
 		msm_vidc_memory_put_dmabuf(inst, map->dmabuf);
+		msm_vidc_map_lru_del(inst, map);
+		hash_del(&map->hnode);
 		list_del(&map->list);
 		msm_memory_free(inst, map);
+	} else {
+		msm_vidc_map_lru_add(inst, map);
 	}
 
 	return rc;
@@ -2441,7 +2470,6 @@ int msm_vidc_map_driver_buf(struct msm_vidc_inst *inst,
 	int rc = 0;
 	struct msm_vidc_mappings *mappings;
 	struct msm_vidc_map *map;
-	bool found = false;
 
 	if (!inst || !buf) {
 		d_vpr_e("%s: invalid params\n", __func__);
@@ -2456,13 +2484,8 @@ int msm_vidc_map_driver_buf(struct msm_vidc_inst *inst,
 	 * new buffer: map twice for delayed unmap feature sake
 	 * existing buffer: map once
 	 */
-	list_for_each_entry(map, &mappings->list, list) {
-		if (map->dmabuf == buf->dmabuf) {
-			found = true;
-			break;
-		}
-	}
-	if (!found) {
+	map = msm_vidc_find_map(inst, buf->type, buf->dmabuf);
+	if (!map) {
 		/* new buffer case */
 		map = msm_memory_alloc(inst, MSM_MEM_POOL_MAP);
 		if (!map) {
@@ -2470,7 +2493,9 @@ int msm_vidc_map_driver_buf(struct msm_vidc_inst *inst,
 			return -ENOMEM;
 		}
 		INIT_LIST_HEAD(&map->list);
+		INIT_LIST_HEAD(&map->lru);
 		map->type = buf->type;
+		map->owner = &inst->mem_stats;
 		map->dmabuf = msm_vidc_memory_get_dmabuf(inst, buf->fd);
 		if (!map->dmabuf)
 			return -EINVAL;
@@ -2485,16 +2510,132 @@ int msm_vidc_map_driver_buf(struct msm_vidc_inst *inst,
 			}
 		}
 		list_add_tail(&map->list, &mappings->list);
+		hash_add(inst->mappings.index, &map->hnode, (unsigned long)map->dmabuf);
+		if (map->skip_delayed_unmap)
+			inst->mappings.lru.misses++;
+	} else if (map->skip_delayed_unmap) {
+		/* still mapped from an earlier use, no iommu work needed */
+		inst->mappings.lru.hits++;
+		msm_vidc_map_lru_del(inst, map);
 	}
 	rc = msm_vidc_memory_map(inst->core, map);
-	if (rc)
+	if (rc) {
+		msm_vidc_map_lru_add(inst, map);
 		return rc;
+	}
 
 	buf->device_addr = map->device_addr;
 
 	return 0;
 }
 
+/*
+ * Firmware returns external buffers by vb2 index, or by device address
+ * for decoder output. Both keys are hashed per instance so buffer done
+ * handling does not walk buffers->list. A key may repeat (same vb2 index
+ * queued again before the previous one is released); entries are added
+ * at the bucket head, so the last match in a bucket is the oldest buffer,
+ * the same one a walk of buffers->list would find first.
+ */
+static void msm_vidc_buffer_index_add(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buf)
+{
+	hash_add(inst->buffers.index.index, &buf->index_node, buf->index);
+	hash_add(inst->buffers.index.addr, &buf->addr_node, buf->device_addr);
+}
+
+static void msm_vidc_buffer_index_del(struct msm_vidc_buffer *buf)
+{
+	hash_del(&buf->index_node);
+	hash_del(&buf->addr_node);
+}
+
+struct msm_vidc_buffer *msm_vidc_find_buffer_by_index(struct msm_vidc_inst *inst,
+	enum msm_vidc_buffer_type type, u32 index)
+{
+	struct msm_vidc_buffer *buf, *found = NULL;
+
+	if (!inst) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return NULL;
+	}
+
+	hash_for_each_possible(inst->buffers.index.index, buf, index_node, index) {
+		if (buf->type == type && buf->index == index)
+			found = buf;
+	}
+
+	return found;
+}
+
+/* read_only list entries are unique per device address */
+struct msm_vidc_buffer *msm_vidc_find_ro_buffer(struct msm_vidc_inst *inst,
+	u64 device_addr)
+{
+	struct msm_vidc_buffer *buf;
+
+	if (!inst) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return NULL;
+	}
+
+	hash_for_each_possible(inst->buffers.index.read_only, buf, addr_node, device_addr) {
+		if (buf->device_addr == device_addr)
+			return buf;
+	}
+
+	return NULL;
+}
+
+void msm_vidc_dpb_list_reset(struct msm_vidc_inst *inst)
+{
+	if (!inst) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return;
+	}
+
+	hash_init(inst->dpb_list.index);
+	inst->dpb_list.count = 0;
+}
+
+bool msm_vidc_is_dpb_buffer(struct msm_vidc_inst *inst,
+	u64 device_addr, u32 data_offset)
+{
+	struct msm_vidc_dpb_entry *entry;
+
+	if (!inst) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return false;
+	}
+
+	hash_for_each_possible(inst->dpb_list.index, entry, node, device_addr) {
+		if (entry->device_addr == device_addr &&
+			entry->data_offset == data_offset)
+			return true;
+	}
+
+	return false;
+}
+
+struct msm_vidc_buffer *msm_vidc_find_buffer_by_addr(struct msm_vidc_inst *inst,
+	enum msm_vidc_buffer_type type, u64 device_addr, u32 data_offset)
+{
+	struct msm_vidc_buffer *buf, *found = NULL;
+
+	if (!inst) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return NULL;
+	}
+
+	hash_for_each_possible(inst->buffers.index.addr, buf, addr_node, device_addr) {
+		if (buf->type == type && buf->device_addr == device_addr &&
+			buf->data_offset == data_offset)
+			found = buf;
+	}
+
+	return found;
+}
+
 int msm_vidc_put_driver_buf(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffer *buf)
 {
@@ -2510,6 +2651,7 @@ int msm_vidc_put_driver_buf(struct msm_vidc_inst *inst,
 	msm_vidc_memory_put_dmabuf(inst, buf->dmabuf);
 
 	/* delete the buffer from buffers->list */
+	msm_vidc_buffer_index_del(buf);
 	list_del(&buf->list);
 	msm_memory_free(inst, buf);
 
@@ -2560,6 +2702,8 @@ struct msm_vidc_buffer *msm_vidc_get_driver_buf(struct msm_vidc_inst *inst,
 	if (rc)
 		goto error;
 
+	msm_vidc_buffer_index_add(inst, buf);
+
 	return buf;
 
 error:
@@ -2572,9 +2716,7 @@ error:
 struct msm_vidc_buffer *get_meta_buffer(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffer *buf)
 {
-	struct msm_vidc_buffer *mbuf;
-	struct msm_vidc_buffers *buffers;
-	bool found = false;
+	enum msm_vidc_buffer_type meta_type;
 
 	if (!inst || !buf) {
 		d_vpr_e("%s: invalid params\n", __func__);
@@ -2582,24 +2724,16 @@ struct msm_vidc_buffer *get_meta_buffer(struct msm_vidc_inst *inst,
 	}
 
 	if (buf->type == MSM_VIDC_BUF_INPUT) {
-		buffers = &inst->buffers.input_meta;
+		meta_type = MSM_VIDC_BUF_INPUT_META;
 	} else if (buf->type == MSM_VIDC_BUF_OUTPUT) {
-		buffers = &inst->buffers.output_meta;
+		meta_type = MSM_VIDC_BUF_OUTPUT_META;
 	} else {
 		i_vpr_e(inst, "%s: invalid buffer type %d\n",
 			__func__, buf->type);
 		return NULL;
 	}
-	list_for_each_entry(mbuf, &buffers->list, list) {
-		if (mbuf->index == buf->index) {
-			found = true;
-			break;
-		}
-	}
-	if (!found)
-		return NULL;
 
-	return mbuf;
+	return msm_vidc_find_buffer_by_index(inst, meta_type, buf->index);
 }
 
 bool msm_vidc_is_super_buffer(struct msm_vidc_inst *inst)
@@ -2920,7 +3054,7 @@ int schedule_stats_work(struct msm_vidc_inst *inst)
 		return 0;
 	}
 	core = inst->core;
-	mod_delayed_work(inst->response_workq, &inst->stats_work,
+	mod_delayed_work(core->response_workq, &inst->stats_work,
 		msecs_to_jiffies(core->capabilities[STATS_TIMEOUT_MS].value));
 
 	return 0;
@@ -2956,6 +3090,24 @@ void msm_vidc_stats_handler(struct work_struct *work)
 	put_inst(inst);
 }
 
+/* sync the populated payload of buffer types selected in cache_op_types */
+static void msm_vidc_buffer_cache_op(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buf, enum msm_vidc_cache_op cache_op)
+{
+	struct msm_vidc_core *core = inst->core;
+	int rc;
+
+	if (!(core->cache_op_types & BIT(buf->type)))
+		return;
+	if (is_secure_session(inst) || !buf->dmabuf || !buf->data_size)
+		return;
+
+	rc = msm_vidc_memory_cache_operations(inst, buf->dmabuf, cache_op,
+		buf->data_offset, buf->data_size);
+	if (rc)
+		print_vidc_buffer(VIDC_ERR, "err ", "cache op failed", inst, buf);
+}
+
 static int msm_vidc_queue_buffer(struct msm_vidc_inst *inst, struct msm_vidc_buffer *buf)
 {
 	struct msm_vidc_buffer *meta;
@@ -2996,6 +3148,11 @@ static int msm_vidc_queue_buffer(struct msm_vidc_inst *inst, struct msm_vidc_buf
 		return -EINVAL;
 	}
 
+	/* cpu written payload must reach memory before firmware reads it */
+	msm_vidc_buffer_cache_op(inst, buf, MSM_VIDC_CACHE_CLEAN);
+	if (meta)
+		msm_vidc_buffer_cache_op(inst, meta, MSM_VIDC_CACHE_CLEAN);
+
 	if (msm_vidc_is_super_buffer(inst) && is_input_buffer(buf->type))
 		rc = venus_hfi_queue_super_buffer(inst, buf, meta);
 	else
@@ -3040,15 +3197,19 @@ int msm_vidc_queue_deferred_buffers(struct msm_vidc_inst *inst, enum msm_vidc_bu
 
 	msm_vidc_scale_power(inst, true);
 
+	rc = venus_hfi_batch_begin(inst);
+	if (rc)
+		return rc;
+
 	list_for_each_entry(buf, &buffers->list, list) {
 		if (!(buf->attr & MSM_VIDC_ATTR_DEFERRED))
 			continue;
 		rc = msm_vidc_queue_buffer(inst, buf);
 		if (rc)
-			return rc;
+			break;
 	}
 
-	return 0;
+	return venus_hfi_batch_end(inst, rc);
 }
 
 int msm_vidc_queue_buffer_single(struct msm_vidc_inst *inst, struct vb2_buffer *vb2)
@@ -3090,9 +3251,10 @@ int msm_vidc_destroy_internal_buffer(struct msm_vidc_inst *inst,
 	struct msm_vidc_buffers *buffers;
 	struct msm_vidc_allocations *allocations;
 	struct msm_vidc_mappings *mappings;
-	struct msm_vidc_alloc *alloc, *alloc_dummy;
-	struct msm_vidc_map  *map, *map_dummy;
+	struct msm_vidc_alloc *alloc, *found_alloc = NULL;
+	struct msm_vidc_map  *map, *found_map = NULL;
 	struct msm_vidc_buffer *buf, *dummy;
+	bool cached;
 
 	if (!inst || !inst->core) {
 		d_vpr_e("%s: invalid params\n", __func__);
@@ -3118,24 +3280,39 @@ int msm_vidc_destroy_internal_buffer(struct msm_vidc_inst *inst,
 	if (!mappings)
 		return -EINVAL;
 
-	list_for_each_entry_safe(map, map_dummy, &mappings->list, list) {
+	list_for_each_entry(map, &mappings->list, list) {
 		if (map->dmabuf == buffer->dmabuf) {
-			msm_vidc_memory_unmap(inst->core, map);
-			list_del(&map->list);
-			msm_memory_free(inst, map);
+			found_map = map;
 			break;
 		}
 	}
 
-	list_for_each_entry_safe(alloc, alloc_dummy, &allocations->list, list) {
+	list_for_each_entry(alloc, &allocations->list, list) {
 		if (alloc->dmabuf == buffer->dmabuf) {
-			msm_vidc_memory_free(inst->core, alloc);
-			list_del(&alloc->list);
-			msm_memory_free(inst, alloc);
+			found_alloc = alloc;
 			break;
 		}
 	}
 
+	/* keep the buffer mapped in the core cache for the next session */
+	cached = found_map && found_alloc &&
+		msm_vidc_buffer_cache_put(inst->core, found_alloc, found_map);
+
+	if (found_map) {
+		if (!cached)
+			msm_vidc_memory_unmap(inst->core, found_map);
+		hash_del(&found_map->hnode);
+		list_del(&found_map->list);
+		msm_memory_free(inst, found_map);
+	}
+
+	if (found_alloc) {
+		if (!cached)
+			msm_vidc_memory_free(inst->core, found_alloc);
+		list_del(&found_alloc->list);
+		msm_memory_free(inst, found_alloc);
+	}
+
 	list_for_each_entry_safe(buf, dummy, &buffers->list, list) {
 		if (buf->dmabuf == buffer->dmabuf) {
 			list_del(&buf->list);
@@ -3185,39 +3362,38 @@ int msm_vidc_get_internal_buffers(struct msm_vidc_inst *inst,
 	return 0;
 }
 
-int msm_vidc_create_internal_buffer(struct msm_vidc_inst *inst,
-	enum msm_vidc_buffer_type buffer_type, u32 index)
+/*
+ * Internal buffer creation is split in three steps so that the dma heap
+ * allocation and iommu mapping, which only need the core, can run on an
+ * unbound worker per buffer while the caller holds inst->lock:
+ *  prepare - driver structures and core cache lookup, under inst->lock
+ *  alloc   - msm_vidc_memory_alloc and msm_vidc_memory_map, or clearing
+ *            a cached buffer, lock free; releases the memory on failure
+ *  commit  - link buffer, alloc and map to the inst lists, under
+ *            inst->lock, or free them if the alloc step failed
+ */
+struct msm_vidc_internal_alloc {
+	struct work_struct          work;
+	struct msm_vidc_core       *core;
+	struct msm_vidc_buffer     *buffer;
+	struct msm_vidc_alloc      *alloc;
+	struct msm_vidc_map        *map;
+	bool                        cached;
+	int                         rc;
+};
+
+static int msm_vidc_prepare_internal_buffer(struct msm_vidc_inst *inst,
+	enum msm_vidc_buffer_type buffer_type, u32 index,
+	struct msm_vidc_internal_alloc *job)
 {
-	int rc = 0;
 	struct msm_vidc_buffers *buffers;
-	struct msm_vidc_allocations *allocations;
-	struct msm_vidc_mappings *mappings;
 	struct msm_vidc_buffer *buffer;
 	struct msm_vidc_alloc *alloc;
 	struct msm_vidc_map *map;
 
-	if (!inst || !inst->core) {
-		d_vpr_e("%s: invalid params\n", __func__);
-		return -EINVAL;
-	}
-	if (!is_internal_buffer(buffer_type)) {
-		i_vpr_e(inst, "%s: type %s is not internal\n",
-			__func__, buf_name(buffer_type));
-		return 0;
-	}
-
 	buffers = msm_vidc_get_buffers(inst, buffer_type, __func__);
 	if (!buffers)
 		return -EINVAL;
-	allocations = msm_vidc_get_allocations(inst, buffer_type, __func__);
-	if (!allocations)
-		return -EINVAL;
-	mappings = msm_vidc_get_mappings(inst, buffer_type, __func__);
-	if (!mappings)
-		return -EINVAL;
-
-	if (!buffers->size)
-		return 0;
 
 	buffer = msm_memory_alloc(inst, MSM_MEM_POOL_BUFFER);
 	if (!buffer) {
@@ -3228,11 +3404,11 @@ int msm_vidc_create_internal_buffer(struct msm_vidc_inst *inst,
 	buffer->type = buffer_type;
 	buffer->index = index;
 	buffer->buffer_size = buffers->size;
-	list_add_tail(&buffer->list, &buffers->list);
 
 	alloc = msm_memory_alloc(inst, MSM_MEM_POOL_ALLOC);
 	if (!alloc) {
 		i_vpr_e(inst, "%s: alloc failed\n", __func__);
+		msm_memory_free(inst, buffer);
 		return -ENOMEM;
 	}
 	INIT_LIST_HEAD(&alloc->list);
@@ -3241,63 +3417,208 @@ int msm_vidc_create_internal_buffer(struct msm_vidc_inst *inst,
 		buffer_type, __func__);
 	alloc->size = buffer->buffer_size;
 	alloc->secure = is_secure_region(alloc->region);
-	rc = msm_vidc_memory_alloc(inst->core, alloc);
-	if (rc)
-		return -ENOMEM;
-	list_add_tail(&alloc->list, &allocations->list);
+	alloc->owner = &inst->mem_stats;
 
 	map = msm_memory_alloc(inst, MSM_MEM_POOL_MAP);
 	if (!map) {
 		i_vpr_e(inst, "%s: map alloc failed\n", __func__);
+		msm_memory_free(inst, alloc);
+		msm_memory_free(inst, buffer);
 		return -ENOMEM;
 	}
 	INIT_LIST_HEAD(&map->list);
+	INIT_LIST_HEAD(&map->lru);
 	map->type = alloc->type;
 	map->region = alloc->region;
-	map->dmabuf = alloc->dmabuf;
-	rc = msm_vidc_memory_map(inst->core, map);
-	if (rc)
-		return -ENOMEM;
-	list_add_tail(&map->list, &mappings->list);
+	map->owner = &inst->mem_stats;
+
+	job->core = inst->core;
+	job->buffer = buffer;
+	job->alloc = alloc;
+	job->map = map;
+	job->cached = msm_vidc_buffer_cache_get(inst->core, alloc, map);
+	job->rc = 0;
+
+	return 0;
+}
+
+static void msm_vidc_alloc_internal_buffer(struct msm_vidc_internal_alloc *job)
+{
+	if (job->cached) {
+		job->rc = msm_vidc_memory_clear(job->alloc);
+		if (job->rc) {
+			msm_vidc_memory_unmap(job->core, job->map);
+			msm_vidc_memory_free(job->core, job->alloc);
+		}
+		return;
+	}
+
+	/* frees what it allocated on failure */
+	job->rc = msm_vidc_memory_alloc(job->core, job->alloc);
+	if (job->rc)
+		return;
+
+	job->map->dmabuf = job->alloc->dmabuf;
+	job->rc = msm_vidc_memory_map(job->core, job->map);
+	if (job->rc)
+		msm_vidc_memory_free(job->core, job->alloc);
+}
+
+static void msm_vidc_internal_alloc_handler(struct work_struct *work)
+{
+	msm_vidc_alloc_internal_buffer(container_of(work,
+		struct msm_vidc_internal_alloc, work));
+}
+
+static int msm_vidc_commit_internal_buffer(struct msm_vidc_inst *inst,
+	struct msm_vidc_internal_alloc *job)
+{
+	struct msm_vidc_buffers *buffers;
+	struct msm_vidc_allocations *allocations;
+	struct msm_vidc_mappings *mappings;
+	struct msm_vidc_buffer *buffer = job->buffer;
+	int rc = job->rc;
 
-	buffer->dmabuf = alloc->dmabuf;
-	buffer->device_addr = map->device_addr;
+	buffers = msm_vidc_get_buffers(inst, buffer->type, __func__);
+	allocations = msm_vidc_get_allocations(inst, buffer->type, __func__);
+	mappings = msm_vidc_get_mappings(inst, buffer->type, __func__);
+	if (!rc && (!buffers || !allocations || !mappings)) {
+		msm_vidc_memory_unmap(inst->core, job->map);
+		msm_vidc_memory_free(inst->core, job->alloc);
+		rc = -EINVAL;
+	}
+	if (rc) {
+		i_vpr_e(inst, "%s: failed to create %s buffer: %d\n",
+			__func__, buf_name(buffer->type), rc);
+		msm_memory_free(inst, job->map);
+		msm_memory_free(inst, job->alloc);
+		msm_memory_free(inst, buffer);
+		return rc;
+	}
+
+	list_add_tail(&buffer->list, &buffers->list);
+	list_add_tail(&job->alloc->list, &allocations->list);
+	list_add_tail(&job->map->list, &mappings->list);
+	hash_add(inst->mappings.index, &job->map->hnode,
+		(unsigned long)job->map->dmabuf);
+
+	buffer->dmabuf = job->alloc->dmabuf;
+	buffer->device_addr = job->map->device_addr;
 	i_vpr_h(inst, "%s: create: type: %8s, size: %9u, device_addr %#x\n", __func__,
-		buf_name(buffer_type), buffers->size, buffer->device_addr);
+		buf_name(buffer->type), buffer->buffer_size, buffer->device_addr);
 
 	return 0;
 }
 
-int msm_vidc_create_internal_buffers(struct msm_vidc_inst *inst,
-		enum msm_vidc_buffer_type buffer_type)
+int msm_vidc_create_internal_buffer(struct msm_vidc_inst *inst,
+	enum msm_vidc_buffer_type buffer_type, u32 index)
 {
 	int rc = 0;
 	struct msm_vidc_buffers *buffers;
-	int i;
+	struct msm_vidc_internal_alloc job;
 
 	if (!inst || !inst->core) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return -EINVAL;
 	}
+	if (!is_internal_buffer(buffer_type)) {
+		i_vpr_e(inst, "%s: type %s is not internal\n",
+			__func__, buf_name(buffer_type));
+		return 0;
+	}
 
 	buffers = msm_vidc_get_buffers(inst, buffer_type, __func__);
 	if (!buffers)
 		return -EINVAL;
 
-	if (buffers->reuse) {
-		i_vpr_l(inst, "%s: reuse enabled for %s\n", __func__, buf_name(buffer_type));
+	if (!buffers->size)
 		return 0;
+
+	rc = msm_vidc_prepare_internal_buffer(inst, buffer_type, index, &job);
+	if (rc)
+		return rc;
+
+	msm_vidc_alloc_internal_buffer(&job);
+
+	return msm_vidc_commit_internal_buffer(inst, &job);
+}
+
+/*
+ * Create the internal buffers of all given types, allocating and mapping
+ * them concurrently. Types with reuse set or without a size are skipped.
+ */
+int msm_vidc_create_internal_buffers_set(struct msm_vidc_inst *inst,
+	const enum msm_vidc_buffer_type *buffer_types, u32 num_types)
+{
+	int rc = 0, err;
+	struct msm_vidc_buffers *buffers;
+	struct msm_vidc_internal_alloc *jobs;
+	u32 i, j, count = 0, prepared = 0;
+
+	if (!inst || !inst->core || !buffer_types) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return -EINVAL;
 	}
 
-	for (i = 0; i < buffers->min_count; i++) {
-		rc = msm_vidc_create_internal_buffer(inst, buffer_type, i);
-		if (rc)
-			return rc;
+	for (i = 0; i < num_types; i++) {
+		if (!is_internal_buffer(buffer_types[i])) {
+			i_vpr_e(inst, "%s: type %s is not internal\n",
+				__func__, buf_name(buffer_types[i]));
+			return -EINVAL;
+		}
+		buffers = msm_vidc_get_buffers(inst, buffer_types[i], __func__);
+		if (!buffers)
+			return -EINVAL;
+		if (buffers->reuse) {
+			i_vpr_l(inst, "%s: reuse enabled for %s\n",
+				__func__, buf_name(buffer_types[i]));
+			continue;
+		}
+		if (buffers->size)
+			count += buffers->min_count;
+	}
+	if (!count)
+		return 0;
+
+	jobs = kcalloc(count, sizeof(*jobs), GFP_KERNEL);
+	if (!jobs) {
+		i_vpr_e(inst, "%s: jobs alloc failed\n", __func__);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < num_types && !rc; i++) {
+		buffers = msm_vidc_get_buffers(inst, buffer_types[i], __func__);
+		if (buffers->reuse || !buffers->size)
+			continue;
+		for (j = 0; j < buffers->min_count; j++) {
+			rc = msm_vidc_prepare_internal_buffer(inst,
+				buffer_types[i], j, &jobs[prepared]);
+			if (rc)
+				break;
+			INIT_WORK(&jobs[prepared].work, msm_vidc_internal_alloc_handler);
+			queue_work(system_unbound_wq, &jobs[prepared].work);
+			prepared++;
+		}
 	}
 
+	/* commit or free every prepared buffer, even after an error */
+	for (i = 0; i < prepared; i++) {
+		flush_work(&jobs[i].work);
+		err = msm_vidc_commit_internal_buffer(inst, &jobs[i]);
+		if (err && !rc)
+			rc = err;
+	}
+	kfree(jobs);
+
 	return rc;
 }
 
+int msm_vidc_create_internal_buffers(struct msm_vidc_inst *inst,
+		enum msm_vidc_buffer_type buffer_type)
+{
+	return msm_vidc_create_internal_buffers_set(inst, &buffer_type, 1);
+}
+
 int msm_vidc_queue_internal_buffers(struct msm_vidc_inst *inst,
 		enum msm_vidc_buffer_type buffer_type)
 {
@@ -3324,6 +3645,10 @@ int msm_vidc_queue_internal_buffers(struct msm_vidc_inst *inst,
 		return 0;
 	}
 
+	rc = venus_hfi_batch_begin(inst);
+	if (rc)
+		return rc;
+
 	list_for_each_entry_safe(buffer, dummy, &buffers->list, list) {
 		/* do not queue pending release buffers */
 		if (buffer->flags & MSM_VIDC_ATTR_PENDING_RELEASE)
@@ -3333,7 +3658,7 @@ int msm_vidc_queue_internal_buffers(struct msm_vidc_inst *inst,
 			continue;
 		rc = venus_hfi_queue_buffer(inst, buffer, NULL);
 		if (rc)
-			return rc;
+			break;
 		/* mark queued */
 		buffer->attr |= MSM_VIDC_ATTR_QUEUED;
 
@@ -3341,7 +3666,7 @@ int msm_vidc_queue_internal_buffers(struct msm_vidc_inst *inst,
 			buf_name(buffer->type), buffer->buffer_size, buffer->device_addr);
 	}
 
-	return 0;
+	return venus_hfi_batch_end(inst, rc);
 }
 
 int msm_vidc_alloc_and_queue_session_internal_buffers(struct msm_vidc_inst *inst,
@@ -3405,6 +3730,10 @@ int msm_vidc_release_internal_buffers(struct msm_vidc_inst *inst,
 		return 0;
 	}
 
+	rc = venus_hfi_batch_begin(inst);
+	if (rc)
+		return rc;
+
 	list_for_each_entry_safe(buffer, dummy, &buffers->list, list) {
 		/* do not release already pending release buffers */
 		if (buffer->attr & MSM_VIDC_ATTR_PENDING_RELEASE)
@@ -3414,7 +3743,7 @@ int msm_vidc_release_internal_buffers(struct msm_vidc_inst *inst,
 			continue;
 		rc = venus_hfi_release_buffer(inst, buffer);
 		if (rc)
-			return rc;
+			break;
 		/* mark pending release */
 		buffer->attr |= MSM_VIDC_ATTR_PENDING_RELEASE;
 
@@ -3422,7 +3751,7 @@ int msm_vidc_release_internal_buffers(struct msm_vidc_inst *inst,
 			buf_name(buffer->type), buffer->buffer_size, buffer->device_addr);
 	}
 
-	return 0;
+	return venus_hfi_batch_end(inst, rc);
 }
 
 int msm_vidc_vb2_buffer_done(struct msm_vidc_inst *inst,
@@ -3432,7 +3761,6 @@ int msm_vidc_vb2_buffer_done(struct msm_vidc_inst *inst,
 	struct vb2_queue *q;
 	struct vb2_buffer *vb2;
 	struct vb2_v4l2_buffer *vbuf;
-	bool found;
 
 	if (!inst || !buf) {
 		d_vpr_e("%s: invalid params\n", __func__);
@@ -3452,16 +3780,9 @@ int msm_vidc_vb2_buffer_done(struct msm_vidc_inst *inst,
 		return -EINVAL;
 	}
 
-	found = false;
-	list_for_each_entry(vb2, &q->queued_list, queued_entry) {
-		if (vb2->state != VB2_BUF_STATE_ACTIVE)
-			continue;
-		if (vb2->index == buf->index) {
-			found = true;
-			break;
-		}
-	}
-	if (!found) {
+	/* an active vb2 buffer is always on queued_list, index it directly */
+	vb2 = vb2_get_buffer(q, buf->index);
+	if (!vb2 || vb2->state != VB2_BUF_STATE_ACTIVE) {
 		print_vidc_buffer(VIDC_ERR, "err ", "vb2 not found for", inst, buf);
 		return -EINVAL;
 	}
@@ -3475,6 +3796,10 @@ int msm_vidc_vb2_buffer_done(struct msm_vidc_inst *inst,
 	else
 		state = VB2_BUF_STATE_DONE;
 
+	/* drop stale cpu lines over what firmware wrote */
+	if (is_output_buffer(buf->type) || is_output_meta_buffer(buf->type))
+		msm_vidc_buffer_cache_op(inst, buf, MSM_VIDC_CACHE_INVALIDATE);
+
 	vbuf = to_vb2_v4l2_buffer(vb2);
 	vbuf->flags = buf->flags;
 	vb2->timestamp = buf->timestamp;
@@ -3643,13 +3968,26 @@ int msm_vidc_add_session(struct msm_vidc_inst *inst)
 	list_for_each_entry(i, &core->instances, list)
 		count++;
 
-	if (count < core->capabilities[MAX_SESSION_COUNT].value) {
-		list_add_tail(&inst->list, &core->instances);
-	} else {
+	if (count >= core->capabilities[MAX_SESSION_COUNT].value) {
 		i_vpr_e(inst, "%s: max limit %d already running %d sessions\n",
 			__func__, core->capabilities[MAX_SESSION_COUNT].value, count);
 		rc = -EINVAL;
+		goto unlock;
 	}
+
+	rc = xa_insert(&core->session_xa, inst->session_id, inst, GFP_KERNEL);
+	if (rc) {
+		i_vpr_e(inst, "%s: failed to index session %#x, %d\n",
+			__func__, inst->session_id, rc);
+		goto unlock;
+	}
+
+	/* cmdq producers validate sessions under cmdq_lock alone */
+	mutex_lock(&core->cmdq_lock);
+	list_add_tail(&inst->list, &core->instances);
+	mutex_unlock(&core->cmdq_lock);
+
+unlock:
 	core_unlock(core, __func__);
 
 	return rc;
@@ -3668,14 +4006,18 @@ int msm_vidc_remove_session(struct msm_vidc_inst *inst)
 	core = inst->core;
 
 	core_lock(core, __func__);
+	mutex_lock(&core->cmdq_lock);
 	list_for_each_entry_safe(i, temp, &core->instances, list) {
 		if (i->session_id == inst->session_id) {
+			xa_erase(&core->session_xa, i->session_id);
+			msm_vidc_clk_aggregate_remove_locked(core, i);
 			list_del_init(&i->list);
 			list_add_tail(&i->list, &core->dangling_instances);
 			i_vpr_h(inst, "%s: removed session %#x\n",
 				__func__, i->session_id);
 		}
 	}
+	mutex_unlock(&core->cmdq_lock);
 	list_for_each_entry(i, &core->instances, list)
 		count++;
 	i_vpr_h(inst, "%s: remaining sessions %d\n", __func__, count);
@@ -4210,13 +4552,18 @@ int msm_vidc_core_deinit_locked(struct msm_vidc_core *core, bool force)
 	}
 
 	venus_hfi_core_deinit(core, force);
+	msm_vidc_buffer_cache_flush(core);
 
 	/* unlink all sessions from core, if any */
+	mutex_lock(&core->cmdq_lock);
 	list_for_each_entry_safe(inst, dummy, &core->instances, list) {
 		msm_vidc_change_inst_state(inst, MSM_VIDC_ERROR, __func__);
+		xa_erase(&core->session_xa, inst->session_id);
+		msm_vidc_clk_aggregate_remove_locked(core, inst);
 		list_del_init(&inst->list);
 		list_add_tail(&inst->list, &core->dangling_instances);
 	}
+	mutex_unlock(&core->cmdq_lock);
 	msm_vidc_change_core_state(core, MSM_VIDC_CORE_DEINIT, __func__);
 
 	return rc;
@@ -4788,7 +5135,6 @@ void msm_vidc_destroy_buffers(struct msm_vidc_inst *inst)
 {
 	struct msm_vidc_buffers *buffers;
 	struct msm_vidc_buffer *buf, *dummy;
-	struct msm_vidc_timestamp *ts, *dummy_ts;
 	struct msm_memory_dmabuf *dbuf, *dummy_dbuf;
 	struct response_work *work, *dummy_work = NULL;
 	static const enum msm_vidc_buffer_type ext_buf_types[] = {
@@ -4842,6 +5188,7 @@ void msm_vidc_destroy_buffers(struct msm_vidc_inst *inst)
 
 	list_for_each_entry_safe(buf, dummy, &inst->buffers.read_only.list, list) {
 		print_vidc_buffer(VIDC_ERR, "err ", "destroying ro buffer", inst, buf);
+		hash_del(&buf->addr_node);
 		list_del(&buf->list);
 		msm_memory_free(inst, buf);
 	}
@@ -4852,24 +5199,14 @@ void msm_vidc_destroy_buffers(struct msm_vidc_inst *inst)
 		msm_memory_free(inst, buf);
 	}
 
-	list_for_each_entry_safe(ts, dummy_ts, &inst->timestamps.list, sort.list) {
-		i_vpr_e(inst, "%s: removing ts: val %lld, rank %lld\n",
-			__func__, ts->sort.val, ts->rank);
-		list_del(&ts->sort.list);
-		msm_memory_free(inst, ts);
-	}
-
 	list_for_each_entry_safe(dbuf, dummy_dbuf, &inst->dmabuf_tracker, list) {
 		i_vpr_e(inst, "%s: removing dma_buf %#x, refcount %u\n",
 			__func__, dbuf->dmabuf, dbuf->refcount);
 		msm_vidc_memory_put_dmabuf_completely(inst, dbuf);
 	}
 
-	list_for_each_entry_safe(work, dummy_work, &inst->response_works, list) {
-		list_del(&work->list);
-		kfree(work->data);
-		kfree(work);
-	}
+	list_for_each_entry_safe(work, dummy_work, &inst->response_works, list)
+		put_response_work(inst, work);
 
 	/* destroy buffers from pool */
 	msm_memory_pools_deinit(inst);
@@ -4890,57 +5227,57 @@ static void msm_vidc_close_helper(struct kref *kref)
 		msm_venc_inst_deinit(inst);
 	msm_vidc_free_input_cr_list(inst);
 	msm_vidc_free_capabililty_list(inst, CHILD_LIST | FW_LIST);
-	if (inst->response_workq)
-		destroy_workqueue(inst->response_workq);
+	cancel_delayed_work_sync(&inst->response_work);
+	cancel_delayed_work_sync(&inst->stats_work);
+	deinit_response_works(inst);
 	msm_vidc_remove_dangling_session(inst);
 	kfree(inst->capabilities);
-	kfree(inst);
+	/* lockless lookups may still be reading inst->kref */
+	kfree_rcu(inst, rcu);
+}
+
+/*
+ * Active sessions are indexed in core->session_xa by session_id.
+ * Lookups run under rcu only; an entry found there is live until its
+ * kref drops to zero, and the inst itself is freed after a grace period.
+ */
+static struct msm_vidc_inst *__get_inst_rcu(struct msm_vidc_core *core,
+		u32 session_id, struct msm_vidc_inst *instance)
+{
+	struct msm_vidc_inst *inst;
+
+	rcu_read_lock();
+	inst = xa_load(&core->session_xa, session_id);
+	if (inst && instance && inst != instance)
+		inst = NULL;
+	if (inst && !kref_get_unless_zero(&inst->kref))
+		inst = NULL;
+	rcu_read_unlock();
+
+	return inst;
 }
 
 struct msm_vidc_inst *get_inst_ref(struct msm_vidc_core *core,
 		struct msm_vidc_inst *instance)
 {
-	struct msm_vidc_inst *inst = NULL;
-	bool matches = false;
-
 	if (!core) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return NULL;
 	}
 
-	mutex_lock(&core->lock);
-	list_for_each_entry(inst, &core->instances, list) {
-		if (inst == instance) {
-			matches = true;
-			break;
-		}
-	}
-	inst = (matches && kref_get_unless_zero(&inst->kref)) ? inst : NULL;
-	mutex_unlock(&core->lock);
-	return inst;
+	/* session_id is hash32_ptr(inst), so instance is never dereferenced */
+	return __get_inst_rcu(core, hash32_ptr(instance), instance);
 }
 
 struct msm_vidc_inst *get_inst(struct msm_vidc_core *core,
 		u32 session_id)
 {
-	struct msm_vidc_inst *inst = NULL;
-	bool matches = false;
-
 	if (!core) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return NULL;
 	}
 
-	mutex_lock(&core->lock);
-	list_for_each_entry(inst, &core->instances, list) {
-		if (inst->session_id == session_id) {
-			matches = true;
-			break;
-		}
-	}
-	inst = (matches && kref_get_unless_zero(&inst->kref)) ? inst : NULL;
-	mutex_unlock(&core->lock);
-	return inst;
+	return __get_inst_rcu(core, session_id, NULL);
 }
 
 void put_inst(struct msm_vidc_inst *inst)
@@ -5283,6 +5620,60 @@ int msm_vidc_check_core_mbps(struct msm_vidc_inst *inst)
 	return 0;
 }
 
+/*
+ * Optional admission by memory: the port buffers this session still has
+ * to map, on top of everything mapped on the core, must fit in mem_limit.
+ */
+static int msm_vidc_check_core_memory(struct msm_vidc_inst *inst)
+{
+	static const enum msm_vidc_buffer_type buffer_types[] = {
+		MSM_VIDC_BUF_INPUT, MSM_VIDC_BUF_INPUT_META,
+		MSM_VIDC_BUF_OUTPUT, MSM_VIDC_BUF_OUTPUT_META,
+		MSM_VIDC_BUF_BIN, MSM_VIDC_BUF_ARP, MSM_VIDC_BUF_COMV,
+		MSM_VIDC_BUF_NON_COMV, MSM_VIDC_BUF_LINE, MSM_VIDC_BUF_DPB,
+		MSM_VIDC_BUF_PERSIST, MSM_VIDC_BUF_VPSS,
+	};
+	struct msm_vidc_core *core;
+	struct msm_vidc_buffers *buffers;
+	u64 need = 0, held, used;
+	u32 i;
+
+	if (!inst || !inst->core) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return -EINVAL;
+	}
+	core = inst->core;
+
+	if (!core->mem_limit)
+		return 0;
+
+	/* internal buffer sizes are only known once they were computed */
+	for (i = 0; i < ARRAY_SIZE(buffer_types); i++) {
+		buffers = msm_vidc_get_buffers(inst, buffer_types[i], __func__);
+		if (!buffers)
+			continue;
+		need += (u64)buffers->size *
+			(buffers->min_count + buffers->extra_count);
+	}
+	held = atomic64_read(&inst->mem_stats.map_bytes);
+	need = need > held ? need - held : 0;
+	used = atomic64_read(&core->mem_stats.map_bytes);
+
+	/* idle buffers parked in the internal buffer cache can be given back */
+	if (used + need > core->mem_limit) {
+		msm_vidc_buffer_cache_flush(core);
+		used = atomic64_read(&core->mem_stats.map_bytes);
+	}
+
+	if (used + need > core->mem_limit) {
+		i_vpr_e(inst, "%s: memory overloaded. needed %llu, used %llu, max %llu\n",
+			__func__, need, used, core->mem_limit);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
 static int msm_vidc_check_core_mbpf(struct msm_vidc_inst *inst)
 {
 	u32 video_mbpf = 0, image_mbpf = 0, video_rt_mbpf = 0;
@@ -5666,6 +6057,10 @@ int msm_vidc_check_session_supported(struct msm_vidc_inst *inst)
 	if (rc)
 		goto exit;
 
+	rc = msm_vidc_check_core_memory(inst);
+	if (rc)
+		goto exit;
+
 	rc = msm_vidc_check_inst_mbpf(inst);
 	if (rc)
 		goto exit;
@@ -5785,3 +6180,7 @@ int msm_vidc_get_properties(struct msm_vidc_inst *inst)
 
 	return 0;
 }
+
+#if defined(CONFIG_MSM_VIDC_KUNIT_TEST)
+#include "../test/msm_vidc_driver_test.c"
+#endif
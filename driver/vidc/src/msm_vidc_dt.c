@@ -845,6 +845,33 @@ remove_cb:
 	return rc;
 }
 
+/* context banks are looked up by buffer region on every map */
+static void msm_vidc_set_region_context_bank(struct msm_vidc_dt *dt,
+		struct context_bank_info *cb)
+{
+	u32 i;
+	static const struct {
+		enum msm_vidc_buffer_region region;
+		const char *name;
+	} cb_region_name[] = {
+		{MSM_VIDC_NON_SECURE,           "venus_ns"             },
+		{MSM_VIDC_NON_SECURE_PIXEL,     "venus_ns_pixel"       },
+		{MSM_VIDC_SECURE_PIXEL,         "venus_sec_pixel"      },
+		{MSM_VIDC_SECURE_NONPIXEL,      "venus_sec_non_pixel"  },
+		{MSM_VIDC_SECURE_BITSTREAM,     "venus_sec_bitstream"  },
+	};
+
+	if (!cb->name)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(cb_region_name); i++) {
+		if (!strcmp(cb->name, cb_region_name[i].name)) {
+			dt->cb_region[cb_region_name[i].region] = cb;
+			return;
+		}
+	}
+}
+
 static int msm_vidc_populate_context_bank(struct device *dev,
 		struct msm_vidc_core *core)
 {
@@ -898,6 +925,7 @@ static int msm_vidc_populate_context_bank(struct device *dev,
 
 	iommu_set_fault_handler(cb->domain,
 		msm_vidc_smmu_fault_handler, (void *)core);
+	msm_vidc_set_region_context_bank(core->dt, cb);
 
 	return 0;
 
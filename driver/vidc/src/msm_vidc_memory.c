@@ -8,6 +8,7 @@
 #include <linux/dma-mapping.h>
 #include <linux/qcom-dma-mapping.h>
 #include <linux/mem-buf.h>
+#include <linux/slab.h>
 #include <soc/qcom/secure_buffer.h>
 
 #include "msm_vidc_memory.h"
@@ -18,46 +19,92 @@
 #include "msm_vidc_core.h"
 #include "msm_vidc_events.h"
 
-struct msm_vidc_buf_region_name {
-	enum msm_vidc_buffer_region region;
-	char *name;
-};
-
 struct context_bank_info *get_context_bank(struct msm_vidc_core *core,
 		enum msm_vidc_buffer_region region)
 {
-	const char *name;
-	struct context_bank_info *cb = NULL, *match = NULL;
-	static const struct msm_vidc_buf_region_name buf_region_name[] = {
-		{MSM_VIDC_REGION_NONE,          "none"                 },
-		{MSM_VIDC_NON_SECURE,           "venus_ns"             },
-		{MSM_VIDC_NON_SECURE_PIXEL,     "venus_ns_pixel"       },
-		{MSM_VIDC_SECURE_PIXEL,         "venus_sec_pixel"      },
-		{MSM_VIDC_SECURE_NONPIXEL,      "venus_sec_non_pixel"  },
-		{MSM_VIDC_SECURE_BITSTREAM,     "venus_sec_bitstream"  },
-	};
-
-	if (!region || region > ARRAY_SIZE(buf_region_name))
-		goto exit;
+	struct context_bank_info *cb;
 
-	if (buf_region_name[region].region != region)
-		goto exit;
+	if (!region || region >= MSM_VIDC_REGION_MAX) {
+		d_vpr_e("Invalid region %#x\n", region);
+		return NULL;
+	}
 
-	name = buf_region_name[region].name;
+	/* filled in by msm_vidc_dt.c as context banks probe */
+	cb = core->dt->cb_region[region];
+	if (!cb)
+		d_vpr_e("cb not found for region %#x\n", region);
 
-	list_for_each_entry(cb, &core->dt->context_banks, list) {
-		if (!strcmp(cb->name, name)) {
-			match = cb;
-			break;
-		}
+	return cb;
+}
+
+static const char *msm_vidc_dma_heap_name(enum msm_vidc_buffer_region region)
+{
+	switch (region) {
+	case MSM_VIDC_SECURE_PIXEL:
+		return "qcom,secure-pixel";
+	case MSM_VIDC_SECURE_NONPIXEL:
+		return "qcom,secure-non-pixel";
+	case MSM_VIDC_SECURE_BITSTREAM:
+	default:
+		return "qcom,system";
 	}
-	if (!match)
-		d_vpr_e("cb not found for region %#x\n", region);
+}
 
-	return match;
+/*
+ * dma heaps are resolved once per region and kept till core deinit. A
+ * heap not registered yet at probe is looked up again on first use.
+ */
+static struct dma_heap *msm_vidc_get_dma_heap(struct msm_vidc_core *core,
+	enum msm_vidc_buffer_region region)
+{
+	struct dma_heap *heap, *old;
+
+	heap = READ_ONCE(core->dma_heaps[region]);
+	if (heap)
+		return heap;
+
+	heap = dma_heap_find(msm_vidc_dma_heap_name(region));
+	if (!heap)
+		return NULL;
+
+	old = cmpxchg(&core->dma_heaps[region], NULL, heap);
+	if (old) {
+		dma_heap_put(heap);
+		heap = old;
+	}
+
+	return heap;
+}
+
+void msm_vidc_dma_heaps_init(struct msm_vidc_core *core)
+{
+	u32 i;
+
+	for (i = MSM_VIDC_NON_SECURE; i < MSM_VIDC_REGION_MAX; i++)
+		msm_vidc_get_dma_heap(core, i);
+}
+
+void msm_vidc_dma_heaps_deinit(struct msm_vidc_core *core)
+{
+	u32 i;
+
+	for (i = 0; i < MSM_VIDC_REGION_MAX; i++) {
+		if (core->dma_heaps[i])
+			dma_heap_put(core->dma_heaps[i]);
+		core->dma_heaps[i] = NULL;
+	}
+}
+
+static struct msm_memory_dmabuf *msm_vidc_memory_find_dmabuf(
+	struct msm_vidc_inst *inst, struct dma_buf *dmabuf)
+{
+	struct msm_memory_dmabuf *buf;
+
+	hash_for_each_possible(inst->dmabuf_index, buf, hnode, (unsigned long)dmabuf) {
+		if (buf->dmabuf == dmabuf)
+			return buf;
+	}
 
-exit:
-	d_vpr_e("Invalid region %#x\n", region);
 	return NULL;
 }
 
@@ -65,7 +112,6 @@ struct dma_buf *msm_vidc_memory_get_dmabuf(struct msm_vidc_inst *inst, int fd)
 {
 	struct msm_memory_dmabuf *buf = NULL;
 	struct dma_buf *dmabuf = NULL;
-	bool found = false;
 
 	if (!inst) {
 		d_vpr_e("%s: invalid params\n", __func__);
@@ -81,14 +127,9 @@ struct dma_buf *msm_vidc_memory_get_dmabuf(struct msm_vidc_inst *inst, int fd)
 	}
 
 	/* track dmabuf - inc refcount if already present */
-	list_for_each_entry(buf, &inst->dmabuf_tracker, list) {
-		if (buf->dmabuf == dmabuf) {
-			buf->refcount++;
-			found = true;
-			break;
-		}
-	}
-	if (found) {
+	buf = msm_vidc_memory_find_dmabuf(inst, dmabuf);
+	if (buf) {
+		buf->refcount++;
 		/* put local dmabuf ref */
 		dma_buf_put(dmabuf);
 		return dmabuf;
@@ -108,6 +149,7 @@ struct dma_buf *msm_vidc_memory_get_dmabuf(struct msm_vidc_inst *inst, int fd)
 
 	/* add new dmabuf entry to tracker */
 	list_add_tail(&buf->list, &inst->dmabuf_tracker);
+	hash_add(inst->dmabuf_index, &buf->hnode, (unsigned long)dmabuf);
 
 	return dmabuf;
 }
@@ -115,7 +157,6 @@ struct dma_buf *msm_vidc_memory_get_dmabuf(struct msm_vidc_inst *inst, int fd)
 void msm_vidc_memory_put_dmabuf(struct msm_vidc_inst *inst, struct dma_buf *dmabuf)
 {
 	struct msm_memory_dmabuf *buf = NULL;
-	bool found = false;
 
 	if (!inst || !dmabuf) {
 		d_vpr_e("%s: invalid params\n", __func__);
@@ -123,23 +164,19 @@ void msm_vidc_memory_put_dmabuf(struct msm_vidc_inst *inst, struct dma_buf *dmab
 	}
 
 	/* track dmabuf - dec refcount if already present */
-	list_for_each_entry(buf, &inst->dmabuf_tracker, list) {
-		if (buf->dmabuf == dmabuf) {
-			buf->refcount--;
-			found = true;
-			break;
-		}
-	}
-	if (!found) {
+	buf = msm_vidc_memory_find_dmabuf(inst, dmabuf);
+	if (!buf) {
 		i_vpr_e(inst, "%s: invalid dmabuf %#x\n", __func__, dmabuf);
 		return;
 	}
+	buf->refcount--;
 
 	/* non-zero refcount - do nothing */
 	if (buf->refcount)
 		return;
 
 	/* remove dmabuf entry from tracker */
+	hash_del(&buf->hnode);
 	list_del(&buf->list);
 
 	/* release dmabuf strong ref from tracker */
@@ -161,6 +198,7 @@ void msm_vidc_memory_put_dmabuf_completely(struct msm_vidc_inst *inst,
 		buf->refcount--;
 		if (!buf->refcount) {
 			/* remove dmabuf entry from tracker */
+			hash_del(&buf->hnode);
 			list_del(&buf->list);
 
 			/* release dmabuf strong ref from tracker */
@@ -173,6 +211,31 @@ void msm_vidc_memory_put_dmabuf_completely(struct msm_vidc_inst *inst,
 	}
 }
 
+static void msm_vidc_memory_charge(struct msm_vidc_mem_stats *stats,
+	s64 alloc_bytes, s64 map_bytes)
+{
+	if (!stats)
+		return;
+
+	atomic64_add(alloc_bytes, &stats->alloc_bytes);
+	atomic64_add(map_bytes, &stats->map_bytes);
+}
+
+/* account to the core and to the owning session, if any */
+static void msm_vidc_memory_account(struct msm_vidc_core *core,
+	struct msm_vidc_mem_stats *owner, const char *op,
+	s64 alloc_bytes, s64 map_bytes)
+{
+	if (!core)
+		return;
+
+	msm_vidc_memory_charge(&core->mem_stats, alloc_bytes, map_bytes);
+	msm_vidc_memory_charge(owner, alloc_bytes, map_bytes);
+	trace_msm_vidc_memory_usage(op, alloc_bytes ? alloc_bytes : map_bytes,
+		atomic64_read(&core->mem_stats.alloc_bytes),
+		atomic64_read(&core->mem_stats.map_bytes));
+}
+
 static bool is_non_secure_buffer(struct dma_buf *dmabuf)
 {
 	return mem_buf_dma_buf_exclusive_owner(dmabuf);
@@ -261,6 +324,7 @@ int msm_vidc_memory_map(struct msm_vidc_core *core, struct msm_vidc_map *map)
 	map->table = table;
 	map->attach = attach;
 	map->refcount++;
+	msm_vidc_memory_account(core, map->owner, "MAP", 0, map->dmabuf->size);
 
 exit:
 	d_vpr_l(
@@ -304,6 +368,8 @@ int msm_vidc_memory_unmap(struct msm_vidc_core *core,
 
 	dma_buf_unmap_attachment(map->attach, map->table, DMA_BIDIRECTIONAL);
 	dma_buf_detach(map->dmabuf, map->attach);
+	msm_vidc_memory_account(core, map->owner, "UNMAP", 0,
+		-(s64)map->dmabuf->size);
 
 	map->device_addr = 0x0;
 	map->attach = NULL;
@@ -318,12 +384,13 @@ int msm_vidc_memory_alloc(struct msm_vidc_core *core, struct msm_vidc_alloc *mem
 	int rc = 0;
 	int size = 0;
 	struct dma_heap *heap;
-	char *heap_name = NULL;
+	const char *heap_name = NULL;
+	enum msm_vidc_buffer_region region;
 	struct mem_buf_lend_kernel_arg lend_arg;
 	int vmids[1];
 	int perms[1];
 
-	if (!mem) {
+	if (!core || !mem) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return -EINVAL;
 	}
@@ -333,23 +400,24 @@ int msm_vidc_memory_alloc(struct msm_vidc_core *core, struct msm_vidc_alloc *mem
 	if (mem->secure) {
 		switch (mem->region) {
 		case MSM_VIDC_SECURE_PIXEL:
-			heap_name = "qcom,secure-pixel";
-			break;
 		case MSM_VIDC_SECURE_NONPIXEL:
-			heap_name = "qcom,secure-non-pixel";
-			break;
 		case MSM_VIDC_SECURE_BITSTREAM:
-			heap_name = "qcom,system";
+			region = mem->region;
 			break;
 		default:
 			d_vpr_e("invalid secure region : %#x\n", mem->region);
 			return -EINVAL;
 		}
 	} else {
-		heap_name = "qcom,system";
+		region = MSM_VIDC_NON_SECURE;
 	}
 
-	heap = dma_heap_find(heap_name);
+	heap_name = msm_vidc_dma_heap_name(region);
+	heap = msm_vidc_get_dma_heap(core, region);
+	if (!heap) {
+		d_vpr_e("%s: dma heap %s not found\n", __func__, heap_name);
+		return -ENOMEM;
+	}
 	mem->dmabuf = dma_heap_buffer_alloc(heap, size, 0, 0);
 	if (IS_ERR_OR_NULL(mem->dmabuf)) {
 		d_vpr_e("%s: dma heap %s alloc failed\n", __func__, heap_name);
@@ -357,6 +425,7 @@ int msm_vidc_memory_alloc(struct msm_vidc_core *core, struct msm_vidc_alloc *mem
 		rc = -ENOMEM;
 		goto error;
 	}
+	msm_vidc_memory_account(core, mem->owner, "ALLOC", mem->dmabuf->size, 0);
 
 	if (mem->secure && mem->type == MSM_VIDC_BUF_BIN)
 	{
@@ -423,6 +492,8 @@ int msm_vidc_memory_free(struct msm_vidc_core *core, struct msm_vidc_alloc *mem)
 	}
 
 	if (mem->dmabuf) {
+		msm_vidc_memory_account(core, mem->owner, "FREE",
+			-(s64)mem->dmabuf->size, 0);
 		dma_heap_buffer_free(mem->dmabuf);
 		mem->dmabuf = NULL;
 	}
@@ -430,6 +501,211 @@ int msm_vidc_memory_free(struct msm_vidc_core *core, struct msm_vidc_alloc *mem)
 	return rc;
 };
 
+void msm_vidc_buffer_cache_init(struct msm_vidc_core *core)
+{
+	struct msm_vidc_buffer_cache *cache = &core->buffer_cache;
+	u32 i, j;
+
+	mutex_init(&cache->lock);
+	for (i = 0; i < MSM_VIDC_REGION_MAX; i++)
+		for (j = 0; j < INTERNAL_BUF_CACHE_CLASSES; j++)
+			INIT_LIST_HEAD(&cache->bucket[i][j]);
+	cache->max_bytes = INTERNAL_BUF_CACHE_MAX_VALUE;
+}
+
+void msm_vidc_buffer_cache_deinit(struct msm_vidc_core *core)
+{
+	msm_vidc_buffer_cache_flush(core);
+	mutex_destroy(&core->buffer_cache.lock);
+}
+
+/* unmap and free a buffer taken off the cache lists */
+static void msm_vidc_buffer_cache_release(struct msm_vidc_core *core,
+	struct msm_vidc_cached_buffer *cbuf)
+{
+	struct msm_vidc_alloc alloc;
+	struct msm_vidc_map map;
+
+	memset(&map, 0, sizeof(map));
+	map.region = cbuf->region;
+	map.dmabuf = cbuf->dmabuf;
+	map.device_addr = cbuf->device_addr;
+	map.table = cbuf->table;
+	map.attach = cbuf->attach;
+	map.refcount = 1;
+	msm_vidc_memory_unmap(core, &map);
+
+	memset(&alloc, 0, sizeof(alloc));
+	alloc.region = cbuf->region;
+	alloc.size = cbuf->dmabuf->size;
+	alloc.secure = cbuf->secure;
+	alloc.map_kernel = cbuf->map_kernel;
+	alloc.dmabuf = cbuf->dmabuf;
+	alloc.kvaddr = cbuf->kvaddr;
+	msm_vidc_memory_free(core, &alloc);
+
+	kfree(cbuf);
+}
+
+/*
+ * Zero a buffer taken from the core cache before the new session uses
+ * it, as a fresh dma heap allocation would be, so no session sees what
+ * another one left there.
+ */
+int msm_vidc_memory_clear(struct msm_vidc_alloc *mem)
+{
+	void *kvaddr;
+	int rc = 0;
+
+	if (!mem || !mem->dmabuf || mem->secure) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return -EINVAL;
+	}
+
+	rc = dma_buf_begin_cpu_access(mem->dmabuf, DMA_TO_DEVICE);
+	if (rc)
+		return rc;
+
+	kvaddr = mem->kvaddr ? mem->kvaddr : dma_buf_vmap(mem->dmabuf);
+	if (!kvaddr) {
+		rc = -EIO;
+		goto exit;
+	}
+	memset(kvaddr, 0, mem->dmabuf->size);
+	if (!mem->kvaddr)
+		dma_buf_vunmap(mem->dmabuf, kvaddr);
+
+exit:
+	dma_buf_end_cpu_access(mem->dmabuf, DMA_TO_DEVICE);
+	return rc;
+}
+
+/*
+ * secure buffers cannot be cleared from the cpu, persist and arp buffers
+ * are kept by firmware for the whole session, so none of them are cached
+ */
+static bool msm_vidc_buffer_cacheable(struct msm_vidc_alloc *alloc)
+{
+	return !alloc->secure && alloc->type != MSM_VIDC_BUF_PERSIST &&
+		alloc->type != MSM_VIDC_BUF_ARP &&
+		alloc->region > MSM_VIDC_REGION_NONE &&
+		alloc->region < MSM_VIDC_REGION_MAX;
+}
+
+void msm_vidc_buffer_cache_flush(struct msm_vidc_core *core)
+{
+	struct msm_vidc_buffer_cache *cache = &core->buffer_cache;
+	struct msm_vidc_cached_buffer *cbuf, *dummy;
+	u32 i, j;
+
+	mutex_lock(&cache->lock);
+	for (i = 0; i < MSM_VIDC_REGION_MAX; i++) {
+		for (j = 0; j < INTERNAL_BUF_CACHE_CLASSES; j++) {
+			list_for_each_entry_safe(cbuf, dummy, &cache->bucket[i][j], list) {
+				list_del(&cbuf->list);
+				msm_vidc_buffer_cache_release(core, cbuf);
+			}
+		}
+	}
+	cache->bytes = 0;
+	mutex_unlock(&cache->lock);
+}
+
+/*
+ * take a cached buffer big enough for alloc->size, fills alloc and map;
+ * the caller clears it with msm_vidc_memory_clear() before use
+ */
+bool msm_vidc_buffer_cache_get(struct msm_vidc_core *core,
+	struct msm_vidc_alloc *alloc, struct msm_vidc_map *map)
+{
+	struct msm_vidc_buffer_cache *cache = &core->buffer_cache;
+	struct msm_vidc_cached_buffer *cbuf, *found = NULL;
+	u32 size;
+
+	size = ALIGN(alloc->size, SZ_4K);
+	if (!size || !msm_vidc_buffer_cacheable(alloc))
+		return false;
+
+	mutex_lock(&cache->lock);
+	list_for_each_entry(cbuf, &cache->bucket[alloc->region][ilog2(size)], list) {
+		if (cbuf->dmabuf->size >= size && cbuf->secure == alloc->secure &&
+			cbuf->map_kernel == alloc->map_kernel) {
+			found = cbuf;
+			break;
+		}
+	}
+	if (!found) {
+		cache->misses++;
+		mutex_unlock(&cache->lock);
+		return false;
+	}
+	list_del(&found->list);
+	cache->bytes -= found->dmabuf->size;
+	cache->hits++;
+	mutex_unlock(&cache->lock);
+
+	alloc->dmabuf = found->dmabuf;
+	alloc->kvaddr = found->kvaddr;
+	map->dmabuf = found->dmabuf;
+	map->device_addr = found->device_addr;
+	map->table = found->table;
+	map->attach = found->attach;
+	map->refcount = 1;
+	/* charged to the core all along, now also to the new session */
+	msm_vidc_memory_charge(alloc->owner, found->dmabuf->size, 0);
+	msm_vidc_memory_charge(map->owner, 0, found->dmabuf->size);
+	d_vpr_l("%s: reuse size %u for %u, region %d, device_addr %#llx\n",
+		__func__, (u32)found->dmabuf->size, size, alloc->region,
+		map->device_addr);
+	kfree(found);
+
+	return true;
+}
+
+/* park a released internal buffer; on success caller must not free it */
+bool msm_vidc_buffer_cache_put(struct msm_vidc_core *core,
+	struct msm_vidc_alloc *alloc, struct msm_vidc_map *map)
+{
+	struct msm_vidc_buffer_cache *cache = &core->buffer_cache;
+	struct msm_vidc_cached_buffer *cbuf;
+	size_t size;
+
+	if (!alloc->dmabuf || map->refcount != 1 || map->dmabuf != alloc->dmabuf ||
+		!msm_vidc_buffer_cacheable(alloc))
+		return false;
+
+	size = alloc->dmabuf->size;
+	mutex_lock(&cache->lock);
+	if (cache->bytes + size > cache->max_bytes) {
+		mutex_unlock(&cache->lock);
+		return false;
+	}
+
+	cbuf = kzalloc(sizeof(*cbuf), GFP_KERNEL);
+	if (!cbuf) {
+		mutex_unlock(&cache->lock);
+		return false;
+	}
+	INIT_LIST_HEAD(&cbuf->list);
+	cbuf->region = alloc->region;
+	cbuf->secure = alloc->secure;
+	cbuf->map_kernel = alloc->map_kernel;
+	cbuf->dmabuf = alloc->dmabuf;
+	cbuf->kvaddr = alloc->kvaddr;
+	cbuf->device_addr = map->device_addr;
+	cbuf->table = map->table;
+	cbuf->attach = map->attach;
+	list_add_tail(&cbuf->list, &cache->bucket[cbuf->region][ilog2(size)]);
+	cache->bytes += size;
+	mutex_unlock(&cache->lock);
+
+	/* the core keeps it, the session no longer holds it */
+	msm_vidc_memory_charge(alloc->owner, -(s64)size, 0);
+	msm_vidc_memory_charge(map->owner, 0, -(s64)size);
+
+	return true;
+}
+
 void *msm_memory_alloc(struct msm_vidc_inst *inst, enum msm_memory_pool_type type)
 {
 	struct msm_memory_alloc_header *hdr;
@@ -447,8 +723,9 @@ void *msm_memory_alloc(struct msm_vidc_inst *inst, enum msm_memory_pool_type typ
 			struct msm_memory_alloc_header, list);
 		list_del_init(&hdr->list);
 
-		/* reset existing data */
-		memset((char *)hdr->buf, 0, pool->size);
+		/* reset existing data, unless every field is set by the caller */
+		if (pool->reset)
+			memset((char *)hdr->buf, 0, pool->size);
 
 		/* add to busy pool */
 		list_add_tail(&hdr->list, &pool->busy_pool);
@@ -459,7 +736,7 @@ void *msm_memory_alloc(struct msm_vidc_inst *inst, enum msm_memory_pool_type typ
 		return hdr->buf;
 	}
 
-	hdr = kzalloc(pool->size + sizeof(struct msm_memory_alloc_header), GFP_KERNEL);
+	hdr = kmem_cache_zalloc(pool->cache, GFP_KERNEL);
 	if (!hdr) {
 		i_vpr_e(inst, "%s: buffer allocation failed\n", __func__);
 		return NULL;
@@ -533,14 +810,14 @@ static void msm_vidc_destroy_pool_buffers(struct msm_vidc_inst *inst,
 	/* destroy all free buffers */
 	list_for_each_entry_safe(hdr, dummy, &pool->free_pool, list) {
 		list_del(&hdr->list);
-		kfree(hdr);
+		kmem_cache_free(pool->cache, hdr);
 		fcount++;
 	}
 
 	/* destroy all busy buffers */
 	list_for_each_entry_safe(hdr, dummy, &pool->busy_pool, list) {
 		list_del(&hdr->list);
-		kfree(hdr);
+		kmem_cache_free(pool->cache, hdr);
 		bcount++;
 	}
 
@@ -566,24 +843,68 @@ struct msm_vidc_type_size_name {
 	enum msm_memory_pool_type type;
 	u32                       size;
 	char                     *name;
+	bool                      reset;
 };
 
+/*
+ * reset false: the only allocation site initializes every field, so an
+ * object taken back from the free pool is not zeroed again
+ */
 static struct msm_vidc_type_size_name buftype_size_name_arr[] = {
-	{MSM_MEM_POOL_BUFFER,     sizeof(struct msm_vidc_buffer),     "MSM_MEM_POOL_BUFFER"     },
-	{MSM_MEM_POOL_MAP,        sizeof(struct msm_vidc_map),        "MSM_MEM_POOL_MAP"        },
-	{MSM_MEM_POOL_ALLOC,      sizeof(struct msm_vidc_alloc),      "MSM_MEM_POOL_ALLOC"      },
-	{MSM_MEM_POOL_TIMESTAMP,  sizeof(struct msm_vidc_timestamp),  "MSM_MEM_POOL_TIMESTAMP"  },
-	{MSM_MEM_POOL_DMABUF,     sizeof(struct msm_memory_dmabuf),   "MSM_MEM_POOL_DMABUF"     },
+	{MSM_MEM_POOL_BUFFER,     sizeof(struct msm_vidc_buffer),     "MSM_MEM_POOL_BUFFER",     true  },
+	{MSM_MEM_POOL_MAP,        sizeof(struct msm_vidc_map),        "MSM_MEM_POOL_MAP",        true  },
+	{MSM_MEM_POOL_ALLOC,      sizeof(struct msm_vidc_alloc),      "MSM_MEM_POOL_ALLOC",      true  },
+	{MSM_MEM_POOL_DMABUF,     sizeof(struct msm_memory_dmabuf),   "MSM_MEM_POOL_DMABUF",     false },
 };
 
+int msm_memory_caches_init(struct msm_vidc_core *core)
+{
+	u32 i;
+
+	if (!core) {
+		d_vpr_e("%s: Invalid params\n", __func__);
+		return -EINVAL;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(buftype_size_name_arr); i++) {
+		core->pool_cache[i] = kmem_cache_create(buftype_size_name_arr[i].name,
+			buftype_size_name_arr[i].size +
+			sizeof(struct msm_memory_alloc_header), 0, 0, NULL);
+		if (!core->pool_cache[i]) {
+			d_vpr_e("%s: %s cache create failed\n", __func__,
+				buftype_size_name_arr[i].name);
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+void msm_memory_caches_deinit(struct msm_vidc_core *core)
+{
+	u32 i;
+
+	if (!core) {
+		d_vpr_e("%s: Invalid params\n", __func__);
+		return;
+	}
+
+	for (i = 0; i < MSM_MEM_POOL_MAX; i++) {
+		kmem_cache_destroy(core->pool_cache[i]);
+		core->pool_cache[i] = NULL;
+	}
+}
+
 int msm_memory_pools_init(struct msm_vidc_inst *inst)
 {
+	struct msm_vidc_core *core;
 	u32 i;
 
-	if (!inst) {
+	if (!inst || !inst->core) {
 		d_vpr_e("%s: Invalid params\n", __func__);
 		return -EINVAL;
 	}
+	core = inst->core;
 
 	if (ARRAY_SIZE(buftype_size_name_arr) != MSM_MEM_POOL_MAX) {
 		i_vpr_e(inst, "%s: num elements mismatch %u %u\n", __func__,
@@ -597,8 +918,15 @@ int msm_memory_pools_init(struct msm_vidc_inst *inst)
 				i, buftype_size_name_arr[i].type);
 			return -EINVAL;
 		}
+		if (!core->pool_cache[i]) {
+			i_vpr_e(inst, "%s: no cache for %s\n", __func__,
+				buftype_size_name_arr[i].name);
+			return -EINVAL;
+		}
 		inst->pool[i].size = buftype_size_name_arr[i].size;
 		inst->pool[i].name = buftype_size_name_arr[i].name;
+		inst->pool[i].reset = buftype_size_name_arr[i].reset;
+		inst->pool[i].cache = core->pool_cache[i];
 		INIT_LIST_HEAD(&inst->pool[i].free_pool);
 		INIT_LIST_HEAD(&inst->pool[i].busy_pool);
 	}
@@ -606,13 +934,60 @@ int msm_memory_pools_init(struct msm_vidc_inst *inst)
 	return 0;
 }
 
+static void msm_memory_pool_prewarm(struct msm_vidc_inst *inst,
+	enum msm_memory_pool_type type, u32 count)
+{
+	struct msm_memory_alloc_header *hdr;
+	struct msm_memory_pool *pool;
+	u32 i;
+
+	pool = &inst->pool[type];
+	for (i = 0; i < count; i++) {
+		hdr = kmem_cache_zalloc(pool->cache, GFP_KERNEL);
+		if (!hdr)
+			break;
+		INIT_LIST_HEAD(&hdr->list);
+		hdr->type = type;
+		hdr->busy = false;
+		hdr->buf = (void *)(hdr + 1);
+		list_add_tail(&hdr->list, &pool->free_pool);
+	}
+	i_vpr_l(inst, "%s: type: %23s, count: %2u\n", __func__, pool->name, i);
+}
+
+/*
+ * Fill the free pools up front so the first qbufs of a stream do not
+ * allocate. Sized from the port buffer counts set by inst init; a
+ * failure only leaves the pool to allocate on demand.
+ */
+void msm_memory_pools_prewarm(struct msm_vidc_inst *inst)
+{
+	u32 count;
+
+	if (!inst) {
+		d_vpr_e("%s: Invalid params\n", __func__);
+		return;
+	}
+
+	count = inst->buffers.input.min_count + inst->buffers.input.extra_count +
+		inst->buffers.input_meta.min_count + inst->buffers.input_meta.extra_count +
+		inst->buffers.output.min_count + inst->buffers.output.extra_count +
+		inst->buffers.output_meta.min_count + inst->buffers.output_meta.extra_count;
+
+	msm_memory_pool_prewarm(inst, MSM_MEM_POOL_BUFFER, count);
+	msm_memory_pool_prewarm(inst, MSM_MEM_POOL_MAP, count);
+	msm_memory_pool_prewarm(inst, MSM_MEM_POOL_DMABUF, count);
+}
+
 /*
-int msm_memory_cache_operations(struct msm_vidc_inst *inst,
-	struct dma_buf *dbuf, enum smem_cache_ops cache_op,
-	unsigned long offset, unsigned long size, u32 sid)
+ * Buffers are mapped with DMA_ATTR_SKIP_CPU_SYNC, so cpu caches are kept
+ * coherent here and only over the bytes actually populated.
+ */
+int msm_vidc_memory_cache_operations(struct msm_vidc_inst *inst,
+	struct dma_buf *dbuf, enum msm_vidc_cache_op cache_op,
+	unsigned long offset, unsigned long size)
 {
 	int rc = 0;
-	unsigned long flags = 0;
 
 	if (!inst) {
 		d_vpr_e("%s: invalid parameters\n", __func__);
@@ -624,18 +999,18 @@ int msm_memory_cache_operations(struct msm_vidc_inst *inst,
 		return -EINVAL;
 	}
 
-	rc = dma_buf_get_flags(dbuf, &flags);
-	if (rc) {
-		i_vpr_e(inst, "%s: dma_buf_get_flags failed, err %d\n",
-			__func__, rc);
-		return rc;
-	} else if (!(flags & ION_FLAG_CACHED)) {
-		return rc;
+	if (!size)
+		return 0;
+
+	if (offset >= dbuf->size || size > dbuf->size - offset) {
+		i_vpr_e(inst, "%s: range %#lx + %#lx exceeds size %#zx\n",
+			__func__, offset, size, dbuf->size);
+		return -EINVAL;
 	}
 
 	switch (cache_op) {
-	case SMEM_CACHE_CLEAN:
-	case SMEM_CACHE_CLEAN_INVALIDATE:
+	case MSM_VIDC_CACHE_CLEAN:
+	case MSM_VIDC_CACHE_CLEAN_INVALIDATE:
 		rc = dma_buf_begin_cpu_access_partial(dbuf, DMA_TO_DEVICE,
 				offset, size);
 		if (rc)
@@ -643,7 +1018,7 @@ int msm_memory_cache_operations(struct msm_vidc_inst *inst,
 		rc = dma_buf_end_cpu_access_partial(dbuf, DMA_TO_DEVICE,
 				offset, size);
 		break;
-	case SMEM_CACHE_INVALIDATE:
+	case MSM_VIDC_CACHE_INVALIDATE:
 		rc = dma_buf_begin_cpu_access_partial(dbuf, DMA_TO_DEVICE,
 				offset, size);
 		if (rc)
@@ -661,6 +1036,7 @@ int msm_memory_cache_operations(struct msm_vidc_inst *inst,
 	return rc;
 }
 
+/*
 int msm_smem_memory_prefetch(struct msm_vidc_inst *inst)
 {
 	int i, rc = 0;
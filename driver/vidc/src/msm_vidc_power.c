@@ -121,13 +121,37 @@ static int fill_dynamic_stats(struct msm_vidc_inst *inst,
 	return 0;
 }
 
+/*
+ * Whether a vote moving from prev to next is worth sending down, given
+ * the hysteresis and down vote rate limit of the core vote filter.
+ */
+static bool msm_vidc_vote_needed(struct msm_vidc_vote_filter *filter,
+	u64 prev, u64 next, u64 last_vote_ns, u64 curr_time_ns)
+{
+	if (next == prev)
+		return false;
+	if (!prev)
+		return true;
+
+	if (next > prev)
+		return (next - prev) * 100 > prev * filter->up_percent;
+
+	if (curr_time_ns - last_vote_ns <
+		(u64)filter->down_window_ms * NSEC_PER_MSEC)
+		return false;
+
+	return (prev - next) * 100 > prev * filter->down_percent;
+}
+
 static int msm_vidc_set_buses(struct msm_vidc_inst* inst)
 {
 	int rc = 0;
 	struct msm_vidc_core* core;
 	struct msm_vidc_inst* temp;
+	struct msm_vidc_vote_filter *filter;
 	u64 total_bw_ddr = 0, total_bw_llcc = 0;
 	u64 curr_time_ns;
+	bool vote_ddr, vote_llcc;
 
 	if (!inst || !inst->core) {
 		d_vpr_e("%s: invalid params\n", __func__);
@@ -162,7 +186,6 @@ static int msm_vidc_set_buses(struct msm_vidc_inst* inst)
 		total_bw_ddr += temp->power.ddr_bw;
 		total_bw_llcc += temp->power.sys_cache_bw;
 	}
-	mutex_unlock(&core->lock);
 
 	if (msm_vidc_ddr_bw) {
 		d_vpr_l("msm_vidc_ddr_bw %d\n", msm_vidc_ddr_bw);
@@ -174,6 +197,25 @@ static int msm_vidc_set_buses(struct msm_vidc_inst* inst)
 		total_bw_llcc = msm_vidc_llc_bw;
 	}
 
+	/* a path held back keeps its current vote */
+	filter = &core->vote_filter;
+	vote_ddr = msm_vidc_vote_needed(filter, core->power.bw_ddr,
+		total_bw_ddr, filter->bus_vote_ns, curr_time_ns);
+	vote_llcc = msm_vidc_vote_needed(filter, core->power.bw_llcc,
+		total_bw_llcc, filter->bus_vote_ns, curr_time_ns);
+	if (!vote_ddr && !vote_llcc) {
+		filter->bus_suppressed++;
+		mutex_unlock(&core->lock);
+		return 0;
+	}
+	if (!vote_ddr)
+		total_bw_ddr = core->power.bw_ddr;
+	if (!vote_llcc)
+		total_bw_llcc = core->power.bw_llcc;
+	filter->bus_vote_ns = curr_time_ns;
+	filter->bus_votes++;
+	mutex_unlock(&core->lock);
+
 	rc = venus_hfi_scale_buses(inst, total_bw_ddr, total_bw_llcc);
 	if (rc)
 		return rc;
@@ -298,11 +340,46 @@ set_buses:
 	return 0;
 }
 
+void msm_vidc_clk_aggregate_remove_locked(struct msm_vidc_core *core,
+	struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_clk_aggregate *aggr = &core->clk_aggr;
+
+	if (list_empty(&inst->power.clk_node))
+		return;
+
+	list_del_init(&inst->power.clk_node);
+	aggr->freq -= inst->power.aggr_freq;
+	if (inst->power.aggr_flags & MSM_VIDC_DCVS_INCR)
+		aggr->incr_count--;
+	if (!(inst->power.aggr_flags & MSM_VIDC_DCVS_DECR))
+		aggr->hold_count--;
+	aggr->count--;
+}
+
+static void msm_vidc_clk_aggregate_add_locked(struct msm_vidc_core *core,
+	struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_clk_aggregate *aggr = &core->clk_aggr;
+
+	inst->power.aggr_freq = inst->power.min_freq;
+	inst->power.aggr_flags = inst->power.dcvs_flags;
+	list_add_tail(&inst->power.clk_node, &aggr->list);
+	aggr->freq += inst->power.aggr_freq;
+	if (inst->power.aggr_flags & MSM_VIDC_DCVS_INCR)
+		aggr->incr_count++;
+	if (!(inst->power.aggr_flags & MSM_VIDC_DCVS_DECR))
+		aggr->hold_count++;
+	aggr->count++;
+}
+
 int msm_vidc_set_clocks(struct msm_vidc_inst* inst)
 {
 	int rc = 0;
 	struct msm_vidc_core* core;
 	struct msm_vidc_inst* temp;
+	struct msm_vidc_clk_aggregate *aggr;
+	struct msm_vidc_vote_filter *filter;
 	u64 freq;
 	u64 rate = 0;
 	bool increment, decrement;
@@ -318,32 +395,36 @@ int msm_vidc_set_clocks(struct msm_vidc_inst* inst)
 		d_vpr_e("%s: invalid dt params\n", __func__);
 		return -EINVAL;
 	}
+	aggr = &core->clk_aggr;
 
 	mutex_lock(&core->lock);
-	increment = false;
-	decrement = true;
-	freq = 0;
-	curr_time_ns = ktime_get_ns();
-	list_for_each_entry(temp, &core->instances, list) {
-		/* skip inactive session clock rate */
-		if (!is_active_session(temp->last_qbuf_time_ns, curr_time_ns)) {
-			temp->active = false;
-			continue;
-		}
-		freq += temp->power.min_freq;
+	/* replace this session's previous vote, sessions removed do not vote */
+	msm_vidc_clk_aggregate_remove_locked(core, inst);
+	if (xa_load(&core->session_xa, inst->session_id) == inst)
+		msm_vidc_clk_aggregate_add_locked(core, inst);
 
-		if (msm_vidc_clock_voting) {
-			d_vpr_l("msm_vidc_clock_voting %d\n", msm_vidc_clock_voting);
-			freq = msm_vidc_clock_voting;
-			decrement = false;
+	/* skip inactive session clock rate */
+	curr_time_ns = ktime_get_ns();
+	while (!list_empty(&aggr->list)) {
+		temp = list_first_entry(&aggr->list, struct msm_vidc_inst,
+			power.clk_node);
+		if (is_active_session(temp->last_qbuf_time_ns, curr_time_ns))
 			break;
-		}
+		temp->active = false;
+		msm_vidc_clk_aggregate_remove_locked(core, temp);
+	}
+
+	if (msm_vidc_clock_voting && aggr->count) {
+		d_vpr_l("msm_vidc_clock_voting %d\n", msm_vidc_clock_voting);
+		freq = msm_vidc_clock_voting;
+		increment = false;
+		decrement = false;
+	} else {
+		freq = aggr->freq;
 		/* increment even if one session requested for it */
-		if (temp->power.dcvs_flags & MSM_VIDC_DCVS_INCR)
-			increment = true;
+		increment = aggr->incr_count > 0;
 		/* decrement only if all sessions requested for it */
-		if (!(temp->power.dcvs_flags & MSM_VIDC_DCVS_DECR))
-			decrement = false;
+		decrement = !aggr->hold_count;
 	}
 
 	/*
@@ -364,7 +445,17 @@ int msm_vidc_set_clocks(struct msm_vidc_inst* inst)
 		if (i < (int) (core->dt->allowed_clks_tbl_size - 1))
 			rate = core->dt->allowed_clks_tbl[i + 1].clock_rate;
 	}
+
+	filter = &core->vote_filter;
+	if (!msm_vidc_vote_needed(filter, core->power.clk_freq, rate,
+			filter->clk_vote_ns, curr_time_ns)) {
+		filter->clk_suppressed++;
+		mutex_unlock(&core->lock);
+		return 0;
+	}
 	core->power.clk_freq = (u32)rate;
+	filter->clk_vote_ns = curr_time_ns;
+	filter->clk_votes++;
 
 	i_vpr_p(inst, "%s: clock rate %lu requested %lu increment %d decrement %d\n",
 		__func__, rate, freq, increment, decrement);
@@ -377,33 +468,10 @@ int msm_vidc_set_clocks(struct msm_vidc_inst* inst)
 	return 0;
 }
 
-static int msm_vidc_apply_dcvs(struct msm_vidc_inst *inst)
+static void msm_vidc_dcvs_threshold(struct msm_vidc_inst *inst,
+	u32 bufs_with_fw)
 {
-	int rc = 0;
-	int bufs_with_fw = 0;
-	struct msm_vidc_power *power;
-
-	if (!inst) {
-		d_vpr_e("%s: invalid params %pK\n", __func__, inst);
-		return -EINVAL;
-	}
-
-	/* skip dcvs */
-	if (!inst->power.dcvs_mode)
-		return 0;
-
-	power = &inst->power;
-
-	if (is_decode_session(inst)) {
-		bufs_with_fw = msm_vidc_num_buffers(inst,
-			MSM_VIDC_BUF_OUTPUT, MSM_VIDC_ATTR_QUEUED);
-	} else {
-		bufs_with_fw = msm_vidc_num_buffers(inst,
-			MSM_VIDC_BUF_INPUT, MSM_VIDC_ATTR_QUEUED);
-	}
-
-	/* +1 as one buffer is going to be queued after the function */
-	bufs_with_fw += 1;
+	struct msm_vidc_power *power = &inst->power;
 
 	/*
 	 * DCVS decides clock level based on below algorithm
@@ -427,16 +495,16 @@ static int msm_vidc_apply_dcvs(struct msm_vidc_inst *inst)
 	 */
 	if (bufs_with_fw >= power->max_threshold) {
 		power->dcvs_flags = MSM_VIDC_DCVS_INCR;
-		goto exit;
+		return;
 	} else if (bufs_with_fw < power->min_threshold) {
 		power->dcvs_flags = MSM_VIDC_DCVS_DECR;
-		goto exit;
+		return;
 	}
 
 	/* encoder: dcvs window handling */
 	if (is_encode_session(inst)) {
 		power->dcvs_flags = 0;
-		goto exit;
+		return;
 	}
 
 	/* decoder: dcvs window handling */
@@ -444,11 +512,155 @@ static int msm_vidc_apply_dcvs(struct msm_vidc_inst *inst)
 		(power->dcvs_flags & MSM_VIDC_DCVS_INCR && bufs_with_fw <= power->nom_threshold)) {
 		power->dcvs_flags = 0;
 	}
+}
+
+/* fw load, % of the frame period, to step clock up / back / down at */
+#define DCVS_PREDICTIVE_LOAD_HIGH   90
+#define DCVS_PREDICTIVE_LOAD_NOM    75
+#define DCVS_PREDICTIVE_LOAD_LOW    60
+/* weight 1/(1 << shift) of a new sample in the fw busy time EMA */
+#define DCVS_BUSY_EMA_SHIFT         3
+
+/*
+ * Predictive policy: compare the measured fw time per frame against the
+ * frame period of the rising edge of the bitstream/client frame rate, and
+ * use the queue depth trend over DCVS_WINDOW so a filling queue steps up
+ * before it reaches max_threshold. Falls back to thresholds until fw
+ * time has been measured.
+ */
+static void msm_vidc_dcvs_predictive(struct msm_vidc_inst *inst,
+	u32 bufs_with_fw)
+{
+	struct msm_vidc_power *power = &inst->power;
+	struct msm_vidc_dcvs_history *h = &power->dcvs_history;
+	u64 fps, period_ns, load;
+	u32 oldest;
+	int trend;
+
+	if (!h->busy_ns || h->count < DCVS_WINDOW) {
+		msm_vidc_dcvs_threshold(inst, bufs_with_fw);
+		return;
+	}
+
+	fps = max(inst->timestamps.fps, inst->timestamps.avg_fps);
+	fps = max(fps, (u64)msm_vidc_get_fps(inst) << 16);
+	if (!fps) {
+		msm_vidc_dcvs_threshold(inst, bufs_with_fw);
+		return;
+	}
+	period_ns = div64_u64((u64)NSEC_PER_SEC << 16, fps);
+	load = period_ns ? div64_u64(h->busy_ns * 100, period_ns) : 100;
+
+	/* depth[head] is the oldest sample once the window is full */
+	oldest = h->depth[h->head];
+	trend = (int)bufs_with_fw - (int)oldest;
+
+	if (load >= DCVS_PREDICTIVE_LOAD_HIGH ||
+		(bufs_with_fw >= power->max_threshold && trend >= 0)) {
+		power->dcvs_flags = MSM_VIDC_DCVS_INCR;
+	} else if (load <= DCVS_PREDICTIVE_LOAD_LOW && trend <= 0 &&
+		bufs_with_fw < power->max_threshold) {
+		power->dcvs_flags = MSM_VIDC_DCVS_DECR;
+	} else if ((power->dcvs_flags & MSM_VIDC_DCVS_INCR &&
+			load < DCVS_PREDICTIVE_LOAD_NOM && trend <= 0) ||
+		(power->dcvs_flags & MSM_VIDC_DCVS_DECR &&
+			(load > DCVS_PREDICTIVE_LOAD_NOM || trend > 0))) {
+		power->dcvs_flags = 0;
+	}
+}
+
+static const struct {
+	const char *name;
+	void (*apply)(struct msm_vidc_inst *inst, u32 bufs_with_fw);
+} dcvs_policies[MSM_VIDC_DCVS_POLICY_MAX] = {
+	[MSM_VIDC_DCVS_POLICY_THRESHOLD]  = {"threshold",  msm_vidc_dcvs_threshold  },
+	[MSM_VIDC_DCVS_POLICY_PREDICTIVE] = {"predictive", msm_vidc_dcvs_predictive },
+};
+
+static void msm_vidc_dcvs_add_depth(struct msm_vidc_dcvs_history *h,
+	u32 bufs_with_fw)
+{
+	if (h->count == DCVS_WINDOW)
+		h->depth_sum -= h->depth[h->head];
+	else
+		h->count++;
+	h->depth[h->head] = bufs_with_fw;
+	h->depth_sum += bufs_with_fw;
+	h->head = (h->head + 1) % DCVS_WINDOW;
+}
+
+/*
+ * Called as fw returns a decoder output / encoder input. With more than
+ * min_threshold buffers queued fw was not starved, so the gap since the
+ * previous one is fw time spent on this frame.
+ */
+void msm_vidc_dcvs_frame_done(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_dcvs_history *h;
+	u64 now, busy;
+	u32 last;
+
+	if (!inst) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return;
+	}
+
+	if (!inst->power.dcvs_mode ||
+		inst->power.dcvs_policy != MSM_VIDC_DCVS_POLICY_PREDICTIVE)
+		return;
+
+	h = &inst->power.dcvs_history;
+	now = ktime_get_ns();
+	last = h->count ?
+		h->depth[(h->head + DCVS_WINDOW - 1) % DCVS_WINDOW] : 0;
+	if (h->last_done_ns && last > inst->power.min_threshold) {
+		busy = min_t(u64, now - h->last_done_ns, NSEC_PER_SEC);
+		if (!h->busy_ns)
+			h->busy_ns = busy;
+		else if (busy > h->busy_ns)
+			h->busy_ns += (busy - h->busy_ns) >> DCVS_BUSY_EMA_SHIFT;
+		else
+			h->busy_ns -= (h->busy_ns - busy) >> DCVS_BUSY_EMA_SHIFT;
+	}
+	h->last_done_ns = now;
+}
+
+static int msm_vidc_apply_dcvs(struct msm_vidc_inst *inst)
+{
+	int rc = 0;
+	int bufs_with_fw = 0;
+	struct msm_vidc_power *power;
 
-exit:
-	i_vpr_p(inst, "dcvs: bufs_with_fw %d th[%d %d %d] flags %#x\n",
+	if (!inst) {
+		d_vpr_e("%s: invalid params %pK\n", __func__, inst);
+		return -EINVAL;
+	}
+
+	/* skip dcvs */
+	if (!inst->power.dcvs_mode)
+		return 0;
+
+	power = &inst->power;
+
+	if (is_decode_session(inst)) {
+		bufs_with_fw = msm_vidc_num_buffers(inst,
+			MSM_VIDC_BUF_OUTPUT, MSM_VIDC_ATTR_QUEUED);
+	} else {
+		bufs_with_fw = msm_vidc_num_buffers(inst,
+			MSM_VIDC_BUF_INPUT, MSM_VIDC_ATTR_QUEUED);
+	}
+
+	/* +1 as one buffer is going to be queued after the function */
+	bufs_with_fw += 1;
+
+	dcvs_policies[power->dcvs_policy].apply(inst, bufs_with_fw);
+	msm_vidc_dcvs_add_depth(&power->dcvs_history, bufs_with_fw);
+
+	i_vpr_p(inst, "dcvs: %s bufs_with_fw %d th[%d %d %d] fw busy %lluus flags %#x\n",
+		dcvs_policies[power->dcvs_policy].name,
 		bufs_with_fw, power->min_threshold,
 		power->nom_threshold, power->max_threshold,
+		div_u64(power->dcvs_history.busy_ns, NSEC_PER_USEC),
 		power->dcvs_flags);
 
 	return rc;
@@ -530,13 +742,15 @@ int msm_vidc_scale_power(struct msm_vidc_inst *inst, bool scale_buses)
 
 void msm_vidc_dcvs_data_reset(struct msm_vidc_inst *inst)
 {
+	struct msm_vidc_core *core;
 	struct msm_vidc_power *dcvs;
 	u32 min_count, actual_count, max_count;
 
-	if (!inst) {
+	if (!inst || !inst->core) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return;
 	}
+	core = inst->core;
 
 	dcvs = &inst->power;
 	if (is_encode_session(inst)) {
@@ -558,6 +772,9 @@ void msm_vidc_dcvs_data_reset(struct msm_vidc_inst *inst)
 	dcvs->dcvs_window = min_count < max_count ? max_count - min_count : 0;
 	dcvs->nom_threshold = dcvs->min_threshold + (dcvs->dcvs_window / 2);
 	dcvs->dcvs_flags = 0;
+	dcvs->dcvs_policy = core->dcvs_policy < MSM_VIDC_DCVS_POLICY_MAX ?
+		core->dcvs_policy : MSM_VIDC_DCVS_POLICY_THRESHOLD;
+	memset(&dcvs->dcvs_history, 0, sizeof(dcvs->dcvs_history));
 
 	i_vpr_p(inst, "%s: dcvs: thresholds [%d %d %d] flags %#x\n",
 		__func__, dcvs->min_threshold,
@@ -565,6 +782,17 @@ void msm_vidc_dcvs_data_reset(struct msm_vidc_inst *inst)
 		dcvs->dcvs_flags);
 }
 
+void msm_vidc_power_model_invalidate(struct msm_vidc_inst *inst)
+{
+	if (!inst) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return;
+	}
+
+	inst->power.model.freq_valid = false;
+	inst->power.model.bw_valid = false;
+}
+
 void msm_vidc_power_data_reset(struct msm_vidc_inst *inst)
 {
 	int rc = 0;
@@ -576,6 +804,7 @@ void msm_vidc_power_data_reset(struct msm_vidc_inst *inst)
 	i_vpr_hp(inst, "%s\n", __func__);
 
 	msm_vidc_dcvs_data_reset(inst);
+	msm_vidc_power_model_invalidate(inst);
 
 	inst->power.buffer_counter = 0;
 	inst->power.fw_cr = 0;
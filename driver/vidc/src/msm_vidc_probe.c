@@ -204,20 +204,35 @@ static int msm_vidc_deinitialize_core(struct msm_vidc_core *core)
 	d_vpr_h("%s()\n", __func__);
 
 	mutex_destroy(&core->lock);
+	mutex_destroy(&core->cmdq_lock);
+	xa_destroy(&core->session_xa);
 	msm_vidc_change_core_state(core, MSM_VIDC_CORE_DEINIT, __func__);
 
+	if (core->dbgq_workq)
+		destroy_workqueue(core->dbgq_workq);
+	mutex_destroy(&core->fw_log.lock);
+	mutex_destroy(&core->fw_log.read_lock);
+	kfifo_free(&core->fw_log.ring);
+	kfree(core->fw_log.packet);
+	kfree(core->cmdq_pending.slots);
 	kfree(core->response_packet);
 	kfree(core->packet);
+	core->fw_log.packet = NULL;
+	core->cmdq_pending.slots = NULL;
 	core->response_packet = NULL;
 	core->packet = NULL;
 
-	if (core->batch_workq)
-		destroy_workqueue(core->batch_workq);
+	msm_vidc_buffer_cache_deinit(core);
+	msm_vidc_dma_heaps_deinit(core);
+	msm_memory_caches_deinit(core);
+	if (core->response_workq)
+		destroy_workqueue(core->response_workq);
 
 	if (core->pm_workq)
 		destroy_workqueue(core->pm_workq);
 
-	core->batch_workq = NULL;
+	core->dbgq_workq = NULL;
+	core->response_workq = NULL;
 	core->pm_workq = NULL;
 
 	return rc;
@@ -234,6 +249,8 @@ static int msm_vidc_initialize_core(struct msm_vidc_core *core)
 	d_vpr_h("%s()\n", __func__);
 
 	msm_vidc_change_core_state(core, MSM_VIDC_CORE_DEINIT, __func__);
+	msm_vidc_buffer_cache_init(core);
+	msm_vidc_dma_heaps_init(core);
 
 	core->pm_workq = create_singlethread_workqueue("pm_workq");
 	if (!core->pm_workq) {
@@ -242,13 +259,29 @@ static int msm_vidc_initialize_core(struct msm_vidc_core *core)
 		goto exit;
 	}
 
-	core->batch_workq = create_singlethread_workqueue("batch_workq");
-	if (!core->batch_workq) {
-		d_vpr_e("%s: create batch workq failed\n", __func__);
+	core->response_workq = alloc_workqueue("response_workq",
+		WQ_UNBOUND | WQ_HIGHPRI, 0);
+	if (!core->response_workq) {
+		d_vpr_e("%s: create response workq failed\n", __func__);
 		rc = -EINVAL;
 		goto exit;
 	}
 
+	rc = msm_memory_caches_init(core);
+	if (rc)
+		goto exit;
+
+	core->cache_op_types = CACHE_OP_BUFFER_TYPES_VALUE;
+	/* opt-in, polling holds the irq thread for up to budget rounds */
+	core->msgq_poll.enable = false;
+	core->msgq_poll.budget = MSGQ_POLL_BUDGET_VALUE;
+	core->msgq_poll.interval_us = MSGQ_POLL_INTERVAL_US_VALUE;
+	core->msgq_poll.idle_rounds = MSGQ_POLL_IDLE_ROUNDS_VALUE;
+	core->msgq_poll.rate_threshold = MSGQ_POLL_RATE_VALUE;
+	core->vote_filter.up_percent = VOTE_UP_PERCENT_VALUE;
+	core->vote_filter.down_percent = VOTE_DOWN_PERCENT_VALUE;
+	core->vote_filter.down_window_ms = VOTE_DOWN_WINDOW_MS_VALUE;
+
 	core->packet_size = 4096;
 	core->packet = kzalloc(core->packet_size, GFP_KERNEL);
 	if (!core->packet) {
@@ -265,25 +298,72 @@ static int msm_vidc_initialize_core(struct msm_vidc_core *core)
 		goto exit;
 	}
 
+	core->cmdq_pending.slot_size = core->packet_size;
+	core->cmdq_pending.num_slots = CMDQ_PENDING_SLOTS;
+	core->cmdq_pending.slots = kcalloc(core->cmdq_pending.num_slots,
+		core->cmdq_pending.slot_size, GFP_KERNEL);
+	if (!core->cmdq_pending.slots) {
+		d_vpr_e("%s(): cmdq pending allocation failed\n", __func__);
+		rc = -ENOMEM;
+		goto exit;
+	}
+	init_waitqueue_head(&core->cmdq_pending.wait);
+
+	core->dbgq_workq = create_singlethread_workqueue("dbgq_workq");
+	if (!core->dbgq_workq) {
+		d_vpr_e("%s: create dbgq workq failed\n", __func__);
+		rc = -EINVAL;
+		goto exit;
+	}
+
+	core->fw_log.packet = kzalloc(VIDC_IFACEQ_VAR_HUGE_PKT_SIZE, GFP_KERNEL);
+	if (!core->fw_log.packet) {
+		d_vpr_e("%s(): fw log packet allocation failed\n", __func__);
+		rc = -ENOMEM;
+		goto exit;
+	}
+
+	rc = kfifo_alloc(&core->fw_log.ring, FW_LOG_RING_SIZE, GFP_KERNEL);
+	if (rc) {
+		d_vpr_e("%s(): fw log ring allocation failed\n", __func__);
+		goto exit;
+	}
+	mutex_init(&core->fw_log.lock);
+	mutex_init(&core->fw_log.read_lock);
+
 	mutex_init(&core->lock);
+	mutex_init(&core->cmdq_lock);
 	INIT_LIST_HEAD(&core->instances);
 	INIT_LIST_HEAD(&core->dangling_instances);
+	INIT_LIST_HEAD(&core->clk_aggr.list);
+	xa_init(&core->session_xa);
 
 	INIT_DELAYED_WORK(&core->pm_work, venus_hfi_pm_work_handler);
 	INIT_DELAYED_WORK(&core->fw_unload_work, msm_vidc_fw_unload_handler);
 	INIT_WORK(&core->ssr_work, msm_vidc_ssr_handler);
+	INIT_WORK(&core->fw_log.work, venus_hfi_dbgq_work_handler);
 
 	return 0;
 exit:
+	if (core->dbgq_workq)
+		destroy_workqueue(core->dbgq_workq);
+	kfree(core->fw_log.packet);
+	kfree(core->cmdq_pending.slots);
 	kfree(core->response_packet);
 	kfree(core->packet);
+	core->dbgq_workq = NULL;
+	core->fw_log.packet = NULL;
+	core->cmdq_pending.slots = NULL;
 	core->response_packet = NULL;
 	core->packet = NULL;
-	if (core->batch_workq)
-		destroy_workqueue(core->batch_workq);
+	msm_vidc_buffer_cache_deinit(core);
+	msm_vidc_dma_heaps_deinit(core);
+	msm_memory_caches_deinit(core);
+	if (core->response_workq)
+		destroy_workqueue(core->response_workq);
 	if (core->pm_workq)
 		destroy_workqueue(core->pm_workq);
-	core->batch_workq = NULL;
+	core->response_workq = NULL;
 	core->pm_workq = NULL;
 
 	return rc;
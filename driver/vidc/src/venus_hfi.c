@@ -63,12 +63,6 @@ enum reset_state {
 	DEASSERT,
 };
 
-/* Less than 50MBps is treated as trivial BW change */
-#define TRIVIAL_BW_THRESHOLD 50000
-#define TRIVIAL_BW_CHANGE(a, b) \
-	((a) > (b) ? (a) - (b) < TRIVIAL_BW_THRESHOLD : \
-		(b) - (a) < TRIVIAL_BW_THRESHOLD)
-
 /**
  * Utility function to enforce some of our assumptions.  Spam calls to this
  * in hotspots in code to double check some of the assumptions that we hold.
@@ -190,6 +184,21 @@ static int __strict_check(struct msm_vidc_core *core, const char *function)
 	return fatal ? -EINVAL : 0;
 }
 
+/* cmdq producers may hold cmdq_lock instead of core->lock */
+static int __strict_cmdq_check(struct msm_vidc_core *core,
+		const char *function)
+{
+	bool fatal = !mutex_is_locked(&core->lock) &&
+		!mutex_is_locked(&core->cmdq_lock);
+
+	__fatal_error(fatal);
+
+	if (fatal)
+		d_vpr_e("%s: strict cmdq check failed\n", function);
+
+	return fatal ? -EINVAL : 0;
+}
+
 bool __core_in_valid_state(struct msm_vidc_core *core)
 {
 	return core->state != MSM_VIDC_CORE_DEINIT;
@@ -210,7 +219,7 @@ static bool __valdiate_session(struct msm_vidc_core *core,
 	if (!core || !inst)
 		return false;
 
-	rc = __strict_check(core, __func__);
+	rc = __strict_cmdq_check(core, __func__);
 	if (rc)
 		return false;
 
@@ -238,7 +247,7 @@ int __write_register(struct msm_vidc_core *core,
 		return -EINVAL;
 	}
 
-	rc = __strict_check(core, __func__);
+	rc = __strict_cmdq_check(core, __func__);
 	if (rc)
 		return rc;
 
@@ -620,7 +629,8 @@ int __vote_buses(struct msm_vidc_core *core,
 			bw_kbps = clamp_t(typeof(bw_kbps), bw_kbps,
 				bus->range[0], bus->range[1]);
 
-			if (TRIVIAL_BW_CHANGE(bw_kbps, bw_prev) && bw_prev) {
+			/* hysteresis is applied by the caller, see msm_vidc_set_buses */
+			if (bw_kbps == bw_prev && bw_prev) {
 				d_vpr_l("Skip voting bus %s to %llu kBps\n",
 					bus->name, bw_kbps);
 				continue;
@@ -795,7 +805,7 @@ static int __write_queue(struct msm_vidc_iface_q_info *qinfo, u8 *packet,
 		(read_idx - write_idx);
 	if (empty_space <= packet_size_in_words) {
 		queue->qhdr_tx_req =  1;
-		d_vpr_e("Insufficient size (%d) to write (%d)\n",
+		d_vpr_h("Insufficient size (%d) to write (%d)\n",
 					  empty_space, packet_size_in_words);
 		return -ENOTEMPTY;
 	}
@@ -957,13 +967,202 @@ static int __read_queue(struct msm_vidc_iface_q_info *qinfo, u8 *packet,
 	return rc;
 }
 
+/*
+ * Copies the msgq message at *read_idx into @packet, returns its length
+ * in @msg_size and advances *read_idx past it. Handlers may sleep on
+ * session locks while core deinit frees the queues, so they never parse
+ * the ring itself. qhdr_read_idx is left untouched, see __msgq_commit().
+ */
+static int __msgq_peek(struct msm_vidc_iface_q_info *qinfo, u32 *read_idx,
+	u8 *packet, u32 packet_size, u32 *msg_size)
+{
+	u32 q_size_in_words, packet_size_in_words, new_read_idx, split;
+	u8 *q_addr;
+	u32 *read_ptr;
+
+	q_addr = qinfo->q_array.align_virtual_addr;
+	q_size_in_words = qinfo->q_array.mem_size >> 2;
+	if (*read_idx >= q_size_in_words) {
+		d_vpr_e("Invalid read index\n");
+		return -ENODATA;
+	}
+
+	read_ptr = (u32 *)(q_addr + (*read_idx << 2));
+	packet_size_in_words = (*read_ptr) >> 2;
+	if (!packet_size_in_words) {
+		d_vpr_e("Zero packet size\n");
+		return -ENODATA;
+	}
+	if ((packet_size_in_words << 2) > VIDC_IFACEQ_VAR_HUGE_PKT_SIZE ||
+		(packet_size_in_words << 2) > packet_size) {
+		d_vpr_e("BAD packet received, read_idx: %#x, pkt_size: %d\n",
+			*read_idx, packet_size_in_words << 2);
+		return -ENODATA;
+	}
+
+	new_read_idx = *read_idx + packet_size_in_words;
+	if (new_read_idx <= q_size_in_words) {
+		memcpy(packet, read_ptr, packet_size_in_words << 2);
+		if (new_read_idx == q_size_in_words)
+			new_read_idx = 0;
+	} else {
+		new_read_idx -= q_size_in_words;
+		split = packet_size_in_words - new_read_idx;
+		memcpy(packet, read_ptr, split << 2);
+		memcpy(packet + (split << 2), q_addr, new_read_idx << 2);
+	}
+	*read_idx = new_read_idx;
+	*msg_size = packet_size_in_words << 2;
+
+	if (msm_vidc_debug & VIDC_PKT)
+		__dump_packet(packet, __func__, qinfo);
+
+	return 0;
+}
+
+/* hand the messages consumed so far back to firmware */
+static void __msgq_commit(struct msm_vidc_iface_q_info *qinfo, u32 read_idx,
+	bool rx_req)
+{
+	struct hfi_queue_header *queue;
+
+	queue = (struct hfi_queue_header *)qinfo->q_hdr;
+	queue->qhdr_rx_req = rx_req ? 1 : 0;
+	queue->qhdr_read_idx = read_idx;
+	/*
+	 * mb() to ensure qhdr is updated in main memory
+	 * so that venus reads the updated header values
+	 */
+	mb();
+
+	if (queue->qhdr_tx_req == 1)
+		d_vpr_e("%s: queue is full\n", __func__);
+}
+
+/* Caller must hold cmdq_lock */
+static int __cmdq_pending_add(struct msm_vidc_core *core, void *pkt)
+{
+	struct msm_vidc_cmdq_pending *pending = &core->cmdq_pending;
+	u32 size = *(u32 *)pkt;
+	u32 tail;
+
+	if (size > pending->slot_size) {
+		d_vpr_e("%s: invalid packet size %u\n", __func__, size);
+		return -E2BIG;
+	}
+	if (pending->count >= pending->num_slots) {
+		d_vpr_e("%s: cmdq and pending packets are full\n", __func__);
+		return -E2BIG;
+	}
+
+	tail = (pending->head + pending->count) % pending->num_slots;
+	memcpy(pending->slots + tail * pending->slot_size, pkt, size);
+	pending->count++;
+	pending->queued++;
+
+	return 0;
+}
+
+/*
+ * Moves pending packets into cmdq until it fills up again. Caller must
+ * hold cmdq_lock and keep the core powered on.
+ */
+static void __cmdq_pending_flush(struct msm_vidc_core *core,
+		bool *requires_interrupt)
+{
+	struct msm_vidc_cmdq_pending *pending = &core->cmdq_pending;
+	struct msm_vidc_iface_q_info *q_info;
+	u32 flushed = 0;
+	u8 *pkt;
+
+	q_info = &core->iface_queues[VIDC_IFACEQ_CMDQ_IDX];
+	if (!q_info->q_array.align_virtual_addr)
+		return;
+
+	while (pending->count) {
+		pkt = pending->slots + pending->head * pending->slot_size;
+		if (__write_queue(q_info, pkt, requires_interrupt))
+			break;
+		pending->head = (pending->head + 1) % pending->num_slots;
+		pending->count--;
+		flushed++;
+	}
+
+	if (flushed)
+		wake_up_all(&pending->wait);
+}
+
+static void __cmdq_pending_reset(struct msm_vidc_core *core)
+{
+	struct msm_vidc_cmdq_pending *pending = &core->cmdq_pending;
+
+	mutex_lock(&core->cmdq_lock);
+	if (pending->count)
+		d_vpr_e("%s: dropping %u pending packets\n",
+			__func__, pending->count);
+	pending->head = 0;
+	pending->count = 0;
+	mutex_unlock(&core->cmdq_lock);
+
+	wake_up_all(&pending->wait);
+}
+
+/*
+ * Stamps header_id and packet_id and writes the header into cmdq. If
+ * cmdq is full, the header is held in cmdq_pending and resubmitted once
+ * firmware frees up space. Caller must hold cmdq_lock and keep the core
+ * powered on.
+ */
+static int __cmdq_write_packet(struct msm_vidc_core *core,
+		void *pkt, bool *requires_interrupt)
+{
+	struct msm_vidc_iface_q_info *q_info;
+	struct hfi_header *hdr = pkt;
+	struct hfi_packet *packet;
+	u32 i, offset;
+	int rc = 0;
+
+	if (!__core_in_valid_state(core)) {
+		d_vpr_e("%s: fw not in init state\n", __func__);
+		return -EINVAL;
+	}
+
+	q_info = &core->iface_queues[VIDC_IFACEQ_CMDQ_IDX];
+	if (!q_info->q_array.align_virtual_addr) {
+		d_vpr_e("cannot write to shared CMD Q's\n");
+		return -ENODATA;
+	}
+
+	hdr->header_id = core->header_id++;
+	offset = sizeof(struct hfi_header);
+	for (i = 0; i < hdr->num_packets; i++) {
+		packet = (struct hfi_packet *)((u8 *)pkt + offset);
+		packet->packet_id = core->packet_id++;
+		offset += packet->size;
+	}
+
+	if (core->cmdq_pending.count)
+		__cmdq_pending_flush(core, requires_interrupt);
+
+	/* keep the order behind packets still waiting for space */
+	if (!core->cmdq_pending.count) {
+		rc = __write_queue(q_info, (u8 *)pkt, requires_interrupt);
+		if (!rc)
+			return 0;
+		if (rc != -ENOTEMPTY) {
+			d_vpr_e("__iface_cmdq_write: queue write failed\n");
+			return -E2BIG;
+		}
+	}
+
+	return __cmdq_pending_add(core, pkt);
+}
+
 /* Writes into cmdq without raising an interrupt */
 static int __iface_cmdq_write_relaxed(struct msm_vidc_core *core,
 		void *pkt, bool *requires_interrupt)
 {
-	struct msm_vidc_iface_q_info *q_info;
-	//struct vidc_hal_cmd_pkt_hdr *cmd_packet;
-	int rc = -E2BIG;
+	int rc = 0;
 
 	if (!core || !pkt) {
 		d_vpr_e("%s: invalid params %pK %pK\n",
@@ -977,40 +1176,21 @@ static int __iface_cmdq_write_relaxed(struct msm_vidc_core *core,
 
 	if (!__core_in_valid_state(core)) {
 		d_vpr_e("%s: fw not in init state\n", __func__);
-		rc = -EINVAL;
-		goto err_q_null;
-	}
-
-	//cmd_packet = (struct vidc_hal_cmd_pkt_hdr *)pkt;
-	//core->last_packet_type = cmd_packet->packet_type;
-
-	q_info = &core->iface_queues[VIDC_IFACEQ_CMDQ_IDX];
-	if (!q_info) {
-		d_vpr_e("cannot write to shared Q's\n");
-		goto err_q_null;
-	}
-
-	if (!q_info->q_array.align_virtual_addr) {
-		d_vpr_e("cannot write to shared CMD Q's\n");
-		rc = -ENODATA;
-		goto err_q_null;
+		return -EINVAL;
 	}
 
 	rc = __resume(core);
 	if (rc) {
 		d_vpr_e("%s: Power on failed\n", __func__);
-		goto err_q_write;
+		return rc;
 	}
 
-	if (!__write_queue(q_info, (u8 *)pkt, requires_interrupt)) {
+	mutex_lock(&core->cmdq_lock);
+	rc = __cmdq_write_packet(core, pkt, requires_interrupt);
+	mutex_unlock(&core->cmdq_lock);
+	if (!rc)
 		__schedule_power_collapse_work(core);
-		rc = 0;
-	} else {
-		d_vpr_e("__iface_cmdq_write: queue full\n");
-	}
 
-err_q_write:
-err_q_null:
 	return rc;
 }
 
@@ -1026,58 +1206,258 @@ int __iface_cmdq_write(struct msm_vidc_core *core,
 	return rc;
 }
 
-static int __iface_cmdq_write_intr(struct msm_vidc_core *core,
-	void *pkt, bool allow)
+static void __cmdq_set_fastpath(struct msm_vidc_core *core, bool enable)
 {
+	mutex_lock(&core->cmdq_lock);
+	core->cmdq_fastpath = enable;
+	mutex_unlock(&core->cmdq_lock);
+}
+
+/*
+ * Session level producers write cmdq under cmdq_lock alone while
+ * cmdq_fastpath is set. Otherwise core->lock is taken to resume the core
+ * and cmdq_lock is acquired before dropping it, so power collapse cannot
+ * start until __cmdq_release(). Producers wait here while too many
+ * packets are pending for cmdq space. Returns with cmdq_lock held on
+ * success.
+ */
+static int __cmdq_acquire(struct msm_vidc_inst *inst, const char *func)
+{
+	struct msm_vidc_core *core = inst->core;
+	struct msm_vidc_cmdq_pending *pending = &core->cmdq_pending;
 	bool needs_interrupt = false;
-	int rc = __iface_cmdq_write_relaxed(core, pkt, &needs_interrupt);
+	unsigned long timeout;
+	int rc = 0;
+
+	timeout = jiffies + msecs_to_jiffies(
+		core->capabilities[HW_RESPONSE_TIMEOUT].value);
+retry:
+	mutex_lock(&core->cmdq_lock);
+	if (core->cmdq_fastpath)
+		goto validate;
+	mutex_unlock(&core->cmdq_lock);
+
+	core_lock(core, func);
+	rc = __resume(core);
+	if (rc) {
+		i_vpr_e(inst, "%s: Power on failed\n", func);
+		core_unlock(core, func);
+		return rc;
+	}
+	mutex_lock(&core->cmdq_lock);
+	core_unlock(core, func);
+
+validate:
+	if (!__valdiate_session(core, inst, func)) {
+		mutex_unlock(&core->cmdq_lock);
+		return -EINVAL;
+	}
+
+	/* hold producers back while half of the pending slots are in use */
+	if (!pending->count || pending->count < pending->num_slots >> 1)
+		return 0;
+
+	__cmdq_pending_flush(core, &needs_interrupt);
+	if (needs_interrupt)
+		call_venus_op(core, raise_interrupt, core);
+	if (pending->count < pending->num_slots >> 1)
+		return 0;
+
+	pending->waits++;
+	if (time_after(jiffies, timeout)) {
+		pending->timeouts++;
+		mutex_unlock(&core->cmdq_lock);
+		i_vpr_e(inst, "%s: cmdq busy, %u packets pending\n",
+			func, pending->count);
+		return -EBUSY;
+	}
+	mutex_unlock(&core->cmdq_lock);
+
+	wait_event_timeout(pending->wait,
+		pending->count < pending->num_slots >> 1 ||
+		!__core_in_valid_state(core),
+		msecs_to_jiffies(CMDQ_PENDING_WAIT_MS));
+	needs_interrupt = false;
+	goto retry;
+}
+
+static void __cmdq_release(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_core *core = inst->core;
+
+	mutex_unlock(&core->cmdq_lock);
+	__schedule_power_collapse_work(core);
+}
+
+static int __cmdq_write(struct msm_vidc_core *core, void *pkt, bool allow_intr)
+{
+	bool needs_interrupt = false;
+	int rc = __cmdq_write_packet(core, pkt, &needs_interrupt);
 
-	if (!rc && allow && needs_interrupt)
+	if (!rc && allow_intr && needs_interrupt)
 		call_venus_op(core, raise_interrupt, core);
 
 	return rc;
 }
 
-int __iface_msgq_read(struct msm_vidc_core *core, void *pkt)
+/*
+ * While inst->cmd_batch.enable is set, buffer and property packets are
+ * appended to inst->packet without taking any core lock. header_id and
+ * packet_id are assigned when the header is written to cmdq so that
+ * they stay ordered against other sessions. Caller must hold cmdq_lock.
+ */
+static int __batch_write(struct msm_vidc_inst *inst, bool allow_intr)
 {
-	u32 tx_req_is_set = 0;
+	struct msm_vidc_core *core = inst->core;
+	bool needs_interrupt = false;
 	int rc = 0;
-	struct msm_vidc_iface_q_info *q_info;
 
-	if (!pkt) {
-		d_vpr_e("%s: invalid params\n", __func__);
-		return -EINVAL;
-	}
+	if (!inst->cmd_batch.num_packets)
+		goto raise_intr;
 
-	if (!__core_in_valid_state(core)) {
-		d_vpr_e("%s: fw not in init state\n", __func__);
-		rc = -EINVAL;
-		goto read_error_null;
-	}
+	rc = __cmdq_write_packet(core, inst->packet, &needs_interrupt);
+	inst->cmd_batch.num_packets = 0;
+	if (!rc && needs_interrupt)
+		inst->cmd_batch.pending_intr = true;
 
-	q_info = &core->iface_queues[VIDC_IFACEQ_MSGQ_IDX];
-	if (!q_info->q_array.align_virtual_addr) {
-		d_vpr_e("cannot read from shared MSG Q's\n");
-		rc = -ENODATA;
-		goto read_error_null;
+raise_intr:
+	/* one doorbell covers every header written so far */
+	if (allow_intr && inst->cmd_batch.pending_intr) {
+		call_venus_op(core, raise_interrupt, core);
+		inst->cmd_batch.pending_intr = false;
 	}
 
-	if (!__read_queue(q_info, (u8 *)pkt, &tx_req_is_set)) {
-		if (tx_req_is_set) {
-			//call_venus_op(core, raise_interrupt, core);
-			d_vpr_e("%s: queue is full\n", __func__);
-			rc = -EINVAL;
-			goto read_error_null;
+	return rc;
+}
+
+/* make room for @size bytes of packets in the current batch header */
+static int __batch_prepare(struct msm_vidc_inst *inst, u32 size)
+{
+	struct hfi_header *hdr = (struct hfi_header *)inst->packet;
+	int rc = 0;
+
+	if (inst->cmd_batch.num_packets &&
+		hdr->size + size > inst->packet_size) {
+		rc = __cmdq_acquire(inst, __func__);
+		if (rc) {
+			inst->cmd_batch.num_packets = 0;
+			return rc;
 		}
-		rc = 0;
-	} else {
-		rc = -ENODATA;
+		rc = __batch_write(inst, false);
+		__cmdq_release(inst);
+		if (rc)
+			return rc;
 	}
 
-read_error_null:
+	if (!inst->cmd_batch.num_packets)
+		rc = hfi_create_header(inst->packet, inst->packet_size,
+			inst->session_id, 0);
+
 	return rc;
 }
 
+static int __batch_create_packet(struct msm_vidc_inst *inst,
+	u32 pkt_type, u32 flags, u32 payload_type, u32 port,
+	void *payload, u32 payload_size)
+{
+	int rc = 0;
+
+	rc = hfi_create_packet(inst->packet, inst->packet_size,
+			pkt_type,
+			flags,
+			payload_type,
+			port,
+			0, /* packet_id is assigned in __cmdq_write_packet */
+			payload,
+			payload_size);
+	if (rc)
+		return rc;
+
+	inst->cmd_batch.num_packets++;
+	return 0;
+}
+
+static int __batch_queue_buffer(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buffer, struct msm_vidc_buffer *metabuf)
+{
+	int rc = 0;
+	struct hfi_buffer hfi_buffer;
+	u32 size;
+
+	/* keep buffer and its metadata in the same header */
+	size = sizeof(struct hfi_packet) + sizeof(struct hfi_buffer);
+	rc = __batch_prepare(inst, metabuf ? 2 * size : size);
+	if (rc)
+		return rc;
+
+	rc = get_hfi_buffer(inst, buffer, &hfi_buffer);
+	if (rc)
+		return rc;
+
+	rc = __batch_create_packet(inst, HFI_CMD_BUFFER,
+			HFI_HOST_FLAGS_INTR_REQUIRED,
+			HFI_PAYLOAD_STRUCTURE,
+			get_hfi_port_from_buffer_type(inst, buffer->type),
+			&hfi_buffer, sizeof(hfi_buffer));
+	if (rc)
+		return rc;
+
+	if (metabuf) {
+		rc = get_hfi_buffer(inst, metabuf, &hfi_buffer);
+		if (rc)
+			return rc;
+		rc = __batch_create_packet(inst, HFI_CMD_BUFFER,
+			HFI_HOST_FLAGS_INTR_REQUIRED,
+			HFI_PAYLOAD_STRUCTURE,
+			get_hfi_port_from_buffer_type(inst, metabuf->type),
+			&hfi_buffer, sizeof(hfi_buffer));
+		if (rc)
+			return rc;
+	}
+
+	return 0;
+}
+
+static int __batch_release_buffer(struct msm_vidc_inst *inst,
+	struct msm_vidc_buffer *buffer)
+{
+	int rc = 0;
+	struct hfi_buffer hfi_buffer;
+
+	rc = __batch_prepare(inst,
+		sizeof(struct hfi_packet) + sizeof(struct hfi_buffer));
+	if (rc)
+		return rc;
+
+	rc = get_hfi_buffer(inst, buffer, &hfi_buffer);
+	if (rc)
+		return rc;
+
+	/* add release flag */
+	hfi_buffer.flags |= HFI_BUF_HOST_FLAG_RELEASE;
+
+	return __batch_create_packet(inst, HFI_CMD_BUFFER,
+			(HFI_HOST_FLAGS_RESPONSE_REQUIRED |
+			HFI_HOST_FLAGS_INTR_REQUIRED),
+			HFI_PAYLOAD_STRUCTURE,
+			get_hfi_port_from_buffer_type(inst, buffer->type),
+			&hfi_buffer, sizeof(hfi_buffer));
+}
+
+static int __batch_session_property(struct msm_vidc_inst *inst,
+	u32 pkt_type, u32 flags, u32 port, u32 payload_type,
+	void *payload, u32 payload_size)
+{
+	int rc = 0;
+
+	rc = __batch_prepare(inst, sizeof(struct hfi_packet) + payload_size);
+	if (rc)
+		return rc;
+
+	return __batch_create_packet(inst, pkt_type, flags, payload_type,
+			port, payload, payload_size);
+}
+
 int __iface_dbgq_read(struct msm_vidc_core *core, void *pkt)
 {
 	u32 tx_req_is_set = 0;
@@ -1112,36 +1492,29 @@ dbg_error_null:
 	return rc;
 }
 
-static void __flush_debug_queue(struct msm_vidc_core *core,
-	u8 *packet, u32 packet_size)
+/*
+ * Drains dbgq into the kernel log and the fw_log ring. @error prints the
+ * logs to printk as well.
+ */
+static void __flush_debug_queue(struct msm_vidc_core *core, bool error)
 {
-	u8 *log;
+	struct msm_vidc_fw_log *fw_log;
 	struct hfi_debug_header *pkt;
-	bool local_packet = false;
 	enum vidc_msg_prio log_level = msm_vidc_debug;
+	u32 len;
+	u8 *packet, *log;
 
 	if (!core) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return;
 	}
+	fw_log = &core->fw_log;
 
-	if (!packet || !packet_size) {
-		packet = kzalloc(VIDC_IFACEQ_VAR_HUGE_PKT_SIZE, GFP_KERNEL);
-		if (!packet) {
-			d_vpr_e("%s: fail to allocate\n", __func__);
-			return;
-		}
-		packet_size = VIDC_IFACEQ_VAR_HUGE_PKT_SIZE;
-
-		local_packet = true;
-
-		/*
-		 * Local packet is used when error occurred.
-		 * It is good to print these logs to printk as well.
-		 */
+	if (error)
 		log_level |= FW_PRINTK;
-	}
 
+	mutex_lock(&fw_log->lock);
+	packet = fw_log->packet;
 	while (!__iface_dbgq_read(core, packet)) {
 		pkt = (struct hfi_debug_header *) packet;
 
@@ -1150,9 +1523,9 @@ static void __flush_debug_queue(struct msm_vidc_core *core,
 				__func__, pkt->size);
 			continue;
 		}
-		if (pkt->size >= packet_size) {
+		if (pkt->size >= VIDC_IFACEQ_VAR_HUGE_PKT_SIZE) {
 			d_vpr_e("%s: pkt size[%d] >= packet_size[%d]\n",
-				__func__, pkt->size, packet_size);
+				__func__, pkt->size, VIDC_IFACEQ_VAR_HUGE_PKT_SIZE);
 			continue;
 		}
 
@@ -1162,14 +1535,31 @@ static void __flush_debug_queue(struct msm_vidc_core *core,
 		 * causes dprintk to print this message in two lines
 		 * in the kernel log. Ignoring the first character
 		 * from the message fixes this to print it in a single
-		 * line.
+		 * line. The ring keeps it to separate the messages.
 		 */
-		log = (u8 *)packet + sizeof(struct hfi_debug_header) + 1;
-		dprintk_firmware(log_level, "%s", log);
+		log = (u8 *)packet + sizeof(struct hfi_debug_header);
+		dprintk_firmware(log_level, "%s", log + 1);
+
+		len = strlen(log);
+		if (kfifo_avail(&fw_log->ring) < len)
+			fw_log->dropped++;
+		else
+			kfifo_in(&fw_log->ring, log, len);
 	}
+	mutex_unlock(&fw_log->lock);
+}
+
+static void __schedule_debug_queue_work(struct msm_vidc_core *core)
+{
+	queue_work(core->dbgq_workq, &core->fw_log.work);
+}
 
-	if (local_packet)
-		kfree(packet);
+void venus_hfi_dbgq_work_handler(struct work_struct *work)
+{
+	struct msm_vidc_core *core;
+
+	core = container_of(work, struct msm_vidc_core, fw_log.work);
+	__flush_debug_queue(core, false);
 }
 
 static int __sys_set_debug(struct msm_vidc_core *core, u32 debug)
@@ -1272,20 +1662,32 @@ static int __power_collapse(struct msm_vidc_core *core, bool force)
 		return -EINVAL;
 	}
 
-	__flush_debug_queue(core, (!force ? core->packet : NULL), core->packet_size);
+	__flush_debug_queue(core, force);
+
+	/* route session writes through core->lock until power is settled */
+	__cmdq_set_fastpath(core, false);
+
+	if (core->cmdq_pending.count) {
+		d_vpr_h("%s: %u packets pending for cmdq\n",
+			__func__, core->cmdq_pending.count);
+		goto skip_power_off;
+	}
 
 	rc = call_venus_op(core, prepare_pc, core);
 	if (rc)
 		goto skip_power_off;
 
 	rc = __suspend(core);
-	if (rc)
+	if (rc) {
 		d_vpr_e("Failed __suspend\n");
+		__cmdq_set_fastpath(core, core->power_enabled);
+	}
 
 exit:
 	return rc;
 
 skip_power_off:
+	__cmdq_set_fastpath(core, true);
 	d_vpr_e("%s: skipped\n", __func__);
 	return -EAGAIN;
 }
@@ -2058,7 +2460,7 @@ static int __release_subcaches(struct msm_vidc_core *core)
 	}
 
 	rc = hfi_create_header(core->packet, core->packet_size,
-		0, core->header_id++);
+		0, 0);
 	if (rc)
 		return rc;
 
@@ -2077,7 +2479,7 @@ static int __release_subcaches(struct msm_vidc_core *core)
 				HFI_BUF_HOST_FLAG_NONE,
 				HFI_PAYLOAD_STRUCTURE,
 				HFI_PORT_NONE,
-				core->packet_id++,
+				0,
 				&buf,
 				sizeof(buf));
 			if (rc)
@@ -2179,7 +2581,7 @@ static int __set_subcaches(struct msm_vidc_core *core)
 	}
 
 	rc = hfi_create_header(core->packet, core->packet_size,
-		0, core->header_id++);
+		0, 0);
 	if (rc)
 		goto err_fail_set_subacaches;
 
@@ -2198,7 +2600,7 @@ static int __set_subcaches(struct msm_vidc_core *core)
 				HFI_BUF_HOST_FLAG_NONE,
 				HFI_PAYLOAD_STRUCTURE,
 				HFI_PORT_NONE,
-				core->packet_id++,
+				0,
 				&buf,
 				sizeof(buf));
 			if (rc)
@@ -2259,6 +2661,8 @@ static int __venus_power_off(struct msm_vidc_core* core)
 	if (!core->power_enabled)
 		return 0;
 
+	__cmdq_set_fastpath(core, false);
+
 	rc = call_venus_op(core, power_off, core);
 	if (rc) {
 		d_vpr_e("Failed to power off, err: %d\n", rc);
@@ -2388,6 +2792,7 @@ static int __resume(struct msm_vidc_core *core)
 		rc = 0;
 	}
 
+	__cmdq_set_fastpath(core, true);
 	d_vpr_h("Resumed from power collapse\n");
 exit:
 	/* Don't reset skip_pc_count for SYS_PC_PREP cmd */
@@ -2425,6 +2830,10 @@ static void __interface_queues_deinit(struct msm_vidc_core *core)
 
 	d_vpr_h("%s()\n", __func__);
 
+	__cmdq_pending_reset(core);
+
+	/* dbgq worker must not read the queues while they are freed */
+	mutex_lock(&core->fw_log.lock);
 	msm_vidc_memory_unmap(core, &core->iface_q_table.map);
 	msm_vidc_memory_free(core, &core->iface_q_table.alloc);
 	msm_vidc_memory_unmap(core, &core->sfr.map);
@@ -2441,6 +2850,7 @@ static void __interface_queues_deinit(struct msm_vidc_core *core)
 
 	core->sfr.align_virtual_addr = NULL;
 	core->sfr.align_device_addr = 0;
+	mutex_unlock(&core->fw_log.lock);
 }
 
 static int __interface_queues_init(struct msm_vidc_core *core)
@@ -2749,31 +3159,188 @@ void __unload_fw(struct msm_vidc_core *core)
 	d_vpr_h("%s done\n", __func__);
 }
 
-static int __response_handler(struct msm_vidc_core *core)
+/*
+ * Drains msgq and returns the number of messages handled. With @rearm
+ * clear, firmware is asked not to interrupt for new messages as the
+ * caller keeps polling msgq.
+ */
+static int __response_handler(struct msm_vidc_core *core, bool rearm)
 {
-	int rc = 0;
+	struct msm_vidc_iface_q_info *q_info;
+	struct hfi_queue_header *queue;
+	struct hfi_header *hdr;
+	u32 read_idx, write_idx, msg_size;
+	int rc = 0, count = 0;
 
-	if (call_venus_op(core, watchdog, core, core->intr_status)) {
-		struct hfi_packet pkt = {.type = HFI_SYS_ERROR_WD_TIMEOUT};
+	q_info = &core->iface_queues[VIDC_IFACEQ_MSGQ_IDX];
+	while (__core_in_valid_state(core) &&
+		q_info->q_array.align_virtual_addr) {
+		queue = (struct hfi_queue_header *)q_info->q_hdr;
+		/*
+		 * Memory barrier to make sure data is valid before
+		 * reading it
+		 */
+		mb();
+		read_idx = queue->qhdr_read_idx;
+		write_idx = queue->qhdr_write_idx;
+		if (read_idx == write_idx) {
+			if (!rearm)
+				break;
+			queue->qhdr_rx_req = 1;
+			/* mb() to ensure qhdr is updated in main memory */
+			mb();
+			/* catch messages posted while rx_req was clear */
+			if (queue->qhdr_write_idx != read_idx)
+				continue;
+			break;
+		}
+
+		/* drain everything posted so far, then publish read_idx once */
+		while (read_idx != write_idx) {
+			/* a handler may have deinitialized the core */
+			if (!__core_in_valid_state(core) ||
+				!q_info->q_array.align_virtual_addr)
+				break;
+
+			rc = __msgq_peek(q_info, &read_idx, core->response_packet,
+				core->packet_size, &msg_size);
+			if (rc) {
+				d_vpr_e("Dropping remaining packets\n");
+				read_idx = write_idx;
+				break;
+			}
+
+			/*
+			 * handlers trust hdr->size, which must stay within
+			 * the message firmware wrote into the ring
+			 */
+			hdr = (struct hfi_header *)core->response_packet;
+			if (msg_size < sizeof(*hdr) || hdr->size > msg_size) {
+				d_vpr_e("%s: bad packet size, msg size %d\n",
+					__func__, msg_size);
+				continue;
+			}
 
-		return handle_system_error(core, &pkt);
+			count++;
+			rc = handle_response(core, core->response_packet);
+			if (rc)
+				continue;
+			/* check for system error */
+			if (core->state != MSM_VIDC_CORE_INIT)
+				break;
+		}
+
+		/* queues are gone if system error deinitialized the core */
+		if (!q_info->q_array.align_virtual_addr)
+			break;
+		__msgq_commit(q_info, read_idx, rearm);
+		if (core->state != MSM_VIDC_CORE_INIT)
+			break;
 	}
 
-	memset(core->response_packet, 0, core->packet_size);
-	while (!__iface_msgq_read(core, core->response_packet)) {
-		rc = handle_response(core, core->response_packet);
-		if (rc)
+	return count;
+}
+
+static bool __msgq_pending(struct msm_vidc_core *core)
+{
+	struct msm_vidc_iface_q_info *q_info;
+	struct hfi_queue_header *queue;
+
+	q_info = &core->iface_queues[VIDC_IFACEQ_MSGQ_IDX];
+	if (!q_info->q_array.align_virtual_addr)
+		return false;
+
+	queue = (struct hfi_queue_header *)q_info->q_hdr;
+	/* mb() to read the latest write_idx posted by firmware */
+	mb();
+	return queue->qhdr_read_idx != queue->qhdr_write_idx;
+}
+
+static bool __msgq_poll_mode(struct msm_vidc_core *core)
+{
+	struct msm_vidc_msgq_poll *poll = &core->msgq_poll;
+
+	return poll->enable && poll->budget &&
+		poll->rate >= max_t(u32, poll->rate_threshold, 1);
+}
+
+/*
+ * Keeps draining msgq with the irq disabled until it stays empty for a
+ * few rounds or the budget runs out. A higher message rate allows more
+ * empty rounds before the irq is requested again.
+ */
+static int __msgq_poll(struct msm_vidc_core *core)
+{
+	struct msm_vidc_msgq_poll *poll = &core->msgq_poll;
+	u32 rounds = 0, idle = 0, max_idle;
+	int count = 0;
+
+	max_idle = clamp_t(u32, poll->rate / max_t(u32, poll->rate_threshold, 1),
+		1, max_t(u32, poll->idle_rounds, 1));
+
+	while (rounds++ < poll->budget && __core_in_valid_state(core)) {
+		if (poll->interval_us)
+			usleep_range(poll->interval_us,
+				poll->interval_us + (poll->interval_us >> 1));
+		else
+			cpu_relax();
+		poll->polls++;
+
+		if (!__msgq_pending(core)) {
+			if (++idle >= max_idle)
+				break;
 			continue;
-		/* check for system error */
+		}
+		idle = 0;
+		poll->poll_hits++;
+		count += __response_handler(core, false);
 		if (core->state != MSM_VIDC_CORE_INIT)
-			break;
-		memset(core->response_packet, 0, core->packet_size);
+			return count;
 	}
 
-	__schedule_power_collapse_work(core);
-	__flush_debug_queue(core, core->response_packet, core->packet_size);
+	/* drop interrupts raised while polling, then re-arm msgq */
+	core_lock(core, __func__);
+	if (core->power_enabled)
+		call_venus_op(core, clear_interrupt, core);
+	core_unlock(core, __func__);
 
-	return rc;
+	count += __response_handler(core, true);
+
+	return count;
+}
+
+/* track the msgq rate as a moving average of messages per second */
+static void __msgq_poll_update(struct msm_vidc_core *core, u32 count)
+{
+	struct msm_vidc_msgq_poll *poll = &core->msgq_poll;
+	u64 now, elapsed, rate = 0;
+
+	now = ktime_get_ns();
+	elapsed = now - poll->last_wakeup_ns;
+	poll->last_wakeup_ns = now;
+
+	poll->interrupts++;
+	poll->messages += count;
+	if (count > poll->max_messages)
+		poll->max_messages = count;
+
+	if (elapsed)
+		rate = div64_u64((u64)count * NSEC_PER_SEC, elapsed);
+	poll->rate = (u32)min_t(u64, (3 * (u64)poll->rate + rate) >> 2, U32_MAX);
+}
+
+/* firmware may have freed cmdq space, resubmit pending packets */
+static void __cmdq_pending_drain(struct msm_vidc_core *core)
+{
+	bool needs_interrupt = false;
+
+	mutex_lock(&core->cmdq_lock);
+	if (core->cmdq_pending.count) {
+		__cmdq_pending_flush(core, &needs_interrupt);
+		if (needs_interrupt)
+			call_venus_op(core, raise_interrupt, core);
+	}
+	mutex_unlock(&core->cmdq_lock);
 }
 
 irqreturn_t venus_hfi_isr(int irq, void *data)
@@ -2786,6 +3353,7 @@ irqreturn_t venus_hfi_isr_handler(int irq, void *data)
 {
 	struct msm_vidc_core *core = data;
 	int num_responses = 0, rc = 0;
+	bool polling;
 
 	d_vpr_l("%s()\n", __func__);
 	if (!core) {
@@ -2801,9 +3369,26 @@ irqreturn_t venus_hfi_isr_handler(int irq, void *data)
 		goto exit;
 	}
 	call_venus_op(core, clear_interrupt, core);
+	__cmdq_pending_drain(core);
 	core_unlock(core, __func__);
 
-	num_responses = __response_handler(core);
+	if (!call_venus_op(core, watchdog, core, core->intr_status)) {
+		polling = __msgq_poll_mode(core);
+		num_responses = __response_handler(core, !polling);
+		if (polling)
+			num_responses += __msgq_poll(core);
+		__msgq_poll_update(core, num_responses);
+	}
+
+	if (call_venus_op(core, watchdog, core, core->intr_status)) {
+		struct hfi_packet pkt = {.type = HFI_SYS_ERROR_WD_TIMEOUT};
+
+		handle_system_error(core, &pkt);
+		goto exit;
+	}
+
+	__schedule_power_collapse_work(core);
+	__schedule_debug_queue_work(core);
 
 exit:
 	if (!call_venus_op(core, watchdog, core, core->intr_status))
@@ -2953,6 +3538,7 @@ int venus_hfi_core_init(struct msm_vidc_core *core)
 		rc = 0;
 	}
 
+	__cmdq_set_fastpath(core, true);
 	d_vpr_h("%s(): successful\n", __func__);
 	return 0;
 
@@ -2977,7 +3563,7 @@ int venus_hfi_core_deinit(struct msm_vidc_core *core, bool force)
 	if (core->state == MSM_VIDC_CORE_DEINIT)
 		return 0;
 	__resume(core);
-	__flush_debug_queue(core, (!force ? core->packet : NULL), core->packet_size);
+	__flush_debug_queue(core, force);
 	__disable_subcaches(core);
 	__unload_fw(core);
 	/**
@@ -3060,7 +3646,7 @@ int venus_hfi_trigger_ssr(struct msm_vidc_core *core, u32 type,
 
 	rc = hfi_create_header(core->packet, core->packet_size,
 			   0 /*session_id*/,
-			   core->header_id++);
+			   0);
 	if (rc)
 		goto exit;
 
@@ -3071,7 +3657,7 @@ int venus_hfi_trigger_ssr(struct msm_vidc_core *core, u32 type,
 				   HFI_HOST_FLAGS_INTR_REQUIRED,
 				   HFI_PAYLOAD_U64,
 				   HFI_PORT_NONE,
-				   core->packet_id++,
+				   0,
 				   &payload, sizeof(u64));
 	if (rc)
 		goto exit;
@@ -3147,7 +3733,7 @@ int venus_hfi_session_set_codec(struct msm_vidc_inst *inst)
 	}
 
 	rc = hfi_create_header(inst->packet, inst->packet_size,
-			inst->session_id, core->header_id++);
+			inst->session_id, 0);
 	if (rc)
 		goto unlock;
 
@@ -3157,7 +3743,7 @@ int venus_hfi_session_set_codec(struct msm_vidc_inst *inst)
 			HFI_HOST_FLAGS_NONE,
 			HFI_PAYLOAD_U32_ENUM,
 			HFI_PORT_NONE,
-			core->packet_id++,
+			0,
 			&codec,
 			sizeof(u32));
 	if (rc)
@@ -3191,7 +3777,7 @@ int venus_hfi_session_set_secure_mode(struct msm_vidc_inst *inst)
 	}
 
 	rc = hfi_create_header(inst->packet, inst->packet_size,
-			inst->session_id, core->header_id++);
+			inst->session_id, 0);
 	if (rc)
 		goto unlock;
 
@@ -3201,7 +3787,7 @@ int venus_hfi_session_set_secure_mode(struct msm_vidc_inst *inst)
 			HFI_HOST_FLAGS_NONE,
 			HFI_PAYLOAD_U32,
 			HFI_PORT_NONE,
-			core->packet_id++,
+			0,
 			&secure_mode,
 			sizeof(u32));
 	if (rc)
@@ -3228,6 +3814,11 @@ int venus_hfi_session_property(struct msm_vidc_inst *inst,
 		return -EINVAL;
 	}
 	core = inst->core;
+
+	if (inst->cmd_batch.enable)
+		return __batch_session_property(inst, pkt_type, flags, port,
+			payload_type, payload, payload_size);
+
 	core_lock(core, __func__);
 
 	if (!__valdiate_session(core, inst, __func__)) {
@@ -3236,7 +3827,7 @@ int venus_hfi_session_property(struct msm_vidc_inst *inst,
 	}
 
 	rc = hfi_create_header(inst->packet, inst->packet_size,
-				inst->session_id, core->header_id++);
+				inst->session_id, 0);
 	if (rc)
 		goto unlock;
 	rc = hfi_create_packet(inst->packet, inst->packet_size,
@@ -3244,7 +3835,7 @@ int venus_hfi_session_property(struct msm_vidc_inst *inst,
 				flags,
 				payload_type,
 				port,
-				core->packet_id++,
+				0,
 				payload,
 				payload_size);
 	if (rc)
@@ -3406,7 +3997,7 @@ int venus_hfi_session_command(struct msm_vidc_inst *inst,
 
 	rc = hfi_create_header(inst->packet, inst->packet_size,
 			inst->session_id,
-			core->header_id++);
+			0);
 	if (rc)
 		goto unlock;
 
@@ -3416,7 +4007,7 @@ int venus_hfi_session_command(struct msm_vidc_inst *inst,
 			HFI_HOST_FLAGS_INTR_REQUIRED),
 			payload_type,
 			get_hfi_port(inst, port),
-			core->packet_id++,
+			0,
 			payload,
 			payload_size);
 	if (rc)
@@ -3448,11 +4039,16 @@ int venus_hfi_queue_super_buffer(struct msm_vidc_inst *inst,
 	}
 	core = inst->core;
 	capability = inst->capabilities;
-	core_lock(core, __func__);
 
-	if (!__valdiate_session(core, inst, __func__)) {
-		rc = -EINVAL;
-		goto unlock;
+	rc = __cmdq_acquire(inst, __func__);
+	if (rc)
+		goto exit;
+
+	/* batched packets must reach firmware ahead of the super buffer */
+	if (inst->cmd_batch.enable) {
+		rc = __batch_write(inst, false);
+		if (rc)
+			goto unlock;
 	}
 
 	/* Get super yuv buffer */
@@ -3499,7 +4095,7 @@ int venus_hfi_queue_super_buffer(struct msm_vidc_inst *inst,
 	while (cnt < batch_size) {
 		/* Create header */
 		rc = hfi_create_header(inst->packet, inst->packet_size,
-				inst->session_id, core->header_id++);
+				inst->session_id, 0);
 		if (rc)
 			goto unlock;
 
@@ -3512,7 +4108,7 @@ int venus_hfi_queue_super_buffer(struct msm_vidc_inst *inst,
 				HFI_HOST_FLAGS_INTR_REQUIRED,
 				HFI_PAYLOAD_STRUCTURE,
 				get_hfi_port_from_buffer_type(inst, buffer->type),
-				core->packet_id++,
+				0,
 				&hfi_buffer,
 				sizeof(hfi_buffer));
 		if (rc)
@@ -3528,7 +4124,7 @@ int venus_hfi_queue_super_buffer(struct msm_vidc_inst *inst,
 				HFI_HOST_FLAGS_INTR_REQUIRED,
 				HFI_PAYLOAD_STRUCTURE,
 				get_hfi_port_from_buffer_type(inst, metabuf->type),
-				core->packet_id++,
+				0,
 				&hfi_meta_buffer,
 				sizeof(hfi_meta_buffer));
 			if (rc)
@@ -3536,14 +4132,15 @@ int venus_hfi_queue_super_buffer(struct msm_vidc_inst *inst,
 		}
 
 		/* Raise interrupt only for last pkt in the batch */
-		rc = __iface_cmdq_write_intr(inst->core, inst->packet, (cnt == batch_size - 1));
+		rc = __cmdq_write(core, inst->packet, (cnt == batch_size - 1));
 		if (rc)
 			goto unlock;
 
 		cnt++;
 	}
 unlock:
-	core_unlock(core, __func__);
+	__cmdq_release(inst);
+exit:
 	if (rc)
 		i_vpr_e(inst, "%s: queue super buffer failed: %d\n", __func__, rc);
 
@@ -3562,19 +4159,20 @@ int venus_hfi_queue_buffer(struct msm_vidc_inst *inst,
 		return -EINVAL;
 	}
 	core = inst->core;
-	core_lock(core, __func__);
 
-	if (!__valdiate_session(core, inst, __func__)) {
-		rc = -EINVAL;
-		goto unlock;
-	}
+	if (inst->cmd_batch.enable)
+		return __batch_queue_buffer(inst, buffer, metabuf);
+
+	rc = __cmdq_acquire(inst, __func__);
+	if (rc)
+		return rc;
 
 	rc = get_hfi_buffer(inst, buffer, &hfi_buffer);
 	if (rc)
 		goto unlock;
 
 	rc = hfi_create_header(inst->packet, inst->packet_size,
-			   inst->session_id, core->header_id++);
+			   inst->session_id, 0);
 	if (rc)
 		goto unlock;
 
@@ -3584,7 +4182,7 @@ int venus_hfi_queue_buffer(struct msm_vidc_inst *inst,
 			HFI_HOST_FLAGS_INTR_REQUIRED,
 			HFI_PAYLOAD_STRUCTURE,
 			get_hfi_port_from_buffer_type(inst, buffer->type),
-			core->packet_id++,
+			0,
 			&hfi_buffer,
 			sizeof(hfi_buffer));
 	if (rc)
@@ -3600,19 +4198,19 @@ int venus_hfi_queue_buffer(struct msm_vidc_inst *inst,
 			HFI_HOST_FLAGS_INTR_REQUIRED,
 			HFI_PAYLOAD_STRUCTURE,
 			get_hfi_port_from_buffer_type(inst, metabuf->type),
-			core->packet_id++,
+			0,
 			&hfi_buffer,
 			sizeof(hfi_buffer));
 		if (rc)
 			goto unlock;
 	}
 
-	rc = __iface_cmdq_write(inst->core, inst->packet);
+	rc = __cmdq_write(core, inst->packet, true);
 	if (rc)
 		goto unlock;
 
 unlock:
-	core_unlock(core, __func__);
+	__cmdq_release(inst);
 	return rc;
 }
 
@@ -3628,12 +4226,13 @@ int venus_hfi_release_buffer(struct msm_vidc_inst *inst,
 		return -EINVAL;
 	}
 	core = inst->core;
-	core_lock(core, __func__);
 
-	if (!__valdiate_session(core, inst, __func__)) {
-		rc = -EINVAL;
-		goto unlock;
-	}
+	if (inst->cmd_batch.enable)
+		return __batch_release_buffer(inst, buffer);
+
+	rc = __cmdq_acquire(inst, __func__);
+	if (rc)
+		return rc;
 
 	rc = get_hfi_buffer(inst, buffer, &hfi_buffer);
 	if (rc)
@@ -3643,7 +4242,7 @@ int venus_hfi_release_buffer(struct msm_vidc_inst *inst,
 	hfi_buffer.flags |= HFI_BUF_HOST_FLAG_RELEASE;
 
 	rc = hfi_create_header(inst->packet, inst->packet_size,
-			   inst->session_id, core->header_id++);
+			   inst->session_id, 0);
 	if (rc)
 		goto unlock;
 
@@ -3654,18 +4253,18 @@ int venus_hfi_release_buffer(struct msm_vidc_inst *inst,
 			HFI_HOST_FLAGS_INTR_REQUIRED),
 			HFI_PAYLOAD_STRUCTURE,
 			get_hfi_port_from_buffer_type(inst, buffer->type),
-			core->packet_id++,
+			0,
 			&hfi_buffer,
 			sizeof(hfi_buffer));
 	if (rc)
 		goto unlock;
 
-	rc = __iface_cmdq_write(inst->core, inst->packet);
+	rc = __cmdq_write(core, inst->packet, true);
 	if (rc)
 		goto unlock;
 
 unlock:
-	core_unlock(core, __func__);
+	__cmdq_release(inst);
 	return rc;
 }
 
@@ -3722,3 +4321,69 @@ exit:
 
 	return rc;
 }
+
+int venus_hfi_batch_begin(struct msm_vidc_inst *inst)
+{
+	if (!inst || !inst->core || !inst->packet) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return -EINVAL;
+	}
+
+	if (inst->cmd_batch.enable) {
+		i_vpr_e(inst, "%s: batch already in progress\n", __func__);
+		return -EINVAL;
+	}
+
+	inst->cmd_batch.num_packets = 0;
+	inst->cmd_batch.pending_intr = false;
+	inst->cmd_batch.enable = true;
+
+	return 0;
+}
+
+/*
+ * Flushes the packets batched since venus_hfi_batch_begin, also when the
+ * caller failed half way (caller_rc), and returns caller_rc if set or
+ * else the result of the flush.
+ */
+int venus_hfi_batch_end(struct msm_vidc_inst *inst, int caller_rc)
+{
+	int rc = 0;
+
+	if (!inst || !inst->core) {
+		d_vpr_e("%s: invalid params\n", __func__);
+		return caller_rc ? caller_rc : -EINVAL;
+	}
+
+	if (!inst->cmd_batch.enable)
+		return caller_rc;
+
+	if (!inst->packet) {
+		rc = -EINVAL;
+		goto exit;
+	}
+
+	/* nothing queued, no need to resume the core */
+	if (!inst->cmd_batch.num_packets && !inst->cmd_batch.pending_intr)
+		goto exit;
+
+	rc = __cmdq_acquire(inst, __func__);
+	if (rc)
+		goto exit;
+
+	rc = __batch_write(inst, true);
+	__cmdq_release(inst);
+
+exit:
+	inst->cmd_batch.enable = false;
+	inst->cmd_batch.num_packets = 0;
+	inst->cmd_batch.pending_intr = false;
+	if (rc)
+		i_vpr_e(inst, "%s: batch write failed: %d\n", __func__, rc);
+
+	return caller_rc ? caller_rc : rc;
+}
+
+#if defined(CONFIG_MSM_VIDC_KUNIT_TEST)
+#include "../test/venus_hfi_test.c"
+#endif
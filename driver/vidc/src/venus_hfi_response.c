@@ -13,6 +13,7 @@
 #include "msm_vdec.h"
 #include "msm_vidc_control.h"
 #include "msm_vidc_memory.h"
+#include "msm_vidc_power.h"
 
 #define in_range(range, val) (((range.begin) < (val)) && ((range.end) > (val)))
 
@@ -243,7 +244,7 @@ static int validate_hdr_packet(struct msm_vidc_core *core,
 	/* validate all packets */
 	for (i = 0; i < hdr->num_packets; i++) {
 		packet = (struct hfi_packet *)pkt;
-		rc = validate_packet(pkt, core->response_packet, core->packet_size, function);
+		rc = validate_packet(pkt, (u8 *)hdr, hdr->size, function);
 		if (rc)
 			return rc;
 
@@ -625,12 +626,8 @@ static int handle_read_only_buffer(struct msm_vidc_inst *inst,
 	if (!ro_buffers)
 		return -EINVAL;
 
-	list_for_each_entry(ro_buf, &ro_buffers->list, list) {
-		if (ro_buf->device_addr == buf->device_addr) {
-			found = true;
-			break;
-		}
-	}
+	ro_buf = msm_vidc_find_ro_buffer(inst, buf->device_addr);
+	found = !!ro_buf;
 	/*
 	 * RO flag: add to read_only list if buffer is not present
 	 *          if present, do nothing
@@ -643,7 +640,12 @@ static int handle_read_only_buffer(struct msm_vidc_inst *inst,
 		}
 		memcpy(ro_buf, buf, sizeof(struct msm_vidc_buffer));
 		INIT_LIST_HEAD(&ro_buf->list);
+		/* read only list is indexed by device address only */
+		INIT_HLIST_NODE(&ro_buf->index_node);
+		hash_add(inst->buffers.index.read_only, &ro_buf->addr_node,
+			ro_buf->device_addr);
 		list_add_tail(&ro_buf->list, &ro_buffers->list);
+		msm_vidc_pin_delayed_unmap(inst, ro_buf);
 		print_vidc_buffer(VIDC_LOW, "low ", "ro buf added", inst, ro_buf);
 	}
 	ro_buf->attr |= MSM_VIDC_ATTR_READ_ONLY;
@@ -673,12 +675,8 @@ static int handle_non_read_only_buffer(struct msm_vidc_inst *inst,
 	if (!ro_buffers)
 		return -EINVAL;
 
-	list_for_each_entry(ro_buf, &ro_buffers->list, list) {
-		if (ro_buf->device_addr == buffer->base_address) {
-			found = true;
-			break;
-		}
-	}
+	ro_buf = msm_vidc_find_ro_buffer(inst, buffer->base_address);
+	found = !!ro_buf;
 
 	/*
 	 * Without RO flag: remove buffer from read_only list if present
@@ -686,6 +684,8 @@ static int handle_non_read_only_buffer(struct msm_vidc_inst *inst,
 	 */
 	if (found) {
 		print_vidc_buffer(VIDC_LOW, "low ", "ro buf deleted", inst, ro_buf);
+		msm_vidc_unpin_delayed_unmap(inst, ro_buf);
+		hash_del(&ro_buf->addr_node);
 		list_del(&ro_buf->list);
 		msm_memory_free(inst, ro_buf);
 	}
@@ -697,29 +697,18 @@ static int handle_input_buffer(struct msm_vidc_inst *inst,
 	struct hfi_buffer *buffer)
 {
 	int rc = 0;
-	struct msm_vidc_buffers *buffers;
 	struct msm_vidc_buffer *buf;
 	struct msm_vidc_core *core;
 	u32 frame_size, batch_size;
-	bool found;
 
 	if (!inst || !buffer || !inst->capabilities || !inst->core) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return -EINVAL;
 	}
 	core = inst->core;
-	buffers = msm_vidc_get_buffers(inst, MSM_VIDC_BUF_INPUT, __func__);
-	if (!buffers)
-		return -EINVAL;
-
-	found = false;
-	list_for_each_entry(buf, &buffers->list, list) {
-		if (buf->index == buffer->index) {
-			found = true;
-			break;
-		}
-	}
-	if (!found) {
+	buf = msm_vidc_find_buffer_by_index(inst, MSM_VIDC_BUF_INPUT,
+		buffer->index);
+	if (!buf) {
 		i_vpr_e(inst, "%s: invalid buffer idx %d addr %#x data_offset %d\n",
 			__func__, buffer->index, buffer->base_address,
 			buffer->data_offset);
@@ -750,6 +739,8 @@ static int handle_input_buffer(struct msm_vidc_inst *inst,
 	buf->flags = get_driver_buffer_flags(inst, buffer->flags);
 
 	print_vidc_buffer(VIDC_HIGH, "high", "dqbuf", inst, buf);
+	if (is_encode_session(inst))
+		msm_vidc_dcvs_frame_done(inst);
 	msm_vidc_update_stats(inst, buf, MSM_VIDC_DEBUGFS_EVENT_EBD);
 
 	return rc;
@@ -759,9 +750,8 @@ static int handle_output_buffer(struct msm_vidc_inst *inst,
 	struct hfi_buffer *buffer)
 {
 	int rc = 0;
-	struct msm_vidc_buffers *buffers;
 	struct msm_vidc_buffer *buf;
-	bool found, fatal = false;
+	bool fatal = false;
 
 	if (!inst || !inst->capabilities) {
 		d_vpr_e("%s: Invalid params\n", __func__);
@@ -776,22 +766,13 @@ static int handle_output_buffer(struct msm_vidc_inst *inst,
 		}
 	}
 
-	buffers = msm_vidc_get_buffers(inst, MSM_VIDC_BUF_OUTPUT, __func__);
-	if (!buffers)
-		return -EINVAL;
-
-	found = false;
-	list_for_each_entry(buf, &buffers->list, list) {
-		if (is_decode_session(inst))
-			found = (buf->device_addr == buffer->base_address &&
-				buf->data_offset == buffer->data_offset);
-		else
-			found = (buf->index == buffer->index);
-
-		if (found)
-			break;
-	}
-	if (!found)
+	if (is_decode_session(inst))
+		buf = msm_vidc_find_buffer_by_addr(inst, MSM_VIDC_BUF_OUTPUT,
+			buffer->base_address, buffer->data_offset);
+	else
+		buf = msm_vidc_find_buffer_by_index(inst, MSM_VIDC_BUF_OUTPUT,
+			buffer->index);
+	if (!buf)
 		return 0;
 
 	buf->data_offset = buffer->data_offset;
@@ -873,9 +854,12 @@ static int handle_output_buffer(struct msm_vidc_inst *inst,
 	}
 
 	if (!is_image_session(inst) && is_decode_session(inst) && buf->data_size)
-		msm_vidc_update_timestamp(inst, buf->timestamp);
+		msm_vidc_update_timestamp(inst,
+			div_u64(buf->timestamp, NSEC_PER_USEC));
 
 	print_vidc_buffer(VIDC_HIGH, "high", "dqbuf", inst, buf);
+	if (is_decode_session(inst))
+		msm_vidc_dcvs_frame_done(inst);
 	msm_vidc_update_stats(inst, buf, MSM_VIDC_DEBUGFS_EVENT_FBD);
 
 	return rc;
@@ -885,29 +869,18 @@ static int handle_input_metadata_buffer(struct msm_vidc_inst *inst,
 	struct hfi_buffer *buffer)
 {
 	int rc = 0;
-	struct msm_vidc_buffers *buffers;
 	struct msm_vidc_buffer *buf;
 	struct msm_vidc_core *core;
 	u32 frame_size, batch_size;
-	bool found;
 
 	if (!inst || !buffer || !inst->capabilities || !inst->core) {
 		d_vpr_e("%s: invalid params\n", __func__);
 		return -EINVAL;
 	}
 	core = inst->core;
-	buffers = msm_vidc_get_buffers(inst, MSM_VIDC_BUF_INPUT_META, __func__);
-	if (!buffers)
-		return -EINVAL;
-
-	found = false;
-	list_for_each_entry(buf, &buffers->list, list) {
-		if (buf->index == buffer->index) {
-			found = true;
-			break;
-		}
-	}
-	if (!found) {
+	buf = msm_vidc_find_buffer_by_index(inst, MSM_VIDC_BUF_INPUT_META,
+		buffer->index);
+	if (!buf) {
 		i_vpr_e(inst, "%s: invalid idx %d daddr %#x data_offset %d\n",
 			__func__, buffer->index, buffer->base_address,
 			buffer->data_offset);
@@ -943,22 +916,11 @@ static int handle_output_metadata_buffer(struct msm_vidc_inst *inst,
 	struct hfi_buffer *buffer)
 {
 	int rc = 0;
-	struct msm_vidc_buffers *buffers;
 	struct msm_vidc_buffer *buf;
-	bool found;
-
-	buffers = msm_vidc_get_buffers(inst, MSM_VIDC_BUF_OUTPUT_META, __func__);
-	if (!buffers)
-		return -EINVAL;
 
-	found = false;
-	list_for_each_entry(buf, &buffers->list, list) {
-		if (buf->index == buffer->index) {
-			found = true;
-			break;
-		}
-	}
-	if (!found) {
+	buf = msm_vidc_find_buffer_by_index(inst, MSM_VIDC_BUF_OUTPUT_META,
+		buffer->index);
+	if (!buf) {
 		i_vpr_e(inst, "%s: invalid idx %d daddr %#x data_offset %d\n",
 			__func__, buffer->index, buffer->base_address,
 			buffer->data_offset);
@@ -1272,27 +1234,39 @@ static int handle_dpb_list_property(struct msm_vidc_inst *inst,
 	struct hfi_packet *pkt)
 {
 	u32 payload_size, num_words_in_payload;
-	u8 *payload_start;
+	u32 *payload;
+	struct msm_vidc_dpb_entry *entry;
 	int i = 0;
 
 	payload_size = pkt->size - sizeof(struct hfi_packet);
-	num_words_in_payload = payload_size / 4;
-	payload_start = (u8 *)((u8 *)pkt + sizeof(struct hfi_packet));
-	memset(inst->dpb_list_payload, 0, MAX_DPB_LIST_ARRAY_SIZE);
+	payload = (u32 *)((u8 *)pkt + sizeof(struct hfi_packet));
+	msm_vidc_dpb_list_reset(inst);
 
 	if (payload_size > MAX_DPB_LIST_PAYLOAD_SIZE) {
 		i_vpr_e(inst,
 			"%s: dpb list payload size %d exceeds expected max size %d\n",
 			__func__, payload_size, MAX_DPB_LIST_PAYLOAD_SIZE);
 		msm_vidc_change_inst_state(inst, MSM_VIDC_ERROR, __func__);
+		payload_size = MAX_DPB_LIST_PAYLOAD_SIZE;
 	}
-	memcpy(inst->dpb_list_payload, payload_start, payload_size);
+	num_words_in_payload = payload_size / 4;
 
+	/*
+	 * dpb list payload details:
+	 * payload[0-1]           : 64 bits base_address of DPB-1
+	 * payload[2]             : 32 bits addr_offset  of DPB-1
+	 * payload[3]             : 32 bits data_offset  of DPB-1
+	 * firmware zero fills unused entries, which match no buffer
+	 */
 	for (i = 0; (i + 3) < num_words_in_payload; i = i + 4) {
 		i_vpr_l(inst,
 			"%s: base addr %#x %#x, addr offset %#x, data offset %#x\n",
-			__func__, inst->dpb_list_payload[i], inst->dpb_list_payload[i + 1],
-			inst->dpb_list_payload[i + 2], inst->dpb_list_payload[i + 3]);
+			__func__, payload[i], payload[i + 1],
+			payload[i + 2], payload[i + 3]);
+		entry = &inst->dpb_list.entries[inst->dpb_list.count++];
+		entry->device_addr = payload[i];
+		entry->data_offset = payload[i + 3];
+		hash_add(inst->dpb_list.index, &entry->node, entry->device_addr);
 	}
 
 	return 0;
@@ -1534,40 +1508,100 @@ exit:
 	return rc;
 }
 
+/* session packet ranges in the order they are handled */
+static const struct msm_vidc_inst_hfi_range session_ranges[] = {
+	{HFI_SESSION_ERROR_BEGIN,  HFI_SESSION_ERROR_END,  handle_session_error    },
+	{HFI_INFORMATION_BEGIN,    HFI_INFORMATION_END,    handle_session_info     },
+	{HFI_PROP_BEGIN,           HFI_PROP_END,           handle_session_property },
+	{HFI_CMD_BEGIN,            HFI_CMD_END,            handle_session_command  },
+};
+
+/* each range owns one value of the top byte, map it to session_ranges + 1 */
+#define HFI_RANGE_SHIFT 24
+static const u8 session_range_map[256] = {
+	[HFI_SESSION_ERROR_BEGIN >> HFI_RANGE_SHIFT] = 1,
+	[HFI_INFORMATION_BEGIN >> HFI_RANGE_SHIFT]   = 2,
+	[HFI_PROP_BEGIN >> HFI_RANGE_SHIFT]          = 3,
+	[HFI_CMD_BEGIN >> HFI_RANGE_SHIFT]           = 4,
+};
+
+/*
+ * Walk the packets of @hdr once, handling session errors flagged by the
+ * firmware and queueing each packet on the list of its range. @head and
+ * @tail hold one list per session_ranges entry, U16_MAX when empty.
+ */
+static void __session_response_classify(struct msm_vidc_inst *inst,
+	struct hfi_header *hdr, u16 *head, u16 *tail)
+{
+	struct msm_vidc_hfi_dispatch *dispatch = &inst->hfi_dispatch;
+	struct hfi_packet *packet;
+	u32 offset;
+	u8 idx;
+	int i, j;
+
+	BUILD_BUG_ON((HFI_SESSION_ERROR_BEGIN >> HFI_RANGE_SHIFT) !=
+		(HFI_SESSION_ERROR_END >> HFI_RANGE_SHIFT));
+	BUILD_BUG_ON((HFI_INFORMATION_BEGIN >> HFI_RANGE_SHIFT) !=
+		(HFI_INFORMATION_END >> HFI_RANGE_SHIFT));
+	BUILD_BUG_ON((HFI_PROP_BEGIN >> HFI_RANGE_SHIFT) !=
+		(HFI_PROP_END >> HFI_RANGE_SHIFT));
+	BUILD_BUG_ON((HFI_CMD_BEGIN >> HFI_RANGE_SHIFT) !=
+		(HFI_CMD_END >> HFI_RANGE_SHIFT));
+
+	for (i = 0; i < ARRAY_SIZE(session_ranges); i++)
+		head[i] = U16_MAX;
+
+	offset = sizeof(struct hfi_header);
+	for (j = 0; j < hdr->num_packets; j++) {
+		packet = (struct hfi_packet *)((u8 *)hdr + offset);
+		/* handle session error */
+		if (packet->flags & HFI_FW_FLAGS_SESSION_ERROR) {
+			i_vpr_e(inst, "%s: received session error %#x\n",
+				__func__, packet->type);
+			handle_session_error(inst, packet);
+		}
+
+		idx = session_range_map[packet->type >> HFI_RANGE_SHIFT];
+		if (idx && in_range(session_ranges[idx - 1], packet->type)) {
+			if (j >= MAX_HFI_RESPONSE_PACKETS) {
+				i_vpr_e(inst, "%s: too many packets %u\n",
+					__func__, hdr->num_packets);
+				break;
+			}
+			i = idx - 1;
+			dispatch->offset[j] = offset;
+			dispatch->next[j] = U16_MAX;
+			if (head[i] == U16_MAX)
+				head[i] = j;
+			else
+				dispatch->next[tail[i]] = j;
+			tail[i] = j;
+		}
+		offset += packet->size;
+	}
+}
+
 static int __handle_session_response(struct msm_vidc_inst *inst,
 	struct hfi_header *hdr)
 {
 	int rc = 0;
+	struct msm_vidc_hfi_dispatch *dispatch = &inst->hfi_dispatch;
 	struct hfi_packet *packet;
-	u8 *pkt, *start_pkt;
+	u16 head[ARRAY_SIZE(session_ranges)];
+	u16 tail[ARRAY_SIZE(session_ranges)];
 	bool dequeue = false;
 	int i, j;
-	static const struct msm_vidc_inst_hfi_range be[] = {
-		{HFI_SESSION_ERROR_BEGIN,  HFI_SESSION_ERROR_END,  handle_session_error    },
-		{HFI_INFORMATION_BEGIN,    HFI_INFORMATION_END,    handle_session_info     },
-		{HFI_PROP_BEGIN,           HFI_PROP_END,           handle_session_property },
-		{HFI_CMD_BEGIN,            HFI_CMD_END,            handle_session_command  },
-	};
 
 	memset(&inst->hfi_frame_info, 0, sizeof(struct msm_vidc_hfi_frame_info));
-	start_pkt = (u8 *)((u8 *)hdr + sizeof(struct hfi_header));
-	for (i = 0; i < ARRAY_SIZE(be); i++) {
-		pkt = start_pkt;
-		for (j = 0; j < hdr->num_packets; j++) {
-			packet = (struct hfi_packet *)pkt;
-			/* handle session error */
-			if (packet->flags & HFI_FW_FLAGS_SESSION_ERROR) {
-				i_vpr_e(inst, "%s: received session error %#x\n",
-					__func__, packet->type);
-				handle_session_error(inst, packet);
-			}
-			if (in_range(be[i], packet->type)) {
-				dequeue |= (packet->type == HFI_CMD_BUFFER);
-				rc = be[i].handle(inst, packet);
-				if (rc)
-					msm_vidc_change_inst_state(inst, MSM_VIDC_ERROR, __func__);
-			}
-			pkt += packet->size;
+	__session_response_classify(inst, hdr, head, tail);
+
+	for (i = 0; i < ARRAY_SIZE(session_ranges); i++) {
+		for (j = head[i]; j != U16_MAX; j = dispatch->next[j]) {
+			packet = (struct hfi_packet *)((u8 *)hdr + dispatch->offset[j]);
+			dequeue |= (packet->type == HFI_CMD_BUFFER);
+			rc = session_ranges[i].handle(inst, packet);
+			if (rc)
+				msm_vidc_change_inst_state(inst, MSM_VIDC_ERROR, __func__);
 		}
 	}
 
@@ -1671,32 +1705,97 @@ void handle_session_response_work_handler(struct work_struct *work)
 				resp_work->type);
 			break;
 		}
-		list_del(&resp_work->list);
-		kfree(resp_work->data);
-		kfree(resp_work);
+		put_response_work(inst, resp_work);
 	}
 	inst_unlock(inst, __func__);
 
 	put_inst(inst);
 }
 
+int init_response_works(struct msm_vidc_inst *inst)
+{
+	struct response_work *work;
+	int i;
+
+	for (i = 0; i < MAX_RESPONSE_WORKS; i++) {
+		work = &inst->response_work_slots[i];
+		work->data = kzalloc(VIDC_IFACEQ_VAR_HUGE_PKT_SIZE, GFP_KERNEL);
+		if (!work->data)
+			return -ENOMEM;
+		list_add_tail(&work->list, &inst->free_response_works);
+	}
+
+	return 0;
+}
+
+void deinit_response_works(struct msm_vidc_inst *inst)
+{
+	int i;
+
+	for (i = 0; i < MAX_RESPONSE_WORKS; i++) {
+		kfree(inst->response_work_slots[i].data);
+		inst->response_work_slots[i].data = NULL;
+	}
+	INIT_LIST_HEAD(&inst->free_response_works);
+}
+
+static bool is_response_work_slot(struct msm_vidc_inst *inst,
+	struct response_work *work)
+{
+	return work >= inst->response_work_slots &&
+		work < inst->response_work_slots + MAX_RESPONSE_WORKS;
+}
+
+/*
+ * return a handled or discarded response work to the free list, or free
+ * it if it was allocated once all the slots were in use
+ */
+void put_response_work(struct msm_vidc_inst *inst,
+	struct response_work *work)
+{
+	if (is_response_work_slot(inst, work)) {
+		list_move_tail(&work->list, &inst->free_response_works);
+		return;
+	}
+
+	list_del(&work->list);
+	kfree(work->data);
+	kfree(work);
+}
+
 static int queue_response_work(struct msm_vidc_inst *inst,
 	enum response_work_type type, void *hdr, u32 hdr_size)
 {
+	struct msm_vidc_core *core = inst->core;
 	struct response_work *work;
 
-	work = kzalloc(sizeof(struct response_work), GFP_KERNEL);
-	if (!work)
-		return -ENOMEM;
-	INIT_LIST_HEAD(&work->list);
+	if (hdr_size > VIDC_IFACEQ_VAR_HUGE_PKT_SIZE) {
+		i_vpr_e(inst, "%s: invalid response size %u\n",
+			__func__, hdr_size);
+		return -EINVAL;
+	}
+
+	work = list_first_entry_or_null(&inst->free_response_works,
+		struct response_work, list);
+	if (work) {
+		list_move_tail(&work->list, &inst->response_works);
+	} else {
+		/* deferred responses may hold every slot, never drop one */
+		work = kzalloc(sizeof(struct response_work), GFP_KERNEL);
+		if (!work)
+			return -ENOMEM;
+		work->data = kzalloc(hdr_size, GFP_KERNEL);
+		if (!work->data) {
+			kfree(work);
+			return -ENOMEM;
+		}
+		list_add_tail(&work->list, &inst->response_works);
+	}
+
 	work->type = type;
 	work->data_size = hdr_size;
-	work->data = kzalloc(hdr_size, GFP_KERNEL);
-	if (!work->data)
-		return -ENOMEM;
 	memcpy(work->data, hdr, hdr_size);
-	list_add_tail(&work->list, &inst->response_works);
-	queue_delayed_work(inst->response_workq,
+	queue_delayed_work(core->response_workq,
 			&inst->response_work, msecs_to_jiffies(0));
 	return 0;
 }
@@ -1711,11 +1810,8 @@ int cancel_response_work(struct msm_vidc_inst *inst)
 	}
 	cancel_delayed_work(&inst->response_work);
 
-	list_for_each_entry_safe(work, dummy_work, &inst->response_works, list) {
-		list_del(&work->list);
-		kfree(work->data);
-		kfree(work);
-	}
+	list_for_each_entry_safe(work, dummy_work, &inst->response_works, list)
+		put_response_work(inst, work);
 
 	return 0;
 }
@@ -1773,8 +1869,11 @@ static int handle_session_response(struct msm_vidc_core *core,
 	if (offload) {
 		i_vpr_h(inst, "%s: queue response work %#x\n", __func__, type);
 		rc = queue_response_work(inst, type, (void *)hdr, hdr->size);
-		if (rc)
+		if (rc) {
+			/* a lost response leaves the session hanging */
 			i_vpr_e(inst, "%s: Offload response work failed\n", __func__);
+			msm_vidc_change_inst_state(inst, MSM_VIDC_ERROR, __func__);
+		}
 
 		goto exit;
 	}
@@ -0,0 +1,799 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Copyright (c) 2021, The Linux Foundation. All rights reserved.
+ */
+
+/*
+ * KUnit tests for the per instance dmabuf tracker, driver buffer
+ * mappings and the timestamp window in msm_vidc_driver.c. Included at
+ * the end of msm_vidc_driver.c so the static helpers are reachable.
+ * Buffers come from a test exporter that hands out a fixed iova per
+ * buffer and counts attachments, the context banks are stand ins with
+ * no iommu behind.
+ */
+
+#include <kunit/test.h>
+#include <linux/fdtable.h>
+
+#define VIDC_DRIVER_TEST_BUFS		256
+#define VIDC_DRIVER_TEST_BUF_SIZE	SZ_64K
+#define VIDC_DRIVER_TEST_IOVA_BASE	0x40000000
+#define VIDC_DRIVER_TEST_STEPS		20000
+/* frame spacing in us, timestamps are in us */
+#define VIDC_DRIVER_TEST_30FPS		33333
+#define VIDC_DRIVER_TEST_60FPS		16667
+
+struct vidc_driver_test_buf {
+	int fd;
+	struct dma_buf *dmabuf;
+	dma_addr_t iova;
+	atomic_t attachments;
+	atomic_t maps;
+	bool released;
+};
+
+struct vidc_driver_test {
+	struct msm_vidc_core core;
+	struct msm_vidc_core_capability caps[CORE_CAP_MAX + 1];
+	struct msm_vidc_dt dt;
+	struct context_bank_info cb[MSM_VIDC_REGION_MAX];
+	struct device cb_dev[MSM_VIDC_REGION_MAX];
+	struct msm_vidc_inst *inst;
+	struct vidc_driver_test_buf bufs[VIDC_DRIVER_TEST_BUFS];
+	u32 num_bufs;
+	u32 seed;
+};
+
+static u32 vidc_driver_test_rand(struct vidc_driver_test *t)
+{
+	t->seed = t->seed * 1103515245 + 12345;
+	return t->seed >> 8;
+}
+
+static int vidc_driver_test_attach(struct dma_buf *dmabuf,
+	struct dma_buf_attachment *attach)
+{
+	struct vidc_driver_test_buf *buf = dmabuf->priv;
+
+	atomic_inc(&buf->attachments);
+	return 0;
+}
+
+static void vidc_driver_test_detach(struct dma_buf *dmabuf,
+	struct dma_buf_attachment *attach)
+{
+	struct vidc_driver_test_buf *buf = dmabuf->priv;
+
+	atomic_dec(&buf->attachments);
+}
+
+static struct sg_table *vidc_driver_test_map_dma_buf(
+	struct dma_buf_attachment *attach, enum dma_data_direction dir)
+{
+	struct vidc_driver_test_buf *buf = attach->dmabuf->priv;
+	struct sg_table *table;
+
+	table = kzalloc(sizeof(*table), GFP_KERNEL);
+	if (!table)
+		return ERR_PTR(-ENOMEM);
+	if (sg_alloc_table(table, 1, GFP_KERNEL)) {
+		kfree(table);
+		return ERR_PTR(-ENOMEM);
+	}
+	sg_dma_address(table->sgl) = buf->iova;
+	sg_dma_len(table->sgl) = attach->dmabuf->size;
+	atomic_inc(&buf->maps);
+
+	return table;
+}
+
+static void vidc_driver_test_unmap_dma_buf(struct dma_buf_attachment *attach,
+	struct sg_table *table, enum dma_data_direction dir)
+{
+	struct vidc_driver_test_buf *buf = attach->dmabuf->priv;
+
+	atomic_dec(&buf->maps);
+	sg_free_table(table);
+	kfree(table);
+}
+
+static void vidc_driver_test_release(struct dma_buf *dmabuf)
+{
+	struct vidc_driver_test_buf *buf = dmabuf->priv;
+
+	buf->released = true;
+}
+
+static const struct dma_buf_ops vidc_driver_test_dma_buf_ops = {
+	.attach = vidc_driver_test_attach,
+	.detach = vidc_driver_test_detach,
+	.map_dma_buf = vidc_driver_test_map_dma_buf,
+	.unmap_dma_buf = vidc_driver_test_unmap_dma_buf,
+	.release = vidc_driver_test_release,
+};
+
+/* exports @count buffers, each fd holds the only reference */
+static void vidc_driver_test_export(struct kunit *test, u32 count)
+{
+	struct vidc_driver_test *t = test->priv;
+	struct vidc_driver_test_buf *buf;
+	DEFINE_DMA_BUF_EXPORT_INFO(exp_info);
+
+	KUNIT_ASSERT_LE(test, t->num_bufs + count, VIDC_DRIVER_TEST_BUFS);
+	while (count--) {
+		buf = &t->bufs[t->num_bufs];
+		buf->iova = VIDC_DRIVER_TEST_IOVA_BASE +
+			t->num_bufs * VIDC_DRIVER_TEST_BUF_SIZE;
+
+		exp_info.ops = &vidc_driver_test_dma_buf_ops;
+		exp_info.size = VIDC_DRIVER_TEST_BUF_SIZE;
+		exp_info.flags = O_RDWR;
+		exp_info.priv = buf;
+		buf->dmabuf = dma_buf_export(&exp_info);
+		KUNIT_ASSERT_NOT_ERR_OR_NULL(test, buf->dmabuf);
+
+		buf->fd = dma_buf_fd(buf->dmabuf, O_CLOEXEC);
+		if (buf->fd < 0)
+			dma_buf_put(buf->dmabuf);
+		KUNIT_ASSERT_GE(test, buf->fd, 0);
+		t->num_bufs++;
+	}
+}
+
+/* the tracker list is the reference the hash lookups are checked against */
+static struct msm_memory_dmabuf *vidc_driver_test_tracker(
+	struct msm_vidc_inst *inst, struct dma_buf *dmabuf)
+{
+	struct msm_memory_dmabuf *entry;
+
+	list_for_each_entry(entry, &inst->dmabuf_tracker, list) {
+		if (entry->dmabuf == dmabuf)
+			return entry;
+	}
+
+	return NULL;
+}
+
+static u32 vidc_driver_test_list_count(struct list_head *head)
+{
+	struct list_head *pos;
+	u32 count = 0;
+
+	list_for_each(pos, head)
+		count++;
+
+	return count;
+}
+
+/* closes every fd, each buffer must be released with it */
+static void vidc_driver_test_close_all(struct kunit *test)
+{
+	struct vidc_driver_test *t = test->priv;
+	u32 i;
+
+	for (i = 0; i < t->num_bufs; i++) {
+		KUNIT_EXPECT_FALSE(test, t->bufs[i].released);
+		KUNIT_EXPECT_EQ(test, close_fd(t->bufs[i].fd), 0);
+		KUNIT_EXPECT_TRUE(test, t->bufs[i].released);
+	}
+	t->num_bufs = 0;
+}
+
+static void vidc_driver_test_buffer(struct vidc_driver_test *t,
+	struct msm_vidc_buffer *vbuf, u32 index, enum msm_vidc_buffer_type type)
+{
+	memset(vbuf, 0, sizeof(*vbuf));
+	vbuf->type = type;
+	vbuf->index = index;
+	vbuf->fd = t->bufs[index].fd;
+	vbuf->dmabuf = t->bufs[index].dmabuf;
+	vbuf->buffer_size = VIDC_DRIVER_TEST_BUF_SIZE;
+}
+
+static int vidc_driver_test_init(struct kunit *test)
+{
+	struct vidc_driver_test *t;
+	struct msm_vidc_core *core;
+	struct msm_vidc_inst *inst;
+	u32 i;
+
+	t = kunit_kzalloc(test, sizeof(*t), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, t);
+	core = &t->core;
+	test->priv = t;
+	t->seed = 0x5eed1234;
+
+	for (i = MSM_VIDC_NON_SECURE; i < MSM_VIDC_REGION_MAX; i++) {
+		t->cb[i].dev = &t->cb_dev[i];
+		t->cb[i].is_secure = i != MSM_VIDC_NON_SECURE &&
+			i != MSM_VIDC_NON_SECURE_PIXEL;
+		t->dt.cb_region[i] = &t->cb[i];
+	}
+	mutex_init(&core->lock);
+	INIT_LIST_HEAD(&core->instances);
+	core->dt = &t->dt;
+	core->capabilities = t->caps;
+	KUNIT_ASSERT_EQ(test, msm_memory_caches_init(core), 0);
+
+	inst = kunit_kzalloc(test, sizeof(*inst), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, inst);
+	inst->capabilities = kunit_kzalloc(test, sizeof(*inst->capabilities),
+		GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, inst->capabilities);
+	inst->core = core;
+	inst->domain = MSM_VIDC_ENCODER;
+	t->inst = inst;
+
+	INIT_LIST_HEAD(&inst->mappings.input.list);
+	INIT_LIST_HEAD(&inst->mappings.output.list);
+	INIT_LIST_HEAD(&inst->mappings.lru.list);
+	INIT_LIST_HEAD(&inst->dmabuf_tracker);
+	hash_init(inst->dmabuf_index);
+	hash_init(inst->mappings.index);
+	KUNIT_ASSERT_EQ(test, msm_memory_pools_init(inst), 0);
+
+	return 0;
+}
+
+static void vidc_driver_test_exit(struct kunit *test)
+{
+	struct vidc_driver_test *t = test->priv;
+	u32 i;
+
+	if (!t)
+		return;
+
+	if (t->inst && t->inst->pool[0].cache)
+		msm_memory_pools_deinit(t->inst);
+	msm_memory_caches_deinit(&t->core);
+	for (i = 0; i < t->num_bufs; i++)
+		close_fd(t->bufs[i].fd);
+}
+
+/* a second get of the same fd is one tracker entry with two references */
+static void vidc_driver_test_dmabuf_get_put(struct kunit *test)
+{
+	struct vidc_driver_test *t = test->priv;
+	struct vidc_driver_test_buf *buf;
+	struct msm_memory_dmabuf *entry;
+	struct dma_buf *dmabuf;
+
+	vidc_driver_test_export(test, 1);
+	buf = &t->bufs[0];
+
+	dmabuf = msm_vidc_memory_get_dmabuf(t->inst, buf->fd);
+	KUNIT_ASSERT_PTR_EQ(test, dmabuf, buf->dmabuf);
+	KUNIT_EXPECT_PTR_EQ(test, msm_vidc_memory_get_dmabuf(t->inst, buf->fd),
+		buf->dmabuf);
+
+	entry = vidc_driver_test_tracker(t->inst, dmabuf);
+	KUNIT_ASSERT_NOT_NULL(test, entry);
+	KUNIT_EXPECT_EQ(test, entry->refcount, 2);
+	KUNIT_EXPECT_EQ(test, vidc_driver_test_list_count(&t->inst->dmabuf_tracker), 1);
+
+	msm_vidc_memory_put_dmabuf(t->inst, dmabuf);
+	KUNIT_EXPECT_EQ(test, entry->refcount, 1);
+	msm_vidc_memory_put_dmabuf(t->inst, dmabuf);
+	KUNIT_EXPECT_NULL(test, vidc_driver_test_tracker(t->inst, dmabuf));
+	KUNIT_EXPECT_TRUE(test, list_empty(&t->inst->pool[MSM_MEM_POOL_DMABUF].busy_pool));
+
+	/* an unbalanced put is refused, the fd reference stays */
+	msm_vidc_memory_put_dmabuf(t->inst, dmabuf);
+	KUNIT_EXPECT_FALSE(test, buf->released);
+
+	KUNIT_EXPECT_NULL(test, msm_vidc_memory_get_dmabuf(t->inst, -1));
+	KUNIT_EXPECT_TRUE(test, list_empty(&t->inst->dmabuf_tracker));
+	vidc_driver_test_close_all(test);
+}
+
+/*
+ * More buffers than hash buckets, so lookups walk shared chains while
+ * entries come and go in random order.
+ */
+static void vidc_driver_test_dmabuf_churn(struct kunit *test)
+{
+	struct vidc_driver_test *t = test->priv;
+	u32 held[VIDC_DRIVER_TEST_BUFS] = { 0 };
+	struct msm_memory_dmabuf *entry;
+	struct vidc_driver_test_buf *buf;
+	u32 step, k, live = 0;
+
+	BUILD_BUG_ON(VIDC_DRIVER_TEST_BUFS <= (1 << DMABUF_HASH_BITS));
+	vidc_driver_test_export(test, VIDC_DRIVER_TEST_BUFS);
+
+	for (step = 0; step < VIDC_DRIVER_TEST_STEPS; step++) {
+		k = vidc_driver_test_rand(t) % VIDC_DRIVER_TEST_BUFS;
+		buf = &t->bufs[k];
+		if (held[k] < 3 && (!held[k] || vidc_driver_test_rand(t) & 1)) {
+			KUNIT_ASSERT_PTR_EQ(test,
+				msm_vidc_memory_get_dmabuf(t->inst, buf->fd),
+				buf->dmabuf);
+			live += !held[k]++;
+		} else {
+			msm_vidc_memory_put_dmabuf(t->inst, buf->dmabuf);
+			live -= !--held[k];
+		}
+
+		entry = vidc_driver_test_tracker(t->inst, buf->dmabuf);
+		if (held[k]) {
+			KUNIT_ASSERT_NOT_NULL(test, entry);
+			KUNIT_ASSERT_EQ(test, entry->refcount, held[k]);
+		} else {
+			KUNIT_ASSERT_NULL(test, entry);
+		}
+		KUNIT_ASSERT_EQ(test,
+			vidc_driver_test_list_count(&t->inst->dmabuf_tracker), live);
+	}
+
+	for (k = 0; k < VIDC_DRIVER_TEST_BUFS; k++)
+		while (held[k]--)
+			msm_vidc_memory_put_dmabuf(t->inst, t->bufs[k].dmabuf);
+	KUNIT_EXPECT_TRUE(test, list_empty(&t->inst->dmabuf_tracker));
+	KUNIT_EXPECT_TRUE(test, list_empty(&t->inst->pool[MSM_MEM_POOL_DMABUF].busy_pool));
+	vidc_driver_test_close_all(test);
+}
+
+/* mapping a buffer again takes a reference, not another attachment */
+static void vidc_driver_test_map_unmap(struct kunit *test)
+{
+	struct vidc_driver_test *t = test->priv;
+	struct vidc_driver_test_buf *buf;
+	struct msm_vidc_buffer vbuf;
+	struct msm_vidc_map *map;
+
+	vidc_driver_test_export(test, 1);
+	buf = &t->bufs[0];
+	vidc_driver_test_buffer(t, &vbuf, 0, MSM_VIDC_BUF_INPUT);
+
+	KUNIT_ASSERT_EQ(test, msm_vidc_map_driver_buf(t->inst, &vbuf), 0);
+	KUNIT_EXPECT_EQ(test, vbuf.device_addr, buf->iova);
+	KUNIT_ASSERT_EQ(test, msm_vidc_map_driver_buf(t->inst, &vbuf), 0);
+	KUNIT_EXPECT_EQ(test, vbuf.device_addr, buf->iova);
+
+	map = msm_vidc_find_map(t->inst, MSM_VIDC_BUF_INPUT, buf->dmabuf);
+	KUNIT_ASSERT_NOT_NULL(test, map);
+	KUNIT_EXPECT_EQ(test, map->refcount, 2);
+	KUNIT_EXPECT_EQ(test, map->region, MSM_VIDC_NON_SECURE_PIXEL);
+	KUNIT_EXPECT_EQ(test, vidc_driver_test_list_count(&t->inst->mappings.input.list), 1);
+	KUNIT_EXPECT_EQ(test, atomic_read(&buf->attachments), 1);
+	KUNIT_EXPECT_EQ(test, atomic_read(&buf->maps), 1);
+	KUNIT_EXPECT_EQ(test, vidc_driver_test_tracker(t->inst, buf->dmabuf)->refcount, 1);
+
+	KUNIT_EXPECT_EQ(test, msm_vidc_unmap_driver_buf(t->inst, &vbuf), 0);
+	KUNIT_EXPECT_EQ(test, map->refcount, 1);
+	KUNIT_EXPECT_EQ(test, atomic_read(&buf->attachments), 1);
+
+	KUNIT_EXPECT_EQ(test, msm_vidc_unmap_driver_buf(t->inst, &vbuf), 0);
+	KUNIT_EXPECT_NULL(test, msm_vidc_find_map(t->inst, MSM_VIDC_BUF_INPUT,
+		buf->dmabuf));
+	KUNIT_EXPECT_TRUE(test, list_empty(&t->inst->mappings.input.list));
+	KUNIT_EXPECT_TRUE(test, list_empty(&t->inst->dmabuf_tracker));
+	KUNIT_EXPECT_EQ(test, atomic_read(&buf->attachments), 0);
+	KUNIT_EXPECT_EQ(test, atomic_read(&buf->maps), 0);
+	KUNIT_EXPECT_TRUE(test, list_empty(&t->inst->pool[MSM_MEM_POOL_MAP].busy_pool));
+
+	/* nothing left to unmap */
+	KUNIT_EXPECT_EQ(test, msm_vidc_unmap_driver_buf(t->inst, &vbuf), -EINVAL);
+	vidc_driver_test_close_all(test);
+}
+
+/* one dmabuf queued on two ports is two maps sharing a hash chain */
+static void vidc_driver_test_map_types(struct kunit *test)
+{
+	struct vidc_driver_test *t = test->priv;
+	struct vidc_driver_test_buf *buf;
+	struct msm_vidc_buffer in, out;
+	struct msm_vidc_map *in_map, *out_map;
+
+	vidc_driver_test_export(test, 1);
+	buf = &t->bufs[0];
+	vidc_driver_test_buffer(t, &in, 0, MSM_VIDC_BUF_INPUT);
+	vidc_driver_test_buffer(t, &out, 0, MSM_VIDC_BUF_OUTPUT);
+
+	KUNIT_ASSERT_EQ(test, msm_vidc_map_driver_buf(t->inst, &in), 0);
+	KUNIT_ASSERT_EQ(test, msm_vidc_map_driver_buf(t->inst, &out), 0);
+
+	in_map = msm_vidc_find_map(t->inst, MSM_VIDC_BUF_INPUT, buf->dmabuf);
+	out_map = msm_vidc_find_map(t->inst, MSM_VIDC_BUF_OUTPUT, buf->dmabuf);
+	KUNIT_ASSERT_NOT_NULL(test, in_map);
+	KUNIT_ASSERT_NOT_NULL(test, out_map);
+	KUNIT_EXPECT_PTR_NE(test, in_map, out_map);
+	KUNIT_EXPECT_EQ(test, out_map->region, MSM_VIDC_NON_SECURE);
+	KUNIT_EXPECT_EQ(test, atomic_read(&buf->attachments), 2);
+	KUNIT_EXPECT_EQ(test, vidc_driver_test_tracker(t->inst, buf->dmabuf)->refcount, 2);
+
+	KUNIT_EXPECT_EQ(test, msm_vidc_unmap_driver_buf(t->inst, &in), 0);
+	KUNIT_EXPECT_NULL(test, msm_vidc_find_map(t->inst, MSM_VIDC_BUF_INPUT,
+		buf->dmabuf));
+	KUNIT_EXPECT_PTR_EQ(test, msm_vidc_find_map(t->inst, MSM_VIDC_BUF_OUTPUT,
+		buf->dmabuf), out_map);
+	KUNIT_EXPECT_EQ(test, vidc_driver_test_tracker(t->inst, buf->dmabuf)->refcount, 1);
+
+	KUNIT_EXPECT_EQ(test, msm_vidc_unmap_driver_buf(t->inst, &out), 0);
+	KUNIT_EXPECT_TRUE(test, list_empty(&t->inst->dmabuf_tracker));
+	KUNIT_EXPECT_EQ(test, atomic_read(&buf->attachments), 0);
+}
+
+/*
+ * Decoder output keeps a delayed unmap reference: the buffer stays
+ * mapped on the lru once the session lets go, and a later qbuf of the
+ * same dmabuf reuses that mapping.
+ */
+static void vidc_driver_test_map_delayed_unmap(struct kunit *test)
+{
+	struct vidc_driver_test *t = test->priv;
+	struct vidc_driver_test_buf *buf;
+	struct msm_vidc_buffer vbuf;
+	struct msm_vidc_map *map;
+
+	t->inst->domain = MSM_VIDC_DECODER;
+	vidc_driver_test_export(test, 1);
+	buf = &t->bufs[0];
+	vidc_driver_test_buffer(t, &vbuf, 0, MSM_VIDC_BUF_OUTPUT);
+
+	KUNIT_ASSERT_EQ(test, msm_vidc_map_driver_buf(t->inst, &vbuf), 0);
+	map = msm_vidc_find_map(t->inst, MSM_VIDC_BUF_OUTPUT, buf->dmabuf);
+	KUNIT_ASSERT_NOT_NULL(test, map);
+	KUNIT_EXPECT_EQ(test, map->refcount, 2);
+	KUNIT_EXPECT_EQ(test, t->inst->mappings.lru.misses, 1);
+
+	KUNIT_EXPECT_EQ(test, msm_vidc_unmap_driver_buf(t->inst, &vbuf), 0);
+	KUNIT_EXPECT_EQ(test, map->refcount, 1);
+	KUNIT_EXPECT_EQ(test, t->inst->mappings.lru.count, 1);
+	KUNIT_EXPECT_EQ(test, atomic_read(&buf->attachments), 1);
+
+	KUNIT_ASSERT_EQ(test, msm_vidc_map_driver_buf(t->inst, &vbuf), 0);
+	KUNIT_EXPECT_EQ(test, vbuf.device_addr, buf->iova);
+	KUNIT_EXPECT_EQ(test, t->inst->mappings.lru.hits, 1);
+	KUNIT_EXPECT_EQ(test, t->inst->mappings.lru.count, 0);
+	KUNIT_EXPECT_EQ(test, atomic_read(&buf->attachments), 1);
+	KUNIT_EXPECT_EQ(test, atomic_read(&buf->maps), 1);
+
+	KUNIT_EXPECT_EQ(test, msm_vidc_unmap_driver_buf(t->inst, &vbuf), 0);
+	KUNIT_EXPECT_EQ(test, msm_vidc_memory_unmap_completely(t->inst, map), 0);
+	KUNIT_EXPECT_TRUE(test, list_empty(&t->inst->mappings.output.list));
+	KUNIT_EXPECT_TRUE(test, list_empty(&t->inst->mappings.lru.list));
+	KUNIT_EXPECT_TRUE(test, list_empty(&t->inst->dmabuf_tracker));
+	KUNIT_EXPECT_EQ(test, atomic_read(&buf->attachments), 0);
+}
+
+/*
+ * Random map and unmap of many buffers on both encoder ports, checked
+ * against a model of the expected reference counts after every step.
+ */
+static void vidc_driver_test_map_churn(struct kunit *test)
+{
+	static const enum msm_vidc_buffer_type types[] = {
+		MSM_VIDC_BUF_INPUT, MSM_VIDC_BUF_OUTPUT,
+	};
+	struct vidc_driver_test *t = test->priv;
+	u32 (*held)[ARRAY_SIZE(types)];
+	struct vidc_driver_test_buf *buf;
+	struct msm_memory_dmabuf *entry;
+	struct msm_vidc_buffer vbuf;
+	struct msm_vidc_map *map;
+	u32 step, k, i, j, maps;
+
+	held = kunit_kzalloc(test, VIDC_DRIVER_TEST_BUFS * sizeof(*held),
+		GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, held);
+	vidc_driver_test_export(test, VIDC_DRIVER_TEST_BUFS);
+
+	for (step = 0; step < VIDC_DRIVER_TEST_STEPS; step++) {
+		k = vidc_driver_test_rand(t) % VIDC_DRIVER_TEST_BUFS;
+		i = vidc_driver_test_rand(t) % ARRAY_SIZE(types);
+		buf = &t->bufs[k];
+		vidc_driver_test_buffer(t, &vbuf, k, types[i]);
+
+		if (held[k][i] < 3 && (!held[k][i] || vidc_driver_test_rand(t) & 1)) {
+			KUNIT_ASSERT_EQ(test, msm_vidc_map_driver_buf(t->inst, &vbuf), 0);
+			KUNIT_ASSERT_EQ(test, vbuf.device_addr, buf->iova);
+			held[k][i]++;
+		} else {
+			KUNIT_ASSERT_EQ(test, msm_vidc_unmap_driver_buf(t->inst, &vbuf), 0);
+			held[k][i]--;
+		}
+
+		map = msm_vidc_find_map(t->inst, types[i], buf->dmabuf);
+		if (held[k][i]) {
+			KUNIT_ASSERT_NOT_NULL(test, map);
+			KUNIT_ASSERT_EQ(test, map->refcount, held[k][i]);
+		} else {
+			KUNIT_ASSERT_NULL(test, map);
+		}
+
+		/* each live map holds one tracker reference and one attachment */
+		for (j = 0, maps = 0; j < ARRAY_SIZE(types); j++)
+			maps += !!held[k][j];
+		entry = vidc_driver_test_tracker(t->inst, buf->dmabuf);
+		KUNIT_ASSERT_EQ(test, entry ? entry->refcount : 0, maps);
+		KUNIT_ASSERT_EQ(test, atomic_read(&buf->attachments), maps);
+	}
+
+	for (k = 0; k < VIDC_DRIVER_TEST_BUFS; k++) {
+		for (i = 0; i < ARRAY_SIZE(types); i++) {
+			vidc_driver_test_buffer(t, &vbuf, k, types[i]);
+			while (held[k][i]--)
+				KUNIT_ASSERT_EQ(test,
+					msm_vidc_unmap_driver_buf(t->inst, &vbuf), 0);
+		}
+		KUNIT_EXPECT_EQ(test, atomic_read(&t->bufs[k].attachments), 0);
+	}
+	KUNIT_EXPECT_TRUE(test, list_empty(&t->inst->mappings.input.list));
+	KUNIT_EXPECT_TRUE(test, list_empty(&t->inst->mappings.output.list));
+	KUNIT_EXPECT_TRUE(test, list_empty(&t->inst->dmabuf_tracker));
+	KUNIT_EXPECT_TRUE(test, list_empty(&t->inst->pool[MSM_MEM_POOL_MAP].busy_pool));
+	KUNIT_EXPECT_TRUE(test, list_empty(&t->inst->pool[MSM_MEM_POOL_DMABUF].busy_pool));
+	vidc_driver_test_close_all(test);
+}
+
+/* closing the fd after the last put releases the buffer */
+static void vidc_driver_test_dmabuf_release(struct kunit *test)
+{
+	struct vidc_driver_test *t = test->priv;
+	struct vidc_driver_test_buf *buf;
+	struct msm_vidc_buffer vbuf;
+
+	vidc_driver_test_export(test, 1);
+	buf = &t->bufs[0];
+	vidc_driver_test_buffer(t, &vbuf, 0, MSM_VIDC_BUF_INPUT);
+
+	KUNIT_ASSERT_EQ(test, msm_vidc_map_driver_buf(t->inst, &vbuf), 0);
+	/* the mapping keeps the buffer alive past close */
+	KUNIT_EXPECT_EQ(test, close_fd(buf->fd), 0);
+	t->num_bufs = 0;
+	KUNIT_EXPECT_FALSE(test, buf->released);
+
+	KUNIT_EXPECT_EQ(test, msm_vidc_unmap_driver_buf(t->inst, &vbuf), 0);
+	KUNIT_EXPECT_TRUE(test, buf->released);
+}
+
+/* Q16 fps msm_vidc_update_timestamp() computes from a spacing of @delta us */
+static u64 vidc_driver_test_fps(u64 delta)
+{
+	return div64_u64(((u64)USEC_PER_SEC << 16) + delta / 2, delta);
+}
+
+/*
+ * The window must hold exactly the last arrivals, sorted: @arrivals are
+ * all timestamps fed so far, in feeding order.
+ */
+static void vidc_driver_test_check_window(struct kunit *test,
+	struct msm_vidc_timestamps *ts, const u64 *arrivals, u32 n, u32 window)
+{
+	u64 expect[MAX_FPS_WINDOW], v;
+	u32 count = min(n, window), i, j;
+
+	for (i = 0; i < count; i++) {
+		v = arrivals[n - count + i];
+		for (j = i; j > 0 && expect[j - 1] > v; j--)
+			expect[j] = expect[j - 1];
+		expect[j] = v;
+	}
+
+	KUNIT_ASSERT_EQ(test, ts->count, count);
+	for (i = 0; i < count; i++)
+		KUNIT_ASSERT_EQ(test, ts->sorted[i], expect[i]);
+}
+
+/*
+ * Decoder input arrives in decode order, I0 P3 B1 B2 P6 B4 B5 ..., so
+ * consecutive timestamps step +3, -2, +1 frames. The window median still
+ * gives the display rate.
+ */
+static void vidc_driver_test_ts_bframes(struct kunit *test)
+{
+	struct vidc_driver_test *t = test->priv;
+	struct msm_vidc_timestamps *ts = &t->inst->timestamps;
+	u64 arrivals[40];
+	u32 i, frame;
+
+	t->inst->domain = MSM_VIDC_DECODER;
+	for (i = 0; i < ARRAY_SIZE(arrivals); i++) {
+		/* 0, then 3 1 2, 6 4 5, ... */
+		frame = !i ? 0 : (i - 1) / 3 * 3 + ((i - 1) % 3 ? (i - 1) % 3 : 3);
+		arrivals[i] = (u64)frame * VIDC_DRIVER_TEST_30FPS;
+		KUNIT_ASSERT_EQ(test, msm_vidc_update_timestamp(t->inst,
+			arrivals[i]), 0);
+		vidc_driver_test_check_window(test, ts, arrivals, i + 1,
+			DEC_FPS_WINDOW);
+		if (i >= DEC_FPS_WINDOW)
+			KUNIT_EXPECT_EQ(test, ts->fps,
+				vidc_driver_test_fps(VIDC_DRIVER_TEST_30FPS));
+	}
+	KUNIT_EXPECT_EQ(test, msm_vidc_calc_window_avg_framerate(t->inst), 30);
+}
+
+/* repeated timestamps add no spacing, they neither stall nor double fps */
+static void vidc_driver_test_ts_duplicates(struct kunit *test)
+{
+	struct vidc_driver_test *t = test->priv;
+	struct msm_vidc_timestamps *ts = &t->inst->timestamps;
+	u64 arrivals[40];
+	u32 i;
+
+	t->inst->domain = MSM_VIDC_DECODER;
+
+	/* nothing but one timestamp: no rate yet */
+	for (i = 0; i < 2 * DEC_FPS_WINDOW; i++)
+		KUNIT_ASSERT_EQ(test, msm_vidc_update_timestamp(t->inst, 1000), 0);
+	KUNIT_EXPECT_EQ(test, ts->count, DEC_FPS_WINDOW);
+	KUNIT_EXPECT_EQ(test, ts->fps, 0);
+	KUNIT_EXPECT_EQ(test, msm_vidc_calc_window_avg_framerate(t->inst), 0);
+
+	/* every timestamp twice, as two fields or a repeated frame */
+	msm_vidc_flush_ts(t->inst);
+	for (i = 0; i < ARRAY_SIZE(arrivals); i++) {
+		arrivals[i] = (u64)(i / 2) * VIDC_DRIVER_TEST_30FPS;
+		KUNIT_ASSERT_EQ(test, msm_vidc_update_timestamp(t->inst,
+			arrivals[i]), 0);
+		vidc_driver_test_check_window(test, ts, arrivals, i + 1,
+			DEC_FPS_WINDOW);
+		if (i >= 2)
+			KUNIT_EXPECT_EQ(test, ts->fps,
+				vidc_driver_test_fps(VIDC_DRIVER_TEST_30FPS));
+	}
+	KUNIT_EXPECT_EQ(test, msm_vidc_calc_window_avg_framerate(t->inst), 30);
+}
+
+/*
+ * The oldest arrival leaves the window, not the smallest timestamp. A
+ * rate change takes over once it holds the window median, and the
+ * averaged fps follows it.
+ */
+static void vidc_driver_test_ts_eviction(struct kunit *test)
+{
+	struct vidc_driver_test *t = test->priv;
+	struct msm_vidc_timestamps *ts = &t->inst->timestamps;
+	u64 arrivals[40], next = 0, prev_avg = 0;
+	u32 i, fps;
+
+	t->inst->domain = MSM_VIDC_DECODER;
+	for (i = 0; i < ARRAY_SIZE(arrivals); i++) {
+		arrivals[i] = next;
+		next += i < 20 ? VIDC_DRIVER_TEST_30FPS : VIDC_DRIVER_TEST_60FPS;
+		KUNIT_ASSERT_EQ(test, msm_vidc_update_timestamp(t->inst,
+			arrivals[i]), 0);
+		vidc_driver_test_check_window(test, ts, arrivals, i + 1,
+			DEC_FPS_WINDOW);
+
+		if (i == 19)
+			KUNIT_EXPECT_EQ(test, ts->fps,
+				vidc_driver_test_fps(VIDC_DRIVER_TEST_30FPS));
+		/* the window is all 60 fps spacing again */
+		if (i >= 20 + DEC_FPS_WINDOW)
+			KUNIT_EXPECT_EQ(test, ts->fps,
+				vidc_driver_test_fps(VIDC_DRIVER_TEST_60FPS));
+		/* the average only moves toward the new rate */
+		if (i >= 20)
+			KUNIT_EXPECT_GE(test, ts->avg_fps, prev_avg);
+		prev_avg = ts->avg_fps;
+	}
+	fps = msm_vidc_calc_window_avg_framerate(t->inst);
+	KUNIT_EXPECT_GE(test, fps, 58);
+	KUNIT_EXPECT_LE(test, fps, 60);
+
+	/* a late timestamp below the whole window is evicted by age */
+	msm_vidc_flush_ts(t->inst);
+	for (i = 0; i < DEC_FPS_WINDOW; i++) {
+		arrivals[i] = (u64)(i + 10) * VIDC_DRIVER_TEST_30FPS;
+		msm_vidc_update_timestamp(t->inst, arrivals[i]);
+	}
+	arrivals[i] = 0;
+	msm_vidc_update_timestamp(t->inst, arrivals[i]);
+	vidc_driver_test_check_window(test, ts, arrivals, i + 1, DEC_FPS_WINDOW);
+	KUNIT_EXPECT_EQ(test, ts->sorted[0], 0);
+	KUNIT_EXPECT_EQ(test, ts->sorted[1], 11 * VIDC_DRIVER_TEST_30FPS);
+	for (i++; i < 2 * DEC_FPS_WINDOW + 1; i++) {
+		arrivals[i] = (u64)(i + 9) * VIDC_DRIVER_TEST_30FPS;
+		msm_vidc_update_timestamp(t->inst, arrivals[i]);
+	}
+	vidc_driver_test_check_window(test, ts, arrivals, i, DEC_FPS_WINDOW);
+	KUNIT_EXPECT_NE(test, ts->sorted[0], 0);
+}
+
+/*
+ * Jittered, reordered and repeated timestamps in random order, for both
+ * window sizes: the window always holds the last arrivals, sorted.
+ */
+static void vidc_driver_test_ts_random(struct kunit *test)
+{
+	static const enum msm_vidc_domain_type domains[] = {
+		MSM_VIDC_ENCODER, MSM_VIDC_DECODER,
+	};
+	struct vidc_driver_test *t = test->priv;
+	struct msm_vidc_timestamps *ts = &t->inst->timestamps;
+	u32 d, n, r, window;
+	u64 *arrivals, base;
+
+	arrivals = kunit_kzalloc(test, VIDC_DRIVER_TEST_STEPS * sizeof(*arrivals),
+		GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, arrivals);
+
+	for (d = 0; d < ARRAY_SIZE(domains); d++) {
+		t->inst->domain = domains[d];
+		window = is_encode_session(t->inst) ?
+			ENC_FPS_WINDOW : DEC_FPS_WINDOW;
+		msm_vidc_flush_ts(t->inst);
+
+		for (n = 0; n < VIDC_DRIVER_TEST_STEPS; n++) {
+			r = vidc_driver_test_rand(t);
+			base = (u64)n * VIDC_DRIVER_TEST_30FPS;
+			if (n && !(r % 7))
+				/* repeat the previous timestamp */
+				arrivals[n] = arrivals[n - 1];
+			else if (!(r % 5))
+				/* late by up to two frames */
+				arrivals[n] = base - min_t(u64, base,
+					(r >> 4) % 3 * VIDC_DRIVER_TEST_30FPS);
+			else
+				arrivals[n] = base + (r >> 4) % 2000;
+
+			KUNIT_ASSERT_EQ(test, msm_vidc_update_timestamp(t->inst,
+				arrivals[n]), 0);
+			vidc_driver_test_check_window(test, ts, arrivals, n + 1,
+				window);
+		}
+	}
+}
+
+/*
+ * Encoder auto framerate runs only with the core capability set, and
+ * reports nothing to firmware before a window rate was seen twice.
+ */
+static void vidc_driver_test_ts_auto_framerate(struct kunit *test)
+{
+	struct vidc_driver_test *t = test->priv;
+	u32 i;
+
+	t->inst->capabilities->cap[FRAME_RATE].max = 60 << 16;
+	for (i = 0; i < ENC_FPS_WINDOW; i++)
+		KUNIT_EXPECT_EQ(test, msm_vidc_set_auto_framerate(t->inst,
+			(u64)i * VIDC_DRIVER_TEST_30FPS), 0);
+	KUNIT_EXPECT_EQ(test, t->inst->timestamps.count, 0);
+
+	t->caps[ENC_AUTO_FRAMERATE].value = 1;
+	for (i = 0; i < ENC_FPS_WINDOW; i++)
+		KUNIT_EXPECT_EQ(test, msm_vidc_set_auto_framerate(t->inst,
+			(u64)i * VIDC_DRIVER_TEST_30FPS), 0);
+	KUNIT_EXPECT_EQ(test, t->inst->timestamps.count, ENC_FPS_WINDOW);
+	KUNIT_EXPECT_EQ(test, t->inst->timestamps.prev_auto_fps, 30 << 16);
+	KUNIT_EXPECT_EQ(test, t->inst->auto_framerate, 0);
+}
+
+static struct kunit_case msm_vidc_driver_dmabuf_test_cases[] = {
+	KUNIT_CASE(vidc_driver_test_dmabuf_get_put),
+	KUNIT_CASE(vidc_driver_test_dmabuf_churn),
+	KUNIT_CASE(vidc_driver_test_dmabuf_release),
+	KUNIT_CASE(vidc_driver_test_map_unmap),
+	KUNIT_CASE(vidc_driver_test_map_types),
+	KUNIT_CASE(vidc_driver_test_map_delayed_unmap),
+	KUNIT_CASE(vidc_driver_test_map_churn),
+	{}
+};
+
+static struct kunit_suite msm_vidc_driver_dmabuf_test_suite = {
+	.name = "msm_vidc_driver_dmabuf",
+	.init = vidc_driver_test_init,
+	.exit = vidc_driver_test_exit,
+	.test_cases = msm_vidc_driver_dmabuf_test_cases,
+};
+
+static struct kunit_case msm_vidc_driver_timestamp_test_cases[] = {
+	KUNIT_CASE(vidc_driver_test_ts_bframes),
+	KUNIT_CASE(vidc_driver_test_ts_duplicates),
+	KUNIT_CASE(vidc_driver_test_ts_eviction),
+	KUNIT_CASE(vidc_driver_test_ts_random),
+	KUNIT_CASE(vidc_driver_test_ts_auto_framerate),
+	{}
+};
+
+static struct kunit_suite msm_vidc_driver_timestamp_test_suite = {
+	.name = "msm_vidc_driver_timestamp",
+	.init = vidc_driver_test_init,
+	.exit = vidc_driver_test_exit,
+	.test_cases = msm_vidc_driver_timestamp_test_cases,
+};
+
+kunit_test_suites(&msm_vidc_driver_dmabuf_test_suite,
+		  &msm_vidc_driver_timestamp_test_suite);
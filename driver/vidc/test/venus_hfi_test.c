@@ -0,0 +1,691 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Copyright (c) 2021, The Linux Foundation. All rights reserved.
+ */
+
+/*
+ * KUnit tests for cmdq producers in venus_hfi.c. Included at the end of
+ * venus_hfi.c so the static helpers are reachable. The core is a stand
+ * in: cmdq lives in plain memory, venus_ops count doorbells and a
+ * firmware stand-in drains and checks what the driver wrote.
+ */
+
+#include <kunit/test.h>
+
+#define VIDC_HFI_TEST_CMDQ_SIZE		(64 * 1024)
+#define VIDC_HFI_TEST_PACKET_SIZE	4096
+#define VIDC_HFI_TEST_SESSION_ID	0x1234
+#define VIDC_HFI_TEST_MAX_INSTS		4
+
+/* size one buffer packet takes in a header */
+#define VIDC_HFI_TEST_BUF_PKT_SIZE \
+	(sizeof(struct hfi_packet) + sizeof(struct hfi_buffer))
+
+struct vidc_hfi_test {
+	struct msm_vidc_core core;
+	struct msm_vidc_venus_ops venus_ops;
+	struct msm_vidc_core_capability caps[CORE_CAP_MAX + 1];
+	struct hfi_queue_header cmdq_hdr;
+	struct msm_vidc_dt dt;
+	struct msm_vidc_inst *insts[VIDC_HFI_TEST_MAX_INSTS];
+	struct msm_vidc_inst *inst;
+	u32 num_insts;
+	u8 *cmdq;
+	atomic_t doorbells;
+
+	/* power stand-in state */
+	bool hw_on;
+	int prepare_pc_rc;
+	atomic_t prepare_pc_calls;
+	atomic_t prepare_pc_fastpath;
+	atomic_t off_doorbells;
+	atomic_t off_writes;
+
+	/* firmware stand-in state */
+	u8 *fw_pkt;
+	u32 headers;
+	u32 packets;
+	u32 last_header_id;
+	u32 last_packet_id;
+	u32 next_index[VIDC_HFI_TEST_MAX_INSTS];
+	u32 max_hdr_size;
+	u32 hdr_packets[64];
+};
+
+static struct vidc_hfi_test *to_vidc_hfi_test(struct msm_vidc_core *core)
+{
+	return container_of(core, struct vidc_hfi_test, core);
+}
+
+static int vidc_hfi_test_raise_interrupt(struct msm_vidc_core *core)
+{
+	struct vidc_hfi_test *t = to_vidc_hfi_test(core);
+
+	atomic_inc(&t->doorbells);
+	if (!READ_ONCE(t->hw_on))
+		atomic_inc(&t->off_doorbells);
+	return 0;
+}
+
+static u32 vidc_hfi_test_write_idx(struct vidc_hfi_test *t)
+{
+	return READ_ONCE(t->cmdq_hdr.qhdr_write_idx);
+}
+
+/*
+ * Stands in for SYS_PC_PREP. Session producers must be parked on
+ * core->lock by now, so cmdq may not move while firmware "prepares".
+ */
+static int vidc_hfi_test_prepare_pc(struct msm_vidc_core *core)
+{
+	struct vidc_hfi_test *t = to_vidc_hfi_test(core);
+	u32 write_idx = vidc_hfi_test_write_idx(t);
+
+	atomic_inc(&t->prepare_pc_calls);
+	if (!READ_ONCE(core->cmdq_fastpath))
+		atomic_inc(&t->prepare_pc_fastpath);
+	usleep_range(100, 200);
+	if (vidc_hfi_test_write_idx(t) != write_idx)
+		atomic_inc(&t->off_writes);
+
+	return t->prepare_pc_rc;
+}
+
+static int vidc_hfi_test_power_on(struct msm_vidc_core *core)
+{
+	WRITE_ONCE(to_vidc_hfi_test(core)->hw_on, true);
+	return 0;
+}
+
+static int vidc_hfi_test_power_off(struct msm_vidc_core *core)
+{
+	WRITE_ONCE(to_vidc_hfi_test(core)->hw_on, false);
+	return 0;
+}
+
+static struct msm_vidc_inst *vidc_hfi_test_add_inst(struct kunit *test)
+{
+	struct vidc_hfi_test *t = test->priv;
+	struct msm_vidc_inst *inst;
+
+	KUNIT_ASSERT_LT(test, t->num_insts, VIDC_HFI_TEST_MAX_INSTS);
+	inst = kunit_kzalloc(test, sizeof(*inst), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, inst);
+	inst->core = &t->core;
+	inst->domain = MSM_VIDC_DECODER;
+	inst->session_id = VIDC_HFI_TEST_SESSION_ID + t->num_insts;
+	inst->packet_size = VIDC_HFI_TEST_PACKET_SIZE;
+	inst->packet = kunit_kzalloc(test, inst->packet_size, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, inst->packet);
+
+	core_lock(&t->core, __func__);
+	list_add_tail(&inst->list, &t->core.instances);
+	core_unlock(&t->core, __func__);
+	t->insts[t->num_insts++] = inst;
+
+	return inst;
+}
+
+static int vidc_hfi_test_init(struct kunit *test)
+{
+	struct vidc_hfi_test *t;
+	struct msm_vidc_core *core;
+	struct msm_vidc_iface_q_info *q_info;
+
+	t = kunit_kzalloc(test, sizeof(*t), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, t);
+	core = &t->core;
+
+	t->cmdq = kunit_kzalloc(test, VIDC_HFI_TEST_CMDQ_SIZE, GFP_KERNEL);
+	t->fw_pkt = kunit_kzalloc(test, VIDC_HFI_TEST_PACKET_SIZE, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, t->cmdq);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, t->fw_pkt);
+
+	t->venus_ops.raise_interrupt = vidc_hfi_test_raise_interrupt;
+	t->venus_ops.prepare_pc = vidc_hfi_test_prepare_pc;
+	t->venus_ops.power_on = vidc_hfi_test_power_on;
+	t->venus_ops.power_off = vidc_hfi_test_power_off;
+	t->hw_on = true;
+	t->caps[HW_RESPONSE_TIMEOUT].value = HW_RESPONSE_TIMEOUT_VALUE;
+	t->caps[SW_PC].value = 0;
+
+	mutex_init(&core->lock);
+	mutex_init(&core->cmdq_lock);
+	mutex_init(&core->fw_log.lock);
+	INIT_LIST_HEAD(&core->instances);
+	core->state = MSM_VIDC_CORE_INIT;
+	core->dt = &t->dt;
+	core->capabilities = t->caps;
+	core->venus_ops = &t->venus_ops;
+	core->power_enabled = true;
+	core->cmdq_fastpath = true;
+	core->packet_size = VIDC_HFI_TEST_PACKET_SIZE;
+	core->packet = kunit_kzalloc(test, core->packet_size, GFP_KERNEL);
+	core->fw_log.packet = kunit_kzalloc(test, core->packet_size, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, core->packet);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, core->fw_log.packet);
+
+	core->cmdq_pending.slot_size = core->packet_size;
+	core->cmdq_pending.num_slots = CMDQ_PENDING_SLOTS;
+	core->cmdq_pending.slots = kunit_kzalloc(test,
+		core->cmdq_pending.num_slots * core->cmdq_pending.slot_size,
+		GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, core->cmdq_pending.slots);
+	init_waitqueue_head(&core->cmdq_pending.wait);
+
+	q_info = &core->iface_queues[VIDC_IFACEQ_CMDQ_IDX];
+	q_info->q_hdr = &t->cmdq_hdr;
+	q_info->q_array.align_virtual_addr = t->cmdq;
+	q_info->q_array.mem_size = VIDC_HFI_TEST_CMDQ_SIZE;
+
+	/* header and packet ids start at 0 on the core */
+	t->last_header_id = (u32)-1;
+	t->last_packet_id = (u32)-1;
+	test->priv = t;
+	t->inst = vidc_hfi_test_add_inst(test);
+
+	return 0;
+}
+
+/*
+ * Firmware stand-in: pops one header from cmdq into t->fw_pkt, returns
+ * its size in bytes or 0 if cmdq is empty. Safe against a concurrent
+ * producer, write_idx is published after the header is copied.
+ */
+static u32 vidc_hfi_test_fw_pop(struct vidc_hfi_test *t)
+{
+	struct hfi_queue_header *q = &t->cmdq_hdr;
+	u32 q_words = VIDC_HFI_TEST_CMDQ_SIZE >> 2;
+	u32 *ring = (u32 *)t->cmdq;
+	u32 *pkt = (u32 *)t->fw_pkt;
+	u32 read_idx, write_idx, words, i;
+
+	read_idx = READ_ONCE(q->qhdr_read_idx);
+	write_idx = READ_ONCE(q->qhdr_write_idx);
+	smp_rmb();
+	if (read_idx == write_idx)
+		return 0;
+
+	words = ring[read_idx] >> 2;
+	if (!words || words > VIDC_HFI_TEST_PACKET_SIZE >> 2)
+		return (u32)-1;
+	for (i = 0; i < words; i++)
+		pkt[i] = ring[(read_idx + i) % q_words];
+
+	smp_mb();
+	WRITE_ONCE(q->qhdr_read_idx, (read_idx + words) % q_words);
+
+	return words << 2;
+}
+
+/*
+ * Drains cmdq and checks every header: session id, size bound, packets
+ * adding up to the header size, header and packet ids consecutive and
+ * hfi_buffer indices in queueing order per session.
+ */
+static void vidc_hfi_test_fw_drain(struct kunit *test)
+{
+	struct vidc_hfi_test *t = test->priv;
+	struct hfi_header *hdr = (struct hfi_header *)t->fw_pkt;
+	struct hfi_packet *pkt;
+	struct hfi_buffer *buf;
+	u32 size, offset, session, i;
+
+	while ((size = vidc_hfi_test_fw_pop(t))) {
+		KUNIT_ASSERT_NE(test, size, (u32)-1);
+		session = hdr->session_id - VIDC_HFI_TEST_SESSION_ID;
+		KUNIT_ASSERT_LT(test, session, t->num_insts);
+		KUNIT_EXPECT_LE(test, hdr->size, t->insts[session]->packet_size);
+		KUNIT_EXPECT_EQ(test, hdr->header_id, t->last_header_id + 1);
+		t->last_header_id = hdr->header_id;
+		t->max_hdr_size = max(t->max_hdr_size, hdr->size);
+		if (t->headers < ARRAY_SIZE(t->hdr_packets))
+			t->hdr_packets[t->headers] = hdr->num_packets;
+		t->headers++;
+
+		offset = sizeof(struct hfi_header);
+		for (i = 0; i < hdr->num_packets; i++) {
+			pkt = (struct hfi_packet *)(t->fw_pkt + offset);
+			KUNIT_ASSERT_GE(test, pkt->size,
+				(u32)sizeof(struct hfi_packet));
+			KUNIT_EXPECT_EQ(test, pkt->packet_id,
+				t->last_packet_id + 1);
+			t->last_packet_id = pkt->packet_id;
+			if (pkt->type == HFI_CMD_BUFFER) {
+				buf = (struct hfi_buffer *)(pkt + 1);
+				KUNIT_EXPECT_EQ(test, buf->index,
+					t->next_index[session]);
+				t->next_index[session] = buf->index + 1;
+			}
+			offset += pkt->size;
+			t->packets++;
+		}
+		KUNIT_EXPECT_EQ(test, offset, hdr->size);
+	}
+}
+
+static void vidc_hfi_test_buffer(struct msm_vidc_buffer *buf,
+	enum msm_vidc_buffer_type type, u32 index)
+{
+	memset(buf, 0, sizeof(*buf));
+	buf->type = type;
+	buf->index = index;
+	buf->device_addr = 0x100000 + index * 0x1000;
+	buf->buffer_size = 0x1000;
+	buf->data_size = 0x800;
+}
+
+static int vidc_hfi_test_queue(struct msm_vidc_inst *inst, u32 index,
+	bool meta)
+{
+	struct msm_vidc_buffer buf, metabuf;
+
+	vidc_hfi_test_buffer(&buf, MSM_VIDC_BUF_INPUT, index);
+	vidc_hfi_test_buffer(&metabuf, MSM_VIDC_BUF_INPUT_META, index + 1);
+
+	return venus_hfi_queue_buffer(inst, &buf, meta ? &metabuf : NULL);
+}
+
+/* a batch that fits one header is written once with one doorbell */
+static void vidc_hfi_test_batch_single_header(struct kunit *test)
+{
+	struct vidc_hfi_test *t = test->priv;
+	u32 i;
+
+	KUNIT_ASSERT_EQ(test, venus_hfi_batch_begin(t->inst), 0);
+	for (i = 0; i < 8; i++)
+		KUNIT_ASSERT_EQ(test, vidc_hfi_test_queue(t->inst, i, false), 0);
+
+	/* nothing reaches cmdq before the batch ends */
+	KUNIT_EXPECT_EQ(test, t->cmdq_hdr.qhdr_write_idx, 0);
+	KUNIT_EXPECT_EQ(test, atomic_read(&t->doorbells), 0);
+
+	KUNIT_EXPECT_EQ(test, venus_hfi_batch_end(t->inst, 0), 0);
+	KUNIT_EXPECT_FALSE(test, t->inst->cmd_batch.enable);
+
+	vidc_hfi_test_fw_drain(test);
+	KUNIT_EXPECT_EQ(test, t->headers, 1);
+	KUNIT_EXPECT_EQ(test, t->packets, 8);
+	KUNIT_EXPECT_EQ(test, atomic_read(&t->doorbells), 1);
+}
+
+/*
+ * Packets beyond inst->packet_size start a new header: each full header
+ * is written without a doorbell and the last one rings it once.
+ */
+static void vidc_hfi_test_batch_header_overflow(struct kunit *test)
+{
+	struct vidc_hfi_test *t = test->priv;
+	u32 i;
+
+	/* room for three buffer packets per header */
+	t->inst->packet_size = sizeof(struct hfi_header) +
+		3 * VIDC_HFI_TEST_BUF_PKT_SIZE;
+
+	KUNIT_ASSERT_EQ(test, venus_hfi_batch_begin(t->inst), 0);
+	for (i = 0; i < 10; i++)
+		KUNIT_ASSERT_EQ(test, vidc_hfi_test_queue(t->inst, i, false), 0);
+
+	/* three full headers are already in cmdq, none signalled */
+	KUNIT_EXPECT_NE(test, t->cmdq_hdr.qhdr_write_idx, 0);
+	KUNIT_EXPECT_EQ(test, atomic_read(&t->doorbells), 0);
+
+	KUNIT_EXPECT_EQ(test, venus_hfi_batch_end(t->inst, 0), 0);
+
+	vidc_hfi_test_fw_drain(test);
+	KUNIT_EXPECT_EQ(test, t->headers, 4);
+	KUNIT_EXPECT_EQ(test, t->packets, 10);
+	KUNIT_EXPECT_EQ(test, t->hdr_packets[0], 3);
+	KUNIT_EXPECT_EQ(test, t->hdr_packets[3], 1);
+	KUNIT_EXPECT_EQ(test, t->max_hdr_size, t->inst->packet_size);
+	KUNIT_EXPECT_EQ(test, atomic_read(&t->doorbells), 1);
+}
+
+/* a buffer and its metadata are never split across two headers */
+static void vidc_hfi_test_batch_meta_pair(struct kunit *test)
+{
+	struct vidc_hfi_test *t = test->priv;
+
+	t->inst->packet_size = sizeof(struct hfi_header) +
+		3 * VIDC_HFI_TEST_BUF_PKT_SIZE;
+
+	KUNIT_ASSERT_EQ(test, venus_hfi_batch_begin(t->inst), 0);
+	KUNIT_ASSERT_EQ(test, vidc_hfi_test_queue(t->inst, 0, false), 0);
+	KUNIT_ASSERT_EQ(test, vidc_hfi_test_queue(t->inst, 1, false), 0);
+	/* one slot left, the pair goes to the next header */
+	KUNIT_ASSERT_EQ(test, vidc_hfi_test_queue(t->inst, 2, true), 0);
+	KUNIT_EXPECT_EQ(test, venus_hfi_batch_end(t->inst, 0), 0);
+
+	vidc_hfi_test_fw_drain(test);
+	KUNIT_EXPECT_EQ(test, t->headers, 2);
+	KUNIT_EXPECT_EQ(test, t->hdr_packets[0], 2);
+	KUNIT_EXPECT_EQ(test, t->hdr_packets[1], 2);
+	KUNIT_EXPECT_EQ(test, t->packets, 4);
+}
+
+/* packets queued before the caller failed are flushed, caller_rc wins */
+static void vidc_hfi_test_batch_end_caller_rc(struct kunit *test)
+{
+	struct vidc_hfi_test *t = test->priv;
+
+	KUNIT_ASSERT_EQ(test, venus_hfi_batch_begin(t->inst), 0);
+	KUNIT_ASSERT_EQ(test, vidc_hfi_test_queue(t->inst, 0, false), 0);
+	KUNIT_ASSERT_EQ(test, vidc_hfi_test_queue(t->inst, 1, false), 0);
+	KUNIT_EXPECT_EQ(test, venus_hfi_batch_end(t->inst, -ENOMEM), -ENOMEM);
+	KUNIT_EXPECT_FALSE(test, t->inst->cmd_batch.enable);
+	KUNIT_EXPECT_EQ(test, t->inst->cmd_batch.num_packets, 0);
+
+	vidc_hfi_test_fw_drain(test);
+	KUNIT_EXPECT_EQ(test, t->packets, 2);
+	KUNIT_EXPECT_EQ(test, atomic_read(&t->doorbells), 1);
+
+	/* the next batch starts clean */
+	KUNIT_ASSERT_EQ(test, venus_hfi_batch_begin(t->inst), 0);
+	KUNIT_ASSERT_EQ(test, vidc_hfi_test_queue(t->inst, 2, false), 0);
+	KUNIT_EXPECT_EQ(test, venus_hfi_batch_end(t->inst, 0), 0);
+	vidc_hfi_test_fw_drain(test);
+	KUNIT_EXPECT_EQ(test, t->headers, 2);
+	KUNIT_EXPECT_EQ(test, t->packets, 3);
+}
+
+/* a failed flush is returned unless the caller already failed */
+static void vidc_hfi_test_batch_end_flush_error(struct kunit *test)
+{
+	struct vidc_hfi_test *t = test->priv;
+
+	KUNIT_ASSERT_EQ(test, venus_hfi_batch_begin(t->inst), 0);
+	KUNIT_ASSERT_EQ(test, vidc_hfi_test_queue(t->inst, 0, false), 0);
+	t->core.state = MSM_VIDC_CORE_DEINIT;
+	KUNIT_EXPECT_EQ(test, venus_hfi_batch_end(t->inst, 0), -EINVAL);
+	KUNIT_EXPECT_FALSE(test, t->inst->cmd_batch.enable);
+
+	t->core.state = MSM_VIDC_CORE_INIT;
+	KUNIT_ASSERT_EQ(test, venus_hfi_batch_begin(t->inst), 0);
+	KUNIT_ASSERT_EQ(test, vidc_hfi_test_queue(t->inst, 0, false), 0);
+	t->core.state = MSM_VIDC_CORE_DEINIT;
+	KUNIT_EXPECT_EQ(test, venus_hfi_batch_end(t->inst, -EBUSY), -EBUSY);
+
+	t->core.state = MSM_VIDC_CORE_INIT;
+	vidc_hfi_test_fw_drain(test);
+	KUNIT_EXPECT_EQ(test, t->headers, 0);
+	KUNIT_EXPECT_EQ(test, atomic_read(&t->doorbells), 0);
+}
+
+/* an empty batch touches neither cmdq nor the doorbell */
+static void vidc_hfi_test_batch_end_empty(struct kunit *test)
+{
+	struct vidc_hfi_test *t = test->priv;
+
+	KUNIT_ASSERT_EQ(test, venus_hfi_batch_begin(t->inst), 0);
+	KUNIT_EXPECT_EQ(test, venus_hfi_batch_begin(t->inst), -EINVAL);
+	KUNIT_EXPECT_EQ(test, venus_hfi_batch_end(t->inst, 0), 0);
+	KUNIT_EXPECT_EQ(test, venus_hfi_batch_end(t->inst, -EIO), -EIO);
+
+	KUNIT_EXPECT_EQ(test, t->cmdq_hdr.qhdr_write_idx, 0);
+	KUNIT_EXPECT_EQ(test, atomic_read(&t->doorbells), 0);
+}
+
+/*
+ * __power_collapse turns the fastpath off before asking firmware to
+ * prepare, and turns it back on when power collapse is skipped.
+ */
+static void vidc_hfi_test_fastpath_collapse_skip(struct kunit *test)
+{
+	struct vidc_hfi_test *t = test->priv;
+	struct msm_vidc_core *core = &t->core;
+
+	t->prepare_pc_rc = -EBUSY;
+	core_lock(core, __func__);
+	KUNIT_EXPECT_EQ(test, __power_collapse(core, false), -EAGAIN);
+	core_unlock(core, __func__);
+
+	KUNIT_EXPECT_EQ(test, atomic_read(&t->prepare_pc_calls), 1);
+	KUNIT_EXPECT_EQ(test, atomic_read(&t->prepare_pc_fastpath), 1);
+	KUNIT_EXPECT_TRUE(test, core->cmdq_fastpath);
+	KUNIT_EXPECT_TRUE(test, core->power_enabled);
+
+	/* packets waiting for cmdq space hold power collapse off */
+	core->cmdq_pending.count = 1;
+	core_lock(core, __func__);
+	KUNIT_EXPECT_EQ(test, __power_collapse(core, false), -EAGAIN);
+	core_unlock(core, __func__);
+	core->cmdq_pending.count = 0;
+
+	KUNIT_EXPECT_EQ(test, atomic_read(&t->prepare_pc_calls), 1);
+	KUNIT_EXPECT_TRUE(test, core->cmdq_fastpath);
+}
+
+struct vidc_hfi_test_producer {
+	struct vidc_hfi_test *t;
+	struct msm_vidc_inst *inst;
+	u32 count;
+	u32 queued;
+	int rc;
+	bool done;
+};
+
+/*
+ * Queues count buffers, every other group of four as one batch, then
+ * idles until stopped.
+ */
+static int vidc_hfi_test_producer_fn(void *data)
+{
+	struct vidc_hfi_test_producer *p = data;
+	bool batch;
+	int rc = 0;
+	u32 i;
+
+	for (i = 0; i < p->count && !rc; i++) {
+		batch = (i / 4) & 1;
+		if (batch && !(i % 4))
+			rc = venus_hfi_batch_begin(p->inst);
+		if (!rc)
+			rc = vidc_hfi_test_queue(p->inst, i, false);
+		if (batch && (i % 4 == 3 || rc || i == p->count - 1))
+			rc = venus_hfi_batch_end(p->inst, rc);
+		if (!rc)
+			WRITE_ONCE(p->queued, i + 1);
+	}
+	p->rc = rc;
+	WRITE_ONCE(p->done, true);
+
+	while (!kthread_should_stop())
+		usleep_range(100, 200);
+
+	return 0;
+}
+
+/* the isr path: resumed core, pending packets pushed into cmdq */
+static void vidc_hfi_test_isr_drain(struct vidc_hfi_test *t)
+{
+	struct msm_vidc_core *core = &t->core;
+
+	core_lock(core, __func__);
+	if (core->power_enabled)
+		__cmdq_pending_drain(core);
+	core_unlock(core, __func__);
+}
+
+/* a producer arriving while the core is off waits for power on */
+static void vidc_hfi_test_fastpath_power_off_blocks(struct kunit *test)
+{
+	struct vidc_hfi_test *t = test->priv;
+	struct msm_vidc_core *core = &t->core;
+	struct vidc_hfi_test_producer p = {
+		.t = t, .inst = t->inst, .count = 1,
+	};
+	struct task_struct *task;
+
+	core_lock(core, __func__);
+	KUNIT_ASSERT_EQ(test, __venus_power_off(core), 0);
+	KUNIT_EXPECT_FALSE(test, core->cmdq_fastpath);
+
+	task = kthread_run(vidc_hfi_test_producer_fn, &p, "vidc_hfi_test");
+	if (IS_ERR(task)) {
+		core_unlock(core, __func__);
+		KUNIT_FAIL(test, "kthread_run failed");
+		return;
+	}
+	msleep(20);
+	KUNIT_EXPECT_FALSE(test, READ_ONCE(p.done));
+	KUNIT_EXPECT_EQ(test, vidc_hfi_test_write_idx(t), 0);
+
+	/* the same steps as __resume, without the secure world call */
+	KUNIT_EXPECT_EQ(test, __venus_power_on(core), 0);
+	__cmdq_set_fastpath(core, true);
+	core_unlock(core, __func__);
+
+	while (!READ_ONCE(p.done))
+		usleep_range(100, 200);
+	kthread_stop(task);
+
+	KUNIT_EXPECT_EQ(test, p.rc, 0);
+	vidc_hfi_test_fw_drain(test);
+	KUNIT_EXPECT_EQ(test, t->packets, 1);
+	KUNIT_EXPECT_EQ(test, atomic_read(&t->doorbells), 1);
+	KUNIT_EXPECT_EQ(test, atomic_read(&t->off_doorbells), 0);
+}
+
+#define VIDC_HFI_TEST_STRESS_BUFFERS	20000
+
+struct vidc_hfi_test_power {
+	struct vidc_hfi_test *t;
+	u32 collapses;
+	u32 power_cycles;
+	u32 bad_collapses;
+};
+
+/*
+ * Flips the core between the two ways session producers lose the
+ * fastpath: a power collapse that firmware refuses, and a full power
+ * off/on cycle. cmdq must not move while the core is off.
+ */
+static int vidc_hfi_test_power_fn(void *data)
+{
+	struct vidc_hfi_test_power *pw = data;
+	struct vidc_hfi_test *t = pw->t;
+	struct msm_vidc_core *core = &t->core;
+	u32 write_idx;
+
+	while (!kthread_should_stop()) {
+		core_lock(core, __func__);
+		if (__power_collapse(core, false) != -EAGAIN ||
+			!core->cmdq_fastpath)
+			pw->bad_collapses++;
+		pw->collapses++;
+		core_unlock(core, __func__);
+		cond_resched();
+
+		core_lock(core, __func__);
+		__venus_power_off(core);
+		write_idx = vidc_hfi_test_write_idx(t);
+		usleep_range(100, 200);
+		if (vidc_hfi_test_write_idx(t) != write_idx)
+			atomic_inc(&t->off_writes);
+		__venus_power_on(core);
+		__cmdq_set_fastpath(core, true);
+		pw->power_cycles++;
+		core_unlock(core, __func__);
+		cond_resched();
+	}
+
+	return 0;
+}
+
+/*
+ * Producers on several sessions race power collapse. Every packet must
+ * reach cmdq exactly once, in order, and never while the core is off.
+ */
+static void vidc_hfi_test_fastpath_stress(struct kunit *test)
+{
+	struct vidc_hfi_test *t = test->priv;
+	struct vidc_hfi_test_producer p[VIDC_HFI_TEST_MAX_INSTS];
+	struct task_struct *tasks[VIDC_HFI_TEST_MAX_INSTS];
+	struct vidc_hfi_test_power pw = { .t = t };
+	struct task_struct *power;
+	u32 i, done, total = 0;
+
+	t->prepare_pc_rc = -EBUSY;
+	while (t->num_insts < VIDC_HFI_TEST_MAX_INSTS)
+		vidc_hfi_test_add_inst(test);
+
+	power = kthread_run(vidc_hfi_test_power_fn, &pw, "vidc_hfi_test_pc");
+	KUNIT_ASSERT_FALSE(test, IS_ERR(power));
+	for (i = 0; i < t->num_insts; i++) {
+		p[i] = (struct vidc_hfi_test_producer) {
+			.t = t, .inst = t->insts[i],
+			.count = VIDC_HFI_TEST_STRESS_BUFFERS,
+		};
+		tasks[i] = kthread_run(vidc_hfi_test_producer_fn, &p[i],
+			"vidc_hfi_test_%u", i);
+		KUNIT_ASSERT_FALSE(test, IS_ERR(tasks[i]));
+	}
+
+	do {
+		vidc_hfi_test_fw_drain(test);
+		vidc_hfi_test_isr_drain(t);
+		for (i = 0, done = 0; i < t->num_insts; i++)
+			done += READ_ONCE(p[i].done);
+		cond_resched();
+	} while (done < t->num_insts);
+
+	kthread_stop(power);
+	for (i = 0; i < t->num_insts; i++)
+		kthread_stop(tasks[i]);
+
+	/* whatever is still waiting for cmdq space */
+	do {
+		vidc_hfi_test_isr_drain(t);
+		vidc_hfi_test_fw_drain(test);
+	} while (t->core.cmdq_pending.count);
+
+	for (i = 0; i < t->num_insts; i++) {
+		KUNIT_EXPECT_EQ(test, p[i].rc, 0);
+		KUNIT_EXPECT_EQ(test, t->next_index[i], p[i].queued);
+		total += p[i].queued;
+	}
+	KUNIT_EXPECT_EQ(test, t->packets, total);
+	KUNIT_EXPECT_EQ(test, total,
+		t->num_insts * VIDC_HFI_TEST_STRESS_BUFFERS);
+	KUNIT_EXPECT_EQ(test, atomic_read(&t->off_writes), 0);
+	KUNIT_EXPECT_EQ(test, atomic_read(&t->off_doorbells), 0);
+	KUNIT_EXPECT_EQ(test, pw.bad_collapses, 0);
+	KUNIT_EXPECT_EQ(test, atomic_read(&t->prepare_pc_fastpath),
+		atomic_read(&t->prepare_pc_calls));
+	KUNIT_EXPECT_GT(test, pw.collapses, 0);
+	KUNIT_EXPECT_GT(test, pw.power_cycles, 0);
+	kunit_info(test, "%u headers, %u collapses, %u power cycles\n",
+		t->headers, pw.collapses, pw.power_cycles);
+}
+
+static struct kunit_case venus_hfi_batch_test_cases[] = {
+	KUNIT_CASE(vidc_hfi_test_batch_single_header),
+	KUNIT_CASE(vidc_hfi_test_batch_header_overflow),
+	KUNIT_CASE(vidc_hfi_test_batch_meta_pair),
+	KUNIT_CASE(vidc_hfi_test_batch_end_caller_rc),
+	KUNIT_CASE(vidc_hfi_test_batch_end_flush_error),
+	KUNIT_CASE(vidc_hfi_test_batch_end_empty),
+	{}
+};
+
+static struct kunit_suite venus_hfi_batch_test_suite = {
+	.name = "msm_vidc_venus_hfi_batch",
+	.init = vidc_hfi_test_init,
+	.test_cases = venus_hfi_batch_test_cases,
+};
+
+static struct kunit_case venus_hfi_fastpath_test_cases[] = {
+	KUNIT_CASE(vidc_hfi_test_fastpath_collapse_skip),
+	KUNIT_CASE(vidc_hfi_test_fastpath_power_off_blocks),
+	KUNIT_CASE(vidc_hfi_test_fastpath_stress),
+	{}
+};
+
+static struct kunit_suite venus_hfi_fastpath_test_suite = {
+	.name = "msm_vidc_venus_hfi_fastpath",
+	.init = vidc_hfi_test_init,
+	.test_cases = venus_hfi_fastpath_test_cases,
+};
+
+kunit_test_suites(&venus_hfi_batch_test_suite,
+		  &venus_hfi_fastpath_test_suite);
@@ -0,0 +1,441 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Copyright (c) 2021, The Linux Foundation. All rights reserved.
+ */
+
+/*
+ * Replays per frame decode cost traces through the clock scaling of
+ * msm_vidc_power.c and reports, per DCVS policy, an energy proxy and the
+ * number of frames that missed their display deadline.
+ *
+ * The driver code runs unmodified on a simulated clock. A decode session
+ * with actual_count output buffers is played back: firmware decodes
+ * frames in order into queued output buffers at the voted core clock,
+ * the client starts display after a preroll and shows frame k at its
+ * timestamp, and returns the buffer it displayed before. Every input and
+ * output qbuf goes through msm_vidc_scale_clocks() as in the driver, and
+ * every output buffer done through msm_vidc_update_timestamp() and
+ * msm_vidc_dcvs_frame_done().
+ *
+ * Energy is sum(cycles * (f / f_max)^2), dynamic power with voltage
+ * scaling along with frequency, normalized to decoding everything at
+ * f_max. Idle time is taken to be power collapsed and costs nothing.
+ *
+ * A trace is a csv file:
+ *   # comment
+ *   session,decode,<fps>,<model cycles/frame>,<min_count>,<actual_count>
+ *   <timestamp us>,<cycles>		one line per frame, display order
+ *
+ *   dcvs_replay [trace.csv ...]
+ *   dcvs_replay -g steady|scene|burst	print a synthesized trace
+ */
+
+static u64 replay_now_ns(void);
+
+/* the power code under test runs on the simulated clock and buffers */
+#undef ktime_get_ns
+#define ktime_get_ns()			replay_now_ns()
+#define venus_hfi_scale_clocks		replay_scale_clocks
+#define msm_vidc_num_buffers		replay_num_buffers
+
+#include "../driver/vidc/src/msm_vidc_power.c"
+
+#define REPLAY_MAX_FRAMES	65536
+#define REPLAY_PREROLL		3
+#define REPLAY_INPUT_DEPTH	4
+#define REPLAY_SESSION_ID	0x5e55
+
+static const struct allowed_clock_rates_table replay_clks[] = {
+	{ 444000000 }, { 366000000 }, { 338000000 }, { 239999999 },
+};
+
+struct replay_trace {
+	u32 fps;
+	u64 model_cycles;
+	u32 min_count;
+	u32 actual_count;
+	u64 ts_us[REPLAY_MAX_FRAMES];
+	u64 cycles[REPLAY_MAX_FRAMES];
+	u32 num_frames;
+};
+
+struct replay_result {
+	double energy;
+	u32 misses;
+	u64 worst_late_ns;
+	double avg_mhz;
+	u64 votes;
+	u64 suppressed;
+};
+
+enum replay_policy {
+	REPLAY_TURBO,
+	REPLAY_STATIC,
+	REPLAY_THRESHOLD,
+	REPLAY_PREDICTIVE,
+	REPLAY_POLICY_MAX,
+};
+
+static const char * const replay_policy_name[REPLAY_POLICY_MAX] = {
+	[REPLAY_TURBO]      = "turbo",
+	[REPLAY_STATIC]     = "static",
+	[REPLAY_THRESHOLD]  = "threshold",
+	[REPLAY_PREDICTIVE] = "predictive",
+};
+
+static struct replay_trace trace;
+static u64 replay_ns;
+static u64 replay_clk;
+static u32 replay_out_queued;
+
+static u64 replay_now_ns(void)
+{
+	return replay_ns;
+}
+
+int replay_scale_clocks(struct msm_vidc_inst *inst, u64 freq)
+{
+	replay_clk = freq;
+	return 0;
+}
+
+/* only the output buffers with fw are asked for in a decode session */
+int replay_num_buffers(struct msm_vidc_inst *inst,
+	enum msm_vidc_buffer_type type, enum msm_vidc_buffer_attributes attr)
+{
+	return type == MSM_VIDC_BUF_OUTPUT ? replay_out_queued : 0;
+}
+
+static u64 replay_calc_freq(struct msm_vidc_inst *inst, u32 data_size)
+{
+	return trace.model_cycles * trace.fps;
+}
+
+static struct msm_vidc_session_ops replay_session_ops = {
+	.calc_freq = replay_calc_freq,
+};
+
+static int replay_load(const char *path)
+{
+	char line[256];
+	u64 ts, cycles;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -errno;
+	}
+
+	memset(&trace, 0, sizeof(trace));
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		if (!strncmp(line, "session,", 8)) {
+			if (sscanf(line, "session,decode,%u,%llu,%u,%u", &trace.fps,
+				&trace.model_cycles, &trace.min_count,
+				&trace.actual_count) != 4)
+				goto invalid;
+			continue;
+		}
+		if (sscanf(line, "%llu,%llu", &ts, &cycles) != 2)
+			goto invalid;
+		if (trace.num_frames == REPLAY_MAX_FRAMES)
+			break;
+		trace.ts_us[trace.num_frames] = ts;
+		trace.cycles[trace.num_frames] = cycles;
+		trace.num_frames++;
+	}
+	fclose(f);
+
+	if (!trace.fps || !trace.min_count ||
+		trace.actual_count < trace.min_count || !trace.num_frames) {
+		fprintf(stderr, "%s: no session line or frames\n", path);
+		return -EINVAL;
+	}
+
+	return 0;
+
+invalid:
+	fprintf(stderr, "%s: invalid line: %s", path, line);
+	fclose(f);
+	return -EINVAL;
+}
+
+static u32 replay_rand_state = 0x5eed1234;
+
+static u32 replay_rand(void)
+{
+	replay_rand_state = replay_rand_state * 1103515245 + 12345;
+	return replay_rand_state >> 8;
+}
+
+/* uniform in [1 - spread, 1 + spread] */
+static double replay_jitter(double spread)
+{
+	return 1.0 + spread * ((double)(replay_rand() & 0xffff) / 0x8000 - 1.0);
+}
+
+/*
+ * 4K60 decode of about 5M cycles a frame, 300MHz, between the two lower
+ * clock levels. steady stays within 10% of it, scene changes between
+ * segments of 0.7x to 1.4x every few seconds and burst has a 2.5x
+ * intra frame every 30 frames over 0.9x inter frames.
+ */
+static int replay_generate(const char *kind)
+{
+	const u64 model = 5000000;
+	const u32 fps = 60, frames = 1200;
+	double scale = 1.0;
+	u32 k;
+
+	if (strcmp(kind, "steady") && strcmp(kind, "scene") &&
+		strcmp(kind, "burst")) {
+		fprintf(stderr, "unknown trace kind %s\n", kind);
+		return -EINVAL;
+	}
+
+	printf("# synthesized by dcvs_replay -g %s, not a device recording\n",
+		kind);
+	printf("session,decode,%u,%llu,%u,%u\n", fps, model, 4, 8);
+	for (k = 0; k < frames; k++) {
+		if (!strcmp(kind, "steady")) {
+			scale = replay_jitter(0.1);
+		} else if (!strcmp(kind, "scene")) {
+			if (!(k % 180))
+				scale = 0.7 + 0.7 * (replay_rand() % 8) / 7.0;
+		} else {
+			scale = (k % 30) ? 0.9 : 2.5;
+		}
+		printf("%llu,%llu\n", div_u64((u64)k * USEC_PER_SEC, fps),
+			(u64)(model * scale * (strcmp(kind, "steady") ?
+				replay_jitter(0.05) : 1.0)));
+	}
+
+	return 0;
+}
+
+static void replay_qbuf(struct msm_vidc_inst *inst, bool input)
+{
+	if (input)
+		inst->power.buffer_counter++;
+	inst->last_qbuf_time_ns = replay_ns;
+	inst->max_input_data_size = 1;
+	msm_vidc_scale_clocks(inst);
+	if (!input)
+		replay_out_queued++;
+}
+
+static int replay_run(enum replay_policy policy, struct replay_result *res)
+{
+	struct allowed_clock_rates_table clks[ARRAY_SIZE(replay_clks)];
+	struct msm_vidc_inst_capability *caps;
+	struct msm_vidc_core *core;
+	struct msm_vidc_inst *inst;
+	struct msm_vidc_dt *dt;
+	const double fmax = replay_clks[0].clock_rate;
+	double remaining = 0, mhz_ns = 0;
+	u64 *done_ns, start_ns = 0, deadline, next, t_dec, t_disp;
+	u32 dec = 0, disp = 0, inputs = 0, k;
+	bool decoding = false, started = false, shown = false;
+	int rc = -ENOMEM;
+
+	core = calloc(1, sizeof(*core));
+	inst = calloc(1, sizeof(*inst));
+	caps = calloc(1, sizeof(*caps));
+	dt = calloc(1, sizeof(*dt));
+	done_ns = calloc(trace.num_frames, sizeof(*done_ns));
+	if (!core || !inst || !caps || !dt || !done_ns)
+		goto exit;
+
+	memcpy(clks, replay_clks, sizeof(clks));
+	dt->allowed_clks_tbl = clks;
+	dt->allowed_clks_tbl_size = ARRAY_SIZE(clks);
+	core->dt = dt;
+	core->session_ops = &replay_session_ops;
+	core->dcvs_policy = policy == REPLAY_PREDICTIVE ?
+		MSM_VIDC_DCVS_POLICY_PREDICTIVE : MSM_VIDC_DCVS_POLICY_THRESHOLD;
+	core->vote_filter.up_percent = VOTE_UP_PERCENT_VALUE;
+	core->vote_filter.down_percent = VOTE_DOWN_PERCENT_VALUE;
+	core->vote_filter.down_window_ms = VOTE_DOWN_WINDOW_MS_VALUE;
+	mutex_init(&core->lock);
+	INIT_LIST_HEAD(&core->clk_aggr.list);
+	xa_init(&core->session_xa);
+
+	inst->core = core;
+	inst->domain = MSM_VIDC_DECODER;
+	inst->session_id = REPLAY_SESSION_ID;
+	strscpy(inst->debug_str, "replay", sizeof(inst->debug_str));
+	caps->cap[FRAME_RATE].value = trace.fps << 16;
+	inst->capabilities = caps;
+	inst->buffers.output.min_count = trace.min_count;
+	inst->buffers.output.actual_count = trace.actual_count;
+	inst->power.dcvs_mode = policy == REPLAY_THRESHOLD ||
+		policy == REPLAY_PREDICTIVE;
+	INIT_LIST_HEAD(&inst->power.clk_node);
+	xa_store(&core->session_xa, inst->session_id, inst, GFP_KERNEL);
+	msm_vidc_dcvs_data_reset(inst);
+
+	msm_vidc_clock_voting = policy == REPLAY_TURBO ? (int)fmax : 0;
+	replay_ns = 1;
+	replay_clk = 0;
+	replay_out_queued = 0;
+	memset(res, 0, sizeof(*res));
+
+	/* streamon: inputs ahead of fw, then every output buffer */
+	for (; inputs < min_t(u32, REPLAY_INPUT_DEPTH, trace.num_frames); inputs++)
+		replay_qbuf(inst, true);
+	for (k = 0; k < trace.actual_count; k++)
+		replay_qbuf(inst, false);
+
+	while (disp < trace.num_frames) {
+		/* fw takes the next input once an empty output is queued */
+		if (!decoding && dec < trace.num_frames &&
+			replay_out_queued > 0) {
+			decoding = true;
+			remaining = trace.cycles[dec];
+			if (inputs < trace.num_frames) {
+				replay_qbuf(inst, true);
+				inputs++;
+			}
+		}
+
+		t_dec = U64_MAX;
+		if (decoding) {
+			double ns = remaining * NSEC_PER_SEC / replay_clk;
+
+			t_dec = replay_ns + (u64)ns + ((double)(u64)ns < ns);
+		}
+		t_disp = U64_MAX;
+		if (started && disp < dec) {
+			deadline = start_ns + (trace.ts_us[disp] - trace.ts_us[0]) *
+				NSEC_PER_USEC;
+			t_disp = max(deadline, done_ns[disp]);
+		}
+		next = min(t_dec, t_disp);
+		if (next == U64_MAX) {
+			fprintf(stderr, "stalled at frame %u\n", disp);
+			rc = -EDEADLK;
+			goto exit;
+		}
+
+		if (decoding) {
+			double ran = min((double)(next - replay_ns) * replay_clk /
+				NSEC_PER_SEC, remaining);
+
+			remaining -= ran;
+			res->energy += ran * (replay_clk / fmax) * (replay_clk / fmax);
+		}
+		mhz_ns += (double)(next - replay_ns) * replay_clk / 1e6;
+		replay_ns = next;
+
+		if (decoding && next == t_dec) {
+			/* fbd */
+			decoding = false;
+			done_ns[dec] = replay_ns;
+			replay_out_queued--;
+			msm_vidc_update_timestamp(inst, trace.ts_us[dec]);
+			msm_vidc_dcvs_frame_done(inst);
+			if (++dec == min_t(u32, REPLAY_PREROLL, trace.num_frames)) {
+				started = true;
+				start_ns = replay_ns;
+			}
+			continue;
+		}
+
+		/* display disp, return the buffer shown before it */
+		deadline = start_ns + (trace.ts_us[disp] - trace.ts_us[0]) *
+			NSEC_PER_USEC;
+		if (done_ns[disp] > deadline) {
+			res->misses++;
+			res->worst_late_ns = max(res->worst_late_ns,
+				done_ns[disp] - deadline);
+		}
+		disp++;
+		if (shown)
+			replay_qbuf(inst, false);
+		shown = true;
+	}
+
+	res->avg_mhz = mhz_ns / replay_ns;
+	res->votes = core->vote_filter.clk_votes;
+	res->suppressed = core->vote_filter.clk_suppressed;
+	rc = 0;
+
+exit:
+	free(done_ns);
+	free(dt);
+	free(caps);
+	free(inst);
+	free(core);
+	return rc;
+}
+
+static int replay_trace_file(const char *path)
+{
+	struct replay_result res[REPLAY_POLICY_MAX];
+	double total = 0;
+	int policy, rc;
+	u32 k;
+
+	rc = replay_load(path);
+	if (rc)
+		return rc;
+
+	for (k = 0; k < trace.num_frames; k++)
+		total += trace.cycles[k];
+
+	printf("%s: %u frames at %u fps, thresholds %u..%u\n", path,
+		trace.num_frames, trace.fps, trace.min_count,
+		min(trace.min_count + DCVS_DEC_EXTRA_OUTPUT_BUFFERS,
+			trace.actual_count));
+	printf("  %-10s %8s %8s %10s %9s %7s %10s\n", "policy", "energy",
+		"misses", "late max", "avg MHz", "votes", "suppressed");
+	for (policy = 0; policy < REPLAY_POLICY_MAX; policy++) {
+		rc = replay_run(policy, &res[policy]);
+		if (rc)
+			return rc;
+		printf("  %-10s %8.3f %8u %8llums %9.1f %7llu %10llu\n",
+			replay_policy_name[policy], res[policy].energy / total,
+			res[policy].misses,
+			div_u64(res[policy].worst_late_ns, NSEC_PER_MSEC),
+			res[policy].avg_mhz, res[policy].votes,
+			res[policy].suppressed);
+	}
+
+	/* everything at f_max must keep up, or the trace is not decodable */
+	if (res[REPLAY_TURBO].misses) {
+		fprintf(stderr, "%s: misses at %u MHz, trace exceeds the core\n",
+			path, replay_clks[0].clock_rate / 1000000);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "g:")) != -1) {
+		switch (opt) {
+		case 'g':
+			return replay_generate(optarg) ? 1 : 0;
+		default:
+			fprintf(stderr, "usage: %s [trace.csv ...] | -g steady|scene|burst\n",
+				argv[0]);
+			return 2;
+		}
+	}
+
+	if (optind == argc) {
+		fprintf(stderr, "no traces given\n");
+		return 2;
+	}
+
+	for (i = optind; i < argc; i++)
+		if (replay_trace_file(argv[i]))
+			return 1;
+
+	return 0;
+}
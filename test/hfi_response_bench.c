@@ -0,0 +1,427 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Copyright (c) 2021, The Linux Foundation. All rights reserved.
+ */
+
+/*
+ * Throughput of session response classification, the walk that sorts
+ * the packets of each firmware response into the error, info, property
+ * and command ranges before their handlers run. The driver's single
+ * walk is timed against the per range walk it replaced, on the same
+ * responses, and both must visit the packets in the same order.
+ *
+ * Responses come from a capture of the VIDC_PKT debug log, the rows
+ * __dump_packet prints for each message read from the queues, or are
+ * synthesized to look like a decode session when no capture is given.
+ *
+ *   hfi_response_bench [-n iterations] [capture.log]
+ *   hfi_response_bench -e [-f frames]	print a synthesized capture
+ */
+
+#include "../driver/vidc/src/venus_hfi_response.c"
+#include <float.h>
+
+#define BENCH_MAX_HEADERS	65536
+#define BENCH_ROW_WORDS		8
+#define BENCH_ROUNDS		5
+
+struct bench_trace {
+	struct hfi_header *hdrs[BENCH_MAX_HEADERS];
+	u32 num_hdrs;
+	u64 num_packets;
+};
+
+static struct bench_trace trace;
+static u16 order_new[MAX_HFI_RESPONSE_PACKETS];
+static u16 order_old[MAX_HFI_RESPONSE_PACKETS];
+
+static u64 bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* the packets must fit the header and be word aligned for the walk */
+static bool bench_valid_header(struct hfi_header *hdr, u32 words)
+{
+	struct hfi_packet *packet;
+	u32 offset = sizeof(*hdr);
+	u32 i;
+
+	if (words * sizeof(u32) < sizeof(*hdr) || hdr->size != words * sizeof(u32))
+		return false;
+	if (!hdr->num_packets || hdr->num_packets > MAX_HFI_RESPONSE_PACKETS)
+		return false;
+
+	for (i = 0; i < hdr->num_packets; i++) {
+		if (offset + sizeof(*packet) > hdr->size)
+			return false;
+		packet = (struct hfi_packet *)((u8 *)hdr + offset);
+		if (packet->size < sizeof(*packet) || packet->size % sizeof(u32) ||
+			offset + packet->size > hdr->size)
+			return false;
+		offset += packet->size;
+	}
+
+	return true;
+}
+
+static void bench_add_header(u32 *words, u32 num_words)
+{
+	struct hfi_header *hdr;
+
+	if (trace.num_hdrs == BENCH_MAX_HEADERS)
+		return;
+	if (!bench_valid_header((struct hfi_header *)words, num_words))
+		return;
+
+	hdr = malloc(num_words * sizeof(u32));
+	if (!hdr) {
+		perror("malloc");
+		exit(1);
+	}
+	memcpy(hdr, words, num_words * sizeof(u32));
+	trace.hdrs[trace.num_hdrs++] = hdr;
+	trace.num_packets += hdr->num_packets;
+}
+
+/*
+ * Messages start at a "__msgq_peek: <qinfo>" or "__read_queue: <qinfo>"
+ * line, followed by rows of up to eight 32 bit words after the last
+ * ": " of the log prefix. The first word is the message size in bytes.
+ */
+static int bench_load_capture(const char *path)
+{
+	u32 words[VIDC_IFACEQ_VAR_HUGE_PKT_SIZE / sizeof(u32)];
+	u32 num_words = 0, want = 0;
+	bool in_msg = false;
+	char line[512];
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -errno;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		char *row, *tok, *end;
+		unsigned long val;
+
+		if (strstr(line, "__msgq_peek: ") || strstr(line, "__read_queue: ")) {
+			in_msg = true;
+			num_words = 0;
+			want = 0;
+			continue;
+		}
+		if (!in_msg)
+			continue;
+
+		row = line;
+		while ((tok = strstr(row, ": ")))
+			row = tok + 2;
+
+		for (tok = strtok(row, " \n"); tok; tok = strtok(NULL, " \n")) {
+			val = strtoul(tok, &end, 16);
+			if (strlen(tok) != 8 || *end) {
+				in_msg = false;
+				break;
+			}
+			words[num_words++] = val;
+			if (num_words == 1) {
+				want = val / sizeof(u32);
+				if (!want || want > ARRAY_SIZE(words)) {
+					in_msg = false;
+					break;
+				}
+			}
+			if (num_words == want) {
+				bench_add_header(words, num_words);
+				in_msg = false;
+				break;
+			}
+		}
+	}
+	fclose(f);
+
+	return 0;
+}
+
+static u32 bench_rand_state = 0x5eed1234;
+
+static u32 bench_rand(void)
+{
+	bench_rand_state = bench_rand_state * 1103515245 + 12345;
+	return bench_rand_state >> 8;
+}
+
+static u32 *bench_put_packet(u32 *p, u32 type, u32 flags, u32 payload_info,
+	u32 port, u32 payload_words)
+{
+	struct hfi_packet *packet = (struct hfi_packet *)p;
+	static u32 packet_id;
+
+	memset(packet, 0, sizeof(*packet) + payload_words * sizeof(u32));
+	packet->size = sizeof(*packet) + payload_words * sizeof(u32);
+	packet->type = type;
+	packet->flags = flags;
+	packet->payload_info = payload_info;
+	packet->port = port;
+	packet->packet_id = ++packet_id;
+
+	return p + packet->size / sizeof(u32);
+}
+
+static u32 *bench_put_buffer(u32 *p, u32 port, u32 type, u32 index, u64 ts)
+{
+	struct hfi_buffer *buf;
+	u32 *payload = p + sizeof(struct hfi_packet) / sizeof(u32);
+
+	p = bench_put_packet(p, HFI_CMD_BUFFER, HFI_FW_FLAGS_SUCCESS,
+		HFI_PAYLOAD_STRUCTURE, port, sizeof(*buf) / sizeof(u32));
+	buf = (struct hfi_buffer *)payload;
+	buf->type = type;
+	buf->index = index;
+	buf->base_address = 0x80000000ull + index * 0x100000;
+	buf->buffer_size = 0x100000;
+	buf->data_size = 0x8000 + (bench_rand() & 0xffff);
+	buf->timestamp = ts;
+
+	return p;
+}
+
+static u32 *bench_put_prop(u32 *p, u32 type, u32 port, u32 value)
+{
+	u32 *payload = p + sizeof(struct hfi_packet) / sizeof(u32);
+
+	p = bench_put_packet(p, type, HFI_FW_FLAGS_SUCCESS, HFI_PAYLOAD_U32,
+		port, 1);
+	*payload = value;
+
+	return p;
+}
+
+/*
+ * Responses of a decode session: input buffer done on its own, and
+ * output buffer done after the per frame properties, with the DPB list
+ * and an occasional info packet.
+ */
+static void bench_synthesize(u32 num_frames)
+{
+	u32 words[512];
+	struct hfi_header *hdr = (struct hfi_header *)words;
+	u32 *p, frame;
+	u64 ts = 0;
+
+	for (frame = 0; frame < num_frames; frame++) {
+		memset(hdr, 0, sizeof(*hdr));
+		hdr->session_id = 0x8a3b1c20;
+		hdr->header_id = frame * 2;
+		p = words + sizeof(*hdr) / sizeof(u32);
+		p = bench_put_buffer(p, HFI_PORT_BITSTREAM, HFI_BUFFER_BITSTREAM,
+			frame % 16, ts);
+		hdr->num_packets = 1;
+		hdr->size = (p - words) * sizeof(u32);
+		bench_add_header(words, p - words);
+
+		memset(hdr, 0, sizeof(*hdr));
+		hdr->session_id = 0x8a3b1c20;
+		hdr->header_id = frame * 2 + 1;
+		p = words + sizeof(*hdr) / sizeof(u32);
+		p = bench_put_prop(p, HFI_PROP_PICTURE_TYPE, HFI_PORT_RAW,
+			1 << (bench_rand() % 3));
+		p = bench_put_prop(p, HFI_PROP_WORST_COMPRESSION_RATIO,
+			HFI_PORT_RAW, 0x10000 + (bench_rand() & 0xffff));
+		p = bench_put_prop(p, HFI_PROP_CABAC_SESSION, HFI_PORT_RAW, 1);
+		hdr->num_packets = 3;
+		if (!(frame % 8)) {
+			p = bench_put_packet(p, HFI_PROP_DPB_LIST,
+				HFI_FW_FLAGS_SUCCESS, HFI_PAYLOAD_STRUCTURE,
+				HFI_PORT_RAW, 16);
+			hdr->num_packets++;
+		}
+		if (!(frame % 30)) {
+			p = bench_put_prop(p, HFI_PROP_NO_OUTPUT, HFI_PORT_RAW, 1);
+			hdr->num_packets++;
+		}
+		if (!(frame % 64)) {
+			p = bench_put_packet(p, HFI_INFO_DATA_CORRUPT,
+				HFI_FW_FLAGS_INFORMATION, HFI_PAYLOAD_NONE,
+				HFI_PORT_BITSTREAM, 0);
+			hdr->num_packets++;
+		}
+		p = bench_put_buffer(p, HFI_PORT_RAW, HFI_BUFFER_RAW, frame % 24, ts);
+		hdr->num_packets++;
+		hdr->size = (p - words) * sizeof(u32);
+		bench_add_header(words, p - words);
+
+		ts += 33333;
+	}
+}
+
+static void bench_emit_capture(void)
+{
+	u32 i, w, num_words;
+	u32 *words;
+
+	for (i = 0; i < trace.num_hdrs; i++) {
+		words = (u32 *)trace.hdrs[i];
+		num_words = trace.hdrs[i]->size / sizeof(u32);
+		printf("msm_vidc: pkt : %08x: __msgq_peek: 00000000b1e5f00d\n",
+			trace.hdrs[i]->session_id);
+		for (w = 0; w < num_words; w++) {
+			if (!(w % BENCH_ROW_WORDS))
+				printf("msm_vidc: pkt : %08x: ",
+					trace.hdrs[i]->session_id);
+			printf("%08x%c", words[w],
+				(w % BENCH_ROW_WORDS == BENCH_ROW_WORDS - 1 ||
+				 w == num_words - 1) ? '\n' : ' ');
+		}
+	}
+}
+
+/* the single walk, then the per range lists in handling order */
+static u32 bench_walk_new(struct msm_vidc_inst *inst, struct hfi_header *hdr)
+{
+	struct msm_vidc_hfi_dispatch *dispatch = &inst->hfi_dispatch;
+	u16 head[ARRAY_SIZE(session_ranges)];
+	u16 tail[ARRAY_SIZE(session_ranges)];
+	u32 n = 0;
+	int i, j;
+
+	__session_response_classify(inst, hdr, head, tail);
+	for (i = 0; i < ARRAY_SIZE(session_ranges); i++)
+		for (j = head[i]; j != U16_MAX; j = dispatch->next[j])
+			order_new[n++] = dispatch->offset[j];
+
+	return n;
+}
+
+/* the walk __handle_session_response did before, one pass per range */
+static u32 bench_walk_old(struct msm_vidc_inst *inst, struct hfi_header *hdr)
+{
+	struct hfi_packet *packet;
+	u8 *pkt, *start_pkt;
+	u32 n = 0;
+	int i, j;
+
+	start_pkt = (u8 *)hdr + sizeof(struct hfi_header);
+	for (i = 0; i < ARRAY_SIZE(session_ranges); i++) {
+		pkt = start_pkt;
+		for (j = 0; j < hdr->num_packets; j++) {
+			packet = (struct hfi_packet *)pkt;
+			if (packet->flags & HFI_FW_FLAGS_SESSION_ERROR)
+				handle_session_error(inst, packet);
+			if (in_range(session_ranges[i], packet->type))
+				order_old[n++] = pkt - (u8 *)hdr;
+			pkt += packet->size;
+		}
+	}
+
+	return n;
+}
+
+static double bench_run(struct msm_vidc_inst *inst, u32 iterations,
+	u32 (*walk)(struct msm_vidc_inst *inst, struct hfi_header *hdr))
+{
+	volatile u32 sink = 0;
+	u64 start;
+	u32 it, i;
+
+	start = bench_now_ns();
+	for (it = 0; it < iterations; it++)
+		for (i = 0; i < trace.num_hdrs; i++)
+			sink += walk(inst, trace.hdrs[i]);
+
+	return (double)(bench_now_ns() - start);
+}
+
+int main(int argc, char **argv)
+{
+	struct msm_vidc_inst *inst;
+	u32 iterations = 0, frames = 4096, i, n_new, n_old;
+	double ns_new, ns_old;
+	bool emit = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:ef:")) != -1) {
+		switch (opt) {
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			emit = true;
+			break;
+		case 'f':
+			frames = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr,
+				"usage: %s [-n iterations] [capture.log] | -e [-f frames]\n",
+				argv[0]);
+			return 2;
+		}
+	}
+
+	if (optind < argc) {
+		if (bench_load_capture(argv[optind]))
+			return 1;
+	} else {
+		bench_synthesize(frames);
+	}
+	if (emit) {
+		bench_emit_capture();
+		return 0;
+	}
+	if (!trace.num_hdrs) {
+		fprintf(stderr, "no session responses found\n");
+		return 1;
+	}
+
+	inst = calloc(1, sizeof(*inst));
+	if (!inst)
+		return 1;
+	strscpy(inst->debug_str, "bench", sizeof(inst->debug_str));
+
+	for (i = 0; i < trace.num_hdrs; i++) {
+		n_new = bench_walk_new(inst, trace.hdrs[i]);
+		n_old = bench_walk_old(inst, trace.hdrs[i]);
+		if (n_new != n_old ||
+			memcmp(order_new, order_old, n_new * sizeof(u16))) {
+			fprintf(stderr, "response %u: packet order differs\n", i);
+			return 1;
+		}
+	}
+
+	/* about 20M packets per walk unless asked otherwise */
+	if (!iterations)
+		iterations = max_t(u64, 1, 20000000ull / trace.num_packets);
+
+	/* alternate the walks and keep the best of each */
+	bench_run(inst, 1, bench_walk_new);
+	bench_run(inst, 1, bench_walk_old);
+	ns_old = ns_new = DBL_MAX;
+	for (i = 0; i < BENCH_ROUNDS; i++) {
+		ns_old = min(ns_old, bench_run(inst, iterations, bench_walk_old));
+		ns_new = min(ns_new, bench_run(inst, iterations, bench_walk_new));
+	}
+
+	printf("%u responses, %llu packets, %.2f packets/response, %u iterations\n",
+		trace.num_hdrs, (unsigned long long)trace.num_packets,
+		(double)trace.num_packets / trace.num_hdrs, iterations);
+	printf("%-12s %10s %14s %14s\n", "walk", "ns/resp", "Mresp/s", "Mpackets/s");
+	printf("%-12s %10.1f %14.2f %14.2f\n", "per-range",
+		ns_old / iterations / trace.num_hdrs,
+		iterations * (double)trace.num_hdrs / ns_old * 1e3,
+		iterations * (double)trace.num_packets / ns_old * 1e3);
+	printf("%-12s %10.1f %14.2f %14.2f\n", "single",
+		ns_new / iterations / trace.num_hdrs,
+		iterations * (double)trace.num_hdrs / ns_new * 1e3,
+		iterations * (double)trace.num_packets / ns_new * 1e3);
+	printf("speedup %.2fx\n", ns_old / ns_new);
+
+	free(inst);
+	return 0;
+}
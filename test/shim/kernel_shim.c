@@ -0,0 +1,570 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Copyright (c) 2021, The Linux Foundation. All rights reserved.
+ */
+
+/*
+ * Userspace implementation of the kernel services declared in
+ * kernel_shim.h that the host tests actually run: printk, workqueues,
+ * kthreads and a fake dma-buf exporter with an fd table.
+ */
+
+#include <sched.h>
+
+/* printing, silent unless MSM_VIDC_SHIM_LOG is set */
+int shim_printk_enabled;
+
+static void __attribute__((constructor)) shim_printk_init(void)
+{
+	shim_printk_enabled = getenv("MSM_VIDC_SHIM_LOG") != NULL;
+}
+
+int shim_printk(const char *fmt, ...)
+{
+	va_list args;
+	int rc;
+
+	if (!shim_printk_enabled)
+		return 0;
+
+	va_start(args, fmt);
+	rc = vfprintf(stderr, fmt, args);
+	va_end(args);
+
+	return rc;
+}
+
+void shim_unimplemented(const char *name)
+{
+	fprintf(stderr, "kernel_shim: %s() is not implemented\n", name);
+	abort();
+}
+
+int sched_yield_shim(void)
+{
+	return sched_yield();
+}
+
+void sort(void *base, size_t num, size_t size,
+	int (*cmp)(const void *, const void *),
+	void (*swap_fn)(void *, void *, int))
+{
+	qsort(base, num, size, cmp);
+}
+
+/* workqueues: one thread per queue, works run in due order */
+struct workqueue_struct {
+	char name[32];
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct list_head works;
+	struct work_struct *running;
+	bool stop;
+};
+
+struct workqueue_struct *system_wq;
+struct workqueue_struct *system_unbound_wq;
+
+static void wq_timeout(struct timespec *ts, u64 due_ns)
+{
+	u64 now = shim_now_ns();
+	u64 wait = due_ns > now ? due_ns - now : 0;
+
+	clock_gettime(CLOCK_REALTIME, ts);
+	ts->tv_sec += wait / NSEC_PER_SEC;
+	ts->tv_nsec += wait % NSEC_PER_SEC;
+	if (ts->tv_nsec >= NSEC_PER_SEC) {
+		ts->tv_sec++;
+		ts->tv_nsec -= NSEC_PER_SEC;
+	}
+}
+
+static struct work_struct *wq_next(struct workqueue_struct *wq, u64 *due_ns)
+{
+	struct work_struct *work, *next = NULL;
+
+	list_for_each_entry(work, &wq->works, entry) {
+		if (!next || work->due_ns < next->due_ns)
+			next = work;
+	}
+	if (next)
+		*due_ns = next->due_ns;
+
+	return next;
+}
+
+static void *wq_thread(void *data)
+{
+	struct workqueue_struct *wq = data;
+	struct work_struct *work;
+	struct timespec ts;
+	u64 due_ns;
+
+	pthread_mutex_lock(&wq->lock);
+	while (!wq->stop) {
+		work = wq_next(wq, &due_ns);
+		if (!work) {
+			pthread_cond_wait(&wq->cond, &wq->lock);
+			continue;
+		}
+		if (due_ns > shim_now_ns()) {
+			wq_timeout(&ts, due_ns);
+			pthread_cond_timedwait(&wq->cond, &wq->lock, &ts);
+			continue;
+		}
+		list_del_init(&work->entry);
+		work->pending = false;
+		wq->running = work;
+		pthread_mutex_unlock(&wq->lock);
+
+		work->func(work);
+
+		pthread_mutex_lock(&wq->lock);
+		wq->running = NULL;
+		pthread_cond_broadcast(&wq->cond);
+	}
+	pthread_mutex_unlock(&wq->lock);
+
+	return NULL;
+}
+
+struct workqueue_struct *alloc_workqueue(const char *fmt, unsigned int flags,
+	int max_active, ...)
+{
+	struct workqueue_struct *wq;
+
+	wq = calloc(1, sizeof(*wq));
+	if (!wq)
+		return NULL;
+
+	snprintf(wq->name, sizeof(wq->name), "%s", fmt);
+	pthread_mutex_init(&wq->lock, NULL);
+	pthread_cond_init(&wq->cond, NULL);
+	INIT_LIST_HEAD(&wq->works);
+	if (pthread_create(&wq->thread, NULL, wq_thread, wq)) {
+		free(wq);
+		return NULL;
+	}
+
+	return wq;
+}
+
+static void __attribute__((constructor)) shim_wq_init(void)
+{
+	system_wq = alloc_workqueue("events", 0, 0);
+	system_unbound_wq = alloc_workqueue("events_unbound", WQ_UNBOUND, 0);
+}
+
+void flush_workqueue(struct workqueue_struct *wq)
+{
+	pthread_mutex_lock(&wq->lock);
+	while (!list_empty(&wq->works) || wq->running)
+		pthread_cond_wait(&wq->cond, &wq->lock);
+	pthread_mutex_unlock(&wq->lock);
+}
+
+void destroy_workqueue(struct workqueue_struct *wq)
+{
+	if (!wq)
+		return;
+
+	flush_workqueue(wq);
+	pthread_mutex_lock(&wq->lock);
+	wq->stop = true;
+	pthread_cond_broadcast(&wq->cond);
+	pthread_mutex_unlock(&wq->lock);
+	pthread_join(wq->thread, NULL);
+	free(wq);
+}
+
+static bool __queue_work(struct workqueue_struct *wq, struct work_struct *work,
+	unsigned long delay, bool modify)
+{
+	bool was_pending;
+
+	pthread_mutex_lock(&wq->lock);
+	was_pending = work->pending;
+	if (was_pending && !modify) {
+		pthread_mutex_unlock(&wq->lock);
+		return false;
+	}
+	if (was_pending)
+		list_del_init(&work->entry);
+	work->wq = wq;
+	work->pending = true;
+	work->due_ns = shim_now_ns() + (u64)delay * NSEC_PER_MSEC;
+	list_add_tail(&work->entry, &wq->works);
+	pthread_cond_broadcast(&wq->cond);
+	pthread_mutex_unlock(&wq->lock);
+
+	return modify ? was_pending : true;
+}
+
+bool queue_work(struct workqueue_struct *wq, struct work_struct *work)
+{
+	return __queue_work(wq, work, 0, false);
+}
+
+bool queue_delayed_work(struct workqueue_struct *wq, struct delayed_work *dwork,
+	unsigned long delay)
+{
+	return __queue_work(wq, &dwork->work, delay, false);
+}
+
+bool mod_delayed_work(struct workqueue_struct *wq, struct delayed_work *dwork,
+	unsigned long delay)
+{
+	return __queue_work(wq, &dwork->work, delay, true);
+}
+
+static bool __cancel_work(struct work_struct *work, bool sync)
+{
+	struct workqueue_struct *wq = work->wq;
+	bool was_pending;
+
+	if (!wq)
+		return false;
+
+	pthread_mutex_lock(&wq->lock);
+	was_pending = work->pending;
+	if (was_pending) {
+		list_del_init(&work->entry);
+		work->pending = false;
+	}
+	while (sync && wq->running == work)
+		pthread_cond_wait(&wq->cond, &wq->lock);
+	pthread_mutex_unlock(&wq->lock);
+
+	return was_pending;
+}
+
+bool cancel_work_sync(struct work_struct *work)
+{
+	return __cancel_work(work, true);
+}
+
+bool cancel_delayed_work(struct delayed_work *dwork)
+{
+	return __cancel_work(&dwork->work, false);
+}
+
+bool cancel_delayed_work_sync(struct delayed_work *dwork)
+{
+	return __cancel_work(&dwork->work, true);
+}
+
+bool flush_work(struct work_struct *work)
+{
+	struct workqueue_struct *wq = work->wq;
+	bool waited = false;
+
+	if (!wq)
+		return false;
+
+	pthread_mutex_lock(&wq->lock);
+	while (work->pending || wq->running == work) {
+		pthread_cond_wait(&wq->cond, &wq->lock);
+		waited = true;
+	}
+	pthread_mutex_unlock(&wq->lock);
+
+	return waited;
+}
+
+bool flush_delayed_work(struct delayed_work *dwork)
+{
+	struct workqueue_struct *wq = dwork->work.wq;
+
+	/* run a pending delayed work now, as the kernel does */
+	if (wq) {
+		pthread_mutex_lock(&wq->lock);
+		if (dwork->work.pending) {
+			dwork->work.due_ns = 0;
+			pthread_cond_broadcast(&wq->cond);
+		}
+		pthread_mutex_unlock(&wq->lock);
+	}
+
+	return flush_work(&dwork->work);
+}
+
+/* kernel threads */
+static __thread struct task_struct *shim_current;
+
+static void *kthread_entry(void *data)
+{
+	struct task_struct *task = data;
+
+	shim_current = task;
+	task->ret = task->fn(task->data);
+
+	return NULL;
+}
+
+struct task_struct *kthread_run(int (*fn)(void *data), void *data,
+	const char *namefmt, ...)
+{
+	struct task_struct *task;
+
+	task = calloc(1, sizeof(*task));
+	if (!task)
+		return ERR_PTR(-ENOMEM);
+
+	task->fn = fn;
+	task->data = data;
+	if (pthread_create(&task->thread, NULL, kthread_entry, task)) {
+		free(task);
+		return ERR_PTR(-EAGAIN);
+	}
+
+	return task;
+}
+
+bool kthread_should_stop(void)
+{
+	return shim_current && READ_ONCE(shim_current->should_stop);
+}
+
+int kthread_stop(struct task_struct *task)
+{
+	int ret;
+
+	WRITE_ONCE(task->should_stop, true);
+	pthread_join(task->thread, NULL);
+	ret = task->ret;
+	free(task);
+
+	return ret;
+}
+
+/* dma-buf: exported buffers live in an fd table, each fd holds one ref */
+#define SHIM_DMA_BUF_FD_BASE	1000
+#define SHIM_DMA_BUF_MAX_FDS	4096
+
+static struct dma_buf *shim_dma_buf_fds[SHIM_DMA_BUF_MAX_FDS];
+static pthread_mutex_t shim_dma_buf_lock = PTHREAD_MUTEX_INITIALIZER;
+static u64 shim_next_iova = 0x10000000;
+
+struct dma_buf *dma_buf_export(const struct dma_buf_export_info *exp_info)
+{
+	struct dma_buf *dmabuf;
+
+	dmabuf = calloc(1, sizeof(*dmabuf));
+	if (!dmabuf)
+		return ERR_PTR(-ENOMEM);
+
+	dmabuf->size = exp_info->size;
+	dmabuf->ops = exp_info->ops;
+	dmabuf->priv = exp_info->priv;
+	dmabuf->name = exp_info->exp_name;
+	kref_init(&dmabuf->refs);
+
+	return dmabuf;
+}
+
+int dma_buf_fd(struct dma_buf *dmabuf, int flags)
+{
+	int i;
+
+	pthread_mutex_lock(&shim_dma_buf_lock);
+	for (i = 0; i < SHIM_DMA_BUF_MAX_FDS; i++) {
+		if (!shim_dma_buf_fds[i]) {
+			shim_dma_buf_fds[i] = dmabuf;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&shim_dma_buf_lock);
+
+	return i < SHIM_DMA_BUF_MAX_FDS ? SHIM_DMA_BUF_FD_BASE + i : -EMFILE;
+}
+
+struct dma_buf *dma_buf_get(int fd)
+{
+	struct dma_buf *dmabuf = NULL;
+	int i = fd - SHIM_DMA_BUF_FD_BASE;
+
+	if (i < 0 || i >= SHIM_DMA_BUF_MAX_FDS)
+		return ERR_PTR(-EBADF);
+
+	pthread_mutex_lock(&shim_dma_buf_lock);
+	dmabuf = shim_dma_buf_fds[i];
+	if (dmabuf)
+		kref_get(&dmabuf->refs);
+	pthread_mutex_unlock(&shim_dma_buf_lock);
+
+	return dmabuf ? dmabuf : ERR_PTR(-EBADF);
+}
+
+static void dma_buf_release(struct kref *kref)
+{
+	struct dma_buf *dmabuf = container_of(kref, struct dma_buf, refs);
+
+	if (dmabuf->ops && dmabuf->ops->release)
+		dmabuf->ops->release(dmabuf);
+	free(dmabuf->vaddr);
+	free(dmabuf);
+}
+
+void dma_buf_put(struct dma_buf *dmabuf)
+{
+	if (!dmabuf)
+		return;
+
+	kref_put(&dmabuf->refs, dma_buf_release);
+}
+
+/* drops the reference an fd holds, the userspace close() */
+int close_fd(unsigned int fd)
+{
+	struct dma_buf *dmabuf = NULL;
+	int i = fd - SHIM_DMA_BUF_FD_BASE;
+
+	if (i < 0 || i >= SHIM_DMA_BUF_MAX_FDS)
+		return -EBADF;
+
+	pthread_mutex_lock(&shim_dma_buf_lock);
+	dmabuf = shim_dma_buf_fds[i];
+	shim_dma_buf_fds[i] = NULL;
+	pthread_mutex_unlock(&shim_dma_buf_lock);
+	if (!dmabuf)
+		return -EBADF;
+
+	dma_buf_put(dmabuf);
+	return 0;
+}
+
+/* exporter ops are used when given, as the kernel does */
+struct dma_buf_attachment *dma_buf_attach(struct dma_buf *dmabuf,
+	struct device *dev)
+{
+	struct dma_buf_attachment *attach;
+	int ret;
+
+	attach = calloc(1, sizeof(*attach));
+	if (!attach)
+		return ERR_PTR(-ENOMEM);
+
+	attach->dmabuf = dmabuf;
+	attach->dev = dev;
+	if (dmabuf->ops && dmabuf->ops->attach) {
+		ret = dmabuf->ops->attach(dmabuf, attach);
+		if (ret) {
+			free(attach);
+			return ERR_PTR(ret);
+		}
+	}
+	kref_get(&dmabuf->refs);
+
+	return attach;
+}
+
+void dma_buf_detach(struct dma_buf *dmabuf, struct dma_buf_attachment *attach)
+{
+	if (dmabuf->ops && dmabuf->ops->detach)
+		dmabuf->ops->detach(dmabuf, attach);
+	free(attach);
+	dma_buf_put(dmabuf);
+}
+
+int sg_alloc_table(struct sg_table *table, unsigned int nents, gfp_t gfp)
+{
+	table->sgl = calloc(nents, sizeof(*table->sgl));
+	if (!table->sgl)
+		return -ENOMEM;
+	table->nents = table->orig_nents = nents;
+
+	return 0;
+}
+
+void sg_free_table(struct sg_table *table)
+{
+	free(table->sgl);
+	table->sgl = NULL;
+}
+
+struct sg_table *dma_buf_map_attachment(struct dma_buf_attachment *attach,
+	enum dma_data_direction dir)
+{
+	struct sg_table *table;
+
+	if (attach->dmabuf->ops && attach->dmabuf->ops->map_dma_buf)
+		return attach->dmabuf->ops->map_dma_buf(attach, dir);
+
+	table = calloc(1, sizeof(*table) + sizeof(*table->sgl));
+	if (!table)
+		return ERR_PTR(-ENOMEM);
+
+	table->sgl = (struct scatterlist *)(table + 1);
+	table->nents = table->orig_nents = 1;
+	table->sgl->length = table->sgl->dma_length = attach->dmabuf->size;
+	table->sgl->dma_address = __atomic_fetch_add(&shim_next_iova,
+		ALIGN(attach->dmabuf->size, 4096), __ATOMIC_SEQ_CST);
+
+	return table;
+}
+
+void dma_buf_unmap_attachment(struct dma_buf_attachment *attach,
+	struct sg_table *table, enum dma_data_direction dir)
+{
+	if (attach->dmabuf->ops && attach->dmabuf->ops->unmap_dma_buf) {
+		attach->dmabuf->ops->unmap_dma_buf(attach, table, dir);
+		return;
+	}
+	free(table);
+}
+
+int dma_buf_begin_cpu_access(struct dma_buf *dmabuf,
+	enum dma_data_direction dir)
+{
+	return 0;
+}
+
+int dma_buf_end_cpu_access(struct dma_buf *dmabuf,
+	enum dma_data_direction dir)
+{
+	return 0;
+}
+
+int dma_buf_begin_cpu_access_partial(struct dma_buf *dmabuf,
+	enum dma_data_direction dir, unsigned int offset, unsigned int len)
+{
+	return 0;
+}
+
+int dma_buf_end_cpu_access_partial(struct dma_buf *dmabuf,
+	enum dma_data_direction dir, unsigned int offset, unsigned int len)
+{
+	return 0;
+}
+
+void *dma_buf_vmap(struct dma_buf *dmabuf)
+{
+	if (!dmabuf->vaddr)
+		dmabuf->vaddr = calloc(1, dmabuf->size);
+
+	return dmabuf->vaddr;
+}
+
+void dma_buf_vunmap(struct dma_buf *dmabuf, void *vaddr)
+{
+}
+
+bool mem_buf_dma_buf_exclusive_owner(struct dma_buf *dmabuf)
+{
+	return true;
+}
+
+/* platform services the tests reach indirectly */
+int qcom_scm_set_remote_state(u32 state, u32 id)
+{
+	return 0;
+}
+
+void *devm_kzalloc(struct device *dev, size_t size, gfp_t gfp)
+{
+	return calloc(1, size);
+}
+
+/* owned by msm_vidc_probe.c, which the host build does not link */
+struct msm_vidc_core *g_core;
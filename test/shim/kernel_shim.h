@@ -0,0 +1,1775 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (c) 2021, The Linux Foundation. All rights reserved.
+ */
+
+/*
+ * Minimal userspace stand-in for the kernel, v4l2 and vb2 interfaces the
+ * driver sources use. It is force included ahead of every driver file by
+ * test/Makefile, every other <linux/...>, <media/...> and <soc/...>
+ * include resolves to an empty header. Only what the host tests execute
+ * is implemented, everything else just has to compile.
+ */
+
+#ifndef _MSM_VIDC_KERNEL_SHIM_H_
+#define _MSM_VIDC_KERNEL_SHIM_H_
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/types.h>
+#include <linux/videodev2.h>
+#include <linux/v4l2-controls.h>
+
+/* types */
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef unsigned long long u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef long long s64;
+typedef u64 dma_addr_t;
+typedef u64 phys_addr_t;
+typedef u64 resource_size_t;
+typedef unsigned int gfp_t;
+typedef int irqreturn_t;
+typedef s64 ktime_t;
+typedef u32 fmode_t;
+typedef long long loff_t_shim;
+
+#define IRQ_NONE		0
+#define IRQ_HANDLED		1
+#define IRQ_WAKE_THREAD		2
+
+#define __iomem
+#define __user
+#define __force
+#define __rcu
+#define __init
+#define __exit
+#define __read_mostly
+#define __maybe_unused		__attribute__((unused))
+#define __always_unused		__attribute__((unused))
+#define __packed		__attribute__((packed))
+#define __aligned(x)		__attribute__((aligned(x)))
+#undef __always_inline
+#define __always_inline		inline __attribute__((always_inline))
+#define __must_check
+#define __printf(a, b)		__attribute__((format(printf, a, b)))
+#define noinline		__attribute__((noinline))
+#define fallthrough		__attribute__((fallthrough))
+#define likely(x)		__builtin_expect(!!(x), 1)
+#define unlikely(x)		__builtin_expect(!!(x), 0)
+
+#define barrier()		__asm__ __volatile__("" ::: "memory")
+#define mb()			__sync_synchronize()
+#define rmb()			__sync_synchronize()
+#define wmb()			__sync_synchronize()
+#define smp_mb()		__sync_synchronize()
+#define smp_rmb()		__sync_synchronize()
+#define smp_wmb()		__sync_synchronize()
+#define READ_ONCE(x)		(*(const volatile __typeof__(x) *)&(x))
+#define WRITE_ONCE(x, val)	(*(volatile __typeof__(x) *)&(x) = (val))
+
+/* bits and arithmetic */
+#define BITS_PER_LONG		64
+#define BIT(nr)			(1UL << (nr))
+#define BIT_ULL(nr)		(1ULL << (nr))
+#define GENMASK(h, l) \
+	(((~0UL) - (1UL << (l)) + 1) & (~0UL >> (BITS_PER_LONG - 1 - (h))))
+#define GENMASK_ULL(h, l) \
+	(((~0ULL) - (1ULL << (l)) + 1) & (~0ULL >> (63 - (h))))
+#define ARRAY_SIZE(arr)		(sizeof(arr) / sizeof((arr)[0]))
+#define BUILD_BUG_ON(cond)	_Static_assert(!(cond), #cond)
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define min(a, b)		((a) < (b) ? (a) : (b))
+#define max(a, b)		((a) > (b) ? (a) : (b))
+#define min_t(t, a, b)		((t)(a) < (t)(b) ? (t)(a) : (t)(b))
+#define max_t(t, a, b)		((t)(a) > (t)(b) ? (t)(a) : (t)(b))
+#define min3(a, b, c)		min(min(a, b), c)
+#define max3(a, b, c)		max(max(a, b), c)
+#define clamp(v, lo, hi)	min(max(v, lo), hi)
+#define clamp_t(t, v, lo, hi)	min_t(t, max_t(t, v, lo), hi)
+#define clamp_val(v, lo, hi)	clamp_t(__typeof__(v), v, lo, hi)
+#define swap(a, b) \
+	do { __typeof__(a) __tmp = (a); (a) = (b); (b) = __tmp; } while (0)
+#define abs(x)			((x) < 0 ? -(x) : (x))
+#define DIV_ROUND_UP(n, d)	(((n) + (d) - 1) / (d))
+#define DIV_ROUND_CLOSEST(x, d)	(((x) + ((d) / 2)) / (d))
+#define DIV_ROUND_UP_ULL(n, d)	DIV_ROUND_UP((unsigned long long)(n), d)
+#define ALIGN(x, a)		(((x) + ((a) - 1)) & ~((__typeof__(x))(a) - 1))
+#define ALIGN_DOWN(x, a)	((x) & ~((__typeof__(x))(a) - 1))
+#define IS_ALIGNED(x, a)	(((x) & ((__typeof__(x))(a) - 1)) == 0)
+#define roundup(x, y)		((((x) + ((y) - 1)) / (y)) * (y))
+#define rounddown(x, y)		((x) - ((x) % (y)))
+#define round_up(x, y)		((((x) - 1) | ((__typeof__(x))((y) - 1))) + 1)
+#define round_down(x, y)	((x) & ~((__typeof__(x))((y) - 1)))
+#define mult_frac(x, n, d)	(((x) / (d)) * (n) + (((x) % (d)) * (n)) / (d))
+#define do_div(n, base) \
+	({ u32 __rem = (u64)(n) % (base); (n) = (u64)(n) / (base); __rem; })
+#define U32_MAX			((u32)~0U)
+#define S32_MAX			((s32)(U32_MAX >> 1))
+#define U64_MAX			((u64)~0ULL)
+#define U16_MAX			((u16)~0U)
+#define U8_MAX			((u8)~0U)
+
+static inline u64 div_u64(u64 dividend, u32 divisor)
+{
+	return dividend / divisor;
+}
+
+static inline s64 div_s64(s64 dividend, s32 divisor)
+{
+	return dividend / divisor;
+}
+
+static inline u64 div64_u64(u64 dividend, u64 divisor)
+{
+	return dividend / divisor;
+}
+
+static inline u64 div_u64_rem(u64 dividend, u32 divisor, u32 *remainder)
+{
+	*remainder = dividend % divisor;
+	return dividend / divisor;
+}
+
+static inline int fls(unsigned int x)
+{
+	return x ? 32 - __builtin_clz(x) : 0;
+}
+
+static inline unsigned long __ffs(unsigned long x)
+{
+	return __builtin_ctzl(x);
+}
+
+static inline int ilog2(u64 n)
+{
+	return 63 - __builtin_clzll(n);
+}
+
+#define hweight32(x)		__builtin_popcount(x)
+#define is_power_of_2(n)	((n) != 0 && (((n) & ((n) - 1)) == 0))
+
+/* errors */
+#define MAX_ERRNO		4095
+#define ERESTARTSYS		512
+#define ENOIOCTLCMD		515
+#define ENOTSUPP		524
+#define IS_ERR_VALUE(x)		((unsigned long)(void *)(x) >= (unsigned long)-MAX_ERRNO)
+
+static inline void *ERR_PTR(long error)
+{
+	return (void *)error;
+}
+
+static inline long PTR_ERR(const void *ptr)
+{
+	return (long)ptr;
+}
+
+static inline bool IS_ERR(const void *ptr)
+{
+	return IS_ERR_VALUE((unsigned long)ptr);
+}
+
+static inline bool IS_ERR_OR_NULL(const void *ptr)
+{
+	return !ptr || IS_ERR_VALUE((unsigned long)ptr);
+}
+
+#define ERR_CAST(ptr)		((void *)(ptr))
+#define PTR_ERR_OR_ZERO(ptr)	(IS_ERR(ptr) ? PTR_ERR(ptr) : 0)
+
+/* printing */
+extern int shim_printk_enabled;
+__printf(1, 2) int shim_printk(const char *fmt, ...);
+
+#define KERN_ERR		""
+#define KERN_INFO		""
+#define KERN_WARNING		""
+#define KERN_DEBUG		""
+#define pr_info(fmt, ...)	shim_printk(fmt, ##__VA_ARGS__)
+#define pr_err(fmt, ...)	shim_printk(fmt, ##__VA_ARGS__)
+#define pr_warn(fmt, ...)	shim_printk(fmt, ##__VA_ARGS__)
+#define pr_debug(fmt, ...)	shim_printk(fmt, ##__VA_ARGS__)
+#define pr_info_ratelimited(fmt, ...) shim_printk(fmt, ##__VA_ARGS__)
+#define pr_err_ratelimited(fmt, ...) shim_printk(fmt, ##__VA_ARGS__)
+#define printk(fmt, ...)	shim_printk(fmt, ##__VA_ARGS__)
+#define dev_err(dev, fmt, ...)	shim_printk(fmt, ##__VA_ARGS__)
+#define dev_info(dev, fmt, ...)	shim_printk(fmt, ##__VA_ARGS__)
+#define dev_warn(dev, fmt, ...)	shim_printk(fmt, ##__VA_ARGS__)
+#define dev_dbg(dev, fmt, ...)	shim_printk(fmt, ##__VA_ARGS__)
+#define trace_printk(fmt, ...)	shim_printk(fmt, ##__VA_ARGS__)
+#define HZ			1000
+#define DEFINE_RATELIMIT_STATE(name, interval, burst) int name
+#define __ratelimit(rs)		1
+
+#define BUG()			abort()
+#define BUG_ON(cond)		do { if (cond) abort(); } while (0)
+#define WARN_ON(cond)		({ int __c = !!(cond); if (__c) shim_printk("WARN_ON %s\n", #cond); __c; })
+#define WARN_ON_ONCE(cond)	WARN_ON(cond)
+#define WARN(cond, fmt, ...)	({ int __c = !!(cond); if (__c) shim_printk(fmt, ##__VA_ARGS__); __c; })
+#define might_sleep()		do { } while (0)
+#define dump_stack()		do { } while (0)
+#define panic(fmt, ...)		abort()
+
+#define strlcpy(dst, src, size)	((size_t)snprintf(dst, size, "%s", src))
+#define strscpy(dst, src, size)	((ssize_t)snprintf(dst, size, "%s", src))
+#define scnprintf		snprintf
+#define vscnprintf		vsnprintf
+#define strlcat(dst, src, size) \
+	((size_t)snprintf((dst) + strlen(dst), (size) - strlen(dst), "%s", src))
+#define kstrtou32(s, b, r)	(*(r) = strtoul(s, NULL, b), 0)
+#define kstrtouint(s, b, r)	(*(r) = strtoul(s, NULL, b), 0)
+#define kstrtoint(s, b, r)	(*(r) = strtol(s, NULL, b), 0)
+#define kstrtoul(s, b, r)	(*(r) = strtoul(s, NULL, b), 0)
+#define kstrtobool(s, r)	(*(r) = !!strtol(s, NULL, 0), 0)
+
+/* module */
+#define EXPORT_SYMBOL(sym)
+#define EXPORT_SYMBOL_GPL(sym)
+#define MODULE_LICENSE(x)
+#define MODULE_DESCRIPTION(x)
+#define MODULE_SOFTDEP(x)
+#define MODULE_DEVICE_TABLE(type, name)
+#define MODULE_PARM_DESC(name, desc)
+#define module_param(name, type, perm)
+#define module_param_named(name, value, type, perm)
+#define module_init(fn)
+#define module_exit(fn)
+#define THIS_MODULE		NULL
+struct module;
+
+/* memory */
+#define GFP_KERNEL		0u
+#define GFP_ATOMIC		1u
+#define GFP_NOWAIT		2u
+#define __GFP_ZERO		4u
+#define __GFP_NOWARN		8u
+#define SLAB_HWCACHE_ALIGN	1u
+#define PAGE_SIZE		4096UL
+#define PAGE_SHIFT		12
+#define SZ_1K			0x400
+#define SZ_4K			0x1000
+#define SZ_64K			0x10000
+#define SZ_8K			0x2000
+#define SZ_1M			0x100000
+#define SZ_4M			0x400000
+
+static inline void *kmalloc(size_t size, gfp_t flags)
+{
+	return (flags & __GFP_ZERO) ? calloc(1, size) : malloc(size);
+}
+
+#define kzalloc(size, flags)	calloc(1, size)
+#define kcalloc(n, size, flags)	calloc(n, size)
+#define kmalloc_array(n, size, flags) calloc(n, size)
+#define krealloc(p, size, flags) realloc(p, size)
+#define vmalloc(size)		malloc(size)
+#define vzalloc(size)		calloc(1, size)
+#define kvzalloc(size, flags)	calloc(1, size)
+#define kfree(p)		free((void *)(p))
+#define kvfree(p)		free((void *)(p))
+#define vfree(p)		free((void *)(p))
+#define kfree_rcu(p, field)	free(p)
+#define kstrdup(s, flags)	strdup(s)
+
+static inline void *kmemdup(const void *src, size_t len, gfp_t flags)
+{
+	void *p = malloc(len);
+
+	if (p)
+		memcpy(p, src, len);
+	return p;
+}
+
+struct kmem_cache {
+	size_t size;
+};
+
+static inline struct kmem_cache *kmem_cache_create(const char *name,
+	unsigned int size, unsigned int align, unsigned int flags,
+	void (*ctor)(void *))
+{
+	struct kmem_cache *cache = calloc(1, sizeof(*cache));
+
+	if (cache)
+		cache->size = size;
+	return cache;
+}
+
+#define kmem_cache_destroy(c)	free(c)
+#define kmem_cache_alloc(c, f)	malloc((c)->size)
+#define kmem_cache_zalloc(c, f)	calloc(1, (c)->size)
+#define kmem_cache_free(c, p)	free(p)
+
+/* list */
+struct list_head {
+	struct list_head *next, *prev;
+};
+
+#define LIST_HEAD_INIT(name)	{ &(name), &(name) }
+#define LIST_HEAD(name)		struct list_head name = LIST_HEAD_INIT(name)
+
+static inline void INIT_LIST_HEAD(struct list_head *list)
+{
+	list->next = list;
+	list->prev = list;
+}
+
+static inline void __list_add(struct list_head *new, struct list_head *prev,
+	struct list_head *next)
+{
+	next->prev = new;
+	new->next = next;
+	new->prev = prev;
+	prev->next = new;
+}
+
+static inline void list_add(struct list_head *new, struct list_head *head)
+{
+	__list_add(new, head, head->next);
+}
+
+static inline void list_add_tail(struct list_head *new, struct list_head *head)
+{
+	__list_add(new, head->prev, head);
+}
+
+static inline void __list_del(struct list_head *prev, struct list_head *next)
+{
+	next->prev = prev;
+	prev->next = next;
+}
+
+static inline void list_del(struct list_head *entry)
+{
+	__list_del(entry->prev, entry->next);
+	entry->next = (void *)0x100;
+	entry->prev = (void *)0x122;
+}
+
+static inline void list_del_init(struct list_head *entry)
+{
+	__list_del(entry->prev, entry->next);
+	INIT_LIST_HEAD(entry);
+}
+
+static inline void list_move(struct list_head *list, struct list_head *head)
+{
+	__list_del(list->prev, list->next);
+	list_add(list, head);
+}
+
+static inline void list_move_tail(struct list_head *list, struct list_head *head)
+{
+	__list_del(list->prev, list->next);
+	list_add_tail(list, head);
+}
+
+static inline int list_empty(const struct list_head *head)
+{
+	return head->next == head;
+}
+
+static inline int list_is_singular(const struct list_head *head)
+{
+	return !list_empty(head) && (head->next == head->prev);
+}
+
+static inline void list_splice_tail_init(struct list_head *list,
+	struct list_head *head)
+{
+	if (list_empty(list))
+		return;
+	list->next->prev = head->prev;
+	head->prev->next = list->next;
+	list->prev->next = head;
+	head->prev = list->prev;
+	INIT_LIST_HEAD(list);
+}
+
+#define list_entry(ptr, type, member)	container_of(ptr, type, member)
+#define list_first_entry(ptr, type, member) \
+	list_entry((ptr)->next, type, member)
+#define list_last_entry(ptr, type, member) \
+	list_entry((ptr)->prev, type, member)
+#define list_first_entry_or_null(ptr, type, member) \
+	(list_empty(ptr) ? NULL : list_first_entry(ptr, type, member))
+#define list_next_entry(pos, member) \
+	list_entry((pos)->member.next, __typeof__(*(pos)), member)
+#define list_prev_entry(pos, member) \
+	list_entry((pos)->member.prev, __typeof__(*(pos)), member)
+#define list_for_each(pos, head) \
+	for (pos = (head)->next; pos != (head); pos = pos->next)
+#define list_for_each_safe(pos, n, head) \
+	for (pos = (head)->next, n = pos->next; pos != (head); \
+		pos = n, n = pos->next)
+#define list_for_each_entry(pos, head, member) \
+	for (pos = list_first_entry(head, __typeof__(*pos), member); \
+		&pos->member != (head); \
+		pos = list_next_entry(pos, member))
+#define list_for_each_entry_reverse(pos, head, member) \
+	for (pos = list_last_entry(head, __typeof__(*pos), member); \
+		&pos->member != (head); \
+		pos = list_prev_entry(pos, member))
+#define list_for_each_entry_safe(pos, n, head, member) \
+	for (pos = list_first_entry(head, __typeof__(*pos), member), \
+		n = list_next_entry(pos, member); \
+		&pos->member != (head); \
+		pos = n, n = list_next_entry(n, member))
+#define list_for_each_entry_safe_reverse(pos, n, head, member) \
+	for (pos = list_last_entry(head, __typeof__(*pos), member), \
+		n = list_prev_entry(pos, member); \
+		&pos->member != (head); \
+		pos = n, n = list_prev_entry(n, member))
+#define list_for_each_entry_rcu(pos, head, member) \
+	list_for_each_entry(pos, head, member)
+#define list_add_tail_rcu(new, head)	list_add_tail(new, head)
+#define list_del_rcu(entry)		list_del(entry)
+
+/* hlist and hashtable */
+struct hlist_node {
+	struct hlist_node *next, **pprev;
+};
+
+struct hlist_head {
+	struct hlist_node *first;
+};
+
+#define INIT_HLIST_NODE(h)	do { (h)->next = NULL; (h)->pprev = NULL; } while (0)
+
+static inline void hlist_add_head(struct hlist_node *n, struct hlist_head *h)
+{
+	struct hlist_node *first = h->first;
+
+	n->next = first;
+	if (first)
+		first->pprev = &n->next;
+	h->first = n;
+	n->pprev = &h->first;
+}
+
+static inline int hlist_unhashed(const struct hlist_node *h)
+{
+	return !h->pprev;
+}
+
+static inline void hlist_del_init(struct hlist_node *n)
+{
+	if (hlist_unhashed(n))
+		return;
+	*n->pprev = n->next;
+	if (n->next)
+		n->next->pprev = n->pprev;
+	INIT_HLIST_NODE(n);
+}
+
+#define hlist_entry_safe(ptr, type, member) \
+	({ __typeof__(ptr) ____ptr = (ptr); \
+	   ____ptr ? container_of(____ptr, type, member) : NULL; })
+#define hlist_for_each_entry(pos, head, member) \
+	for (pos = hlist_entry_safe((head)->first, __typeof__(*(pos)), member); \
+		pos; \
+		pos = hlist_entry_safe((pos)->member.next, __typeof__(*(pos)), member))
+#define hlist_for_each_entry_safe(pos, n, head, member) \
+	for (pos = hlist_entry_safe((head)->first, __typeof__(*pos), member); \
+		pos && ({ n = pos->member.next; 1; }); \
+		pos = hlist_entry_safe(n, __typeof__(*pos), member))
+
+#define GOLDEN_RATIO_64		0x61C8864680B583EBull
+
+static inline u32 hash_64(u64 val, unsigned int bits)
+{
+	return val * GOLDEN_RATIO_64 >> (64 - bits);
+}
+
+static inline u32 hash32_ptr(const void *ptr)
+{
+	unsigned long val = (unsigned long)ptr;
+
+	return (u32)(val ^ (val >> 32));
+}
+
+#define hash_long(val, bits)	hash_64(val, bits)
+#define hash_ptr(ptr, bits)	hash_64((unsigned long)(ptr), bits)
+
+#define DECLARE_HASHTABLE(name, bits)	struct hlist_head name[1 << (bits)]
+#define DEFINE_HASHTABLE(name, bits)	struct hlist_head name[1 << (bits)] = { }
+#define HASH_SIZE(name)			(ARRAY_SIZE(name))
+#define HASH_BITS(name)			ilog2(HASH_SIZE(name))
+#define hash_min(val, bits) \
+	(sizeof(val) <= 4 ? (u32)(val) * 0x61C88647 >> (32 - (bits)) : hash_64(val, bits))
+#define hash_init(table) \
+	do { size_t __i; for (__i = 0; __i < HASH_SIZE(table); __i++) \
+		(table)[__i].first = NULL; } while (0)
+#define hash_add(table, node, key) \
+	hlist_add_head(node, &(table)[hash_min(key, HASH_BITS(table))])
+#define hash_del(node)		hlist_del_init(node)
+#define hash_hashed(node)	(!hlist_unhashed(node))
+#define hash_for_each_possible(table, obj, member, key) \
+	hlist_for_each_entry(obj, &(table)[hash_min(key, HASH_BITS(table))], member)
+#define hash_for_each(table, bkt, obj, member) \
+	for ((bkt) = 0, obj = NULL; obj == NULL && (bkt) < HASH_SIZE(table); (bkt)++) \
+		hlist_for_each_entry(obj, &(table)[bkt], member)
+#define hash_for_each_safe(table, bkt, tmp, obj, member) \
+	for ((bkt) = 0, obj = NULL; obj == NULL && (bkt) < HASH_SIZE(table); (bkt)++) \
+		hlist_for_each_entry_safe(obj, tmp, &(table)[bkt], member)
+
+static inline bool __hash_empty(struct hlist_head *ht, unsigned int sz)
+{
+	unsigned int i;
+
+	for (i = 0; i < sz; i++)
+		if (ht[i].first)
+			return false;
+	return true;
+}
+
+#define hash_empty(table)	__hash_empty(table, HASH_SIZE(table))
+
+/* atomics */
+typedef struct {
+	int counter;
+} atomic_t;
+
+typedef struct {
+	s64 counter;
+} atomic64_t;
+
+#define ATOMIC_INIT(i)		{ (i) }
+#define atomic_read(v)		__atomic_load_n(&(v)->counter, __ATOMIC_SEQ_CST)
+#define atomic_set(v, i)	__atomic_store_n(&(v)->counter, i, __ATOMIC_SEQ_CST)
+#define atomic_inc(v)		((void)__atomic_add_fetch(&(v)->counter, 1, __ATOMIC_SEQ_CST))
+#define atomic_dec(v)		((void)__atomic_sub_fetch(&(v)->counter, 1, __ATOMIC_SEQ_CST))
+#define atomic_add(i, v)	((void)__atomic_add_fetch(&(v)->counter, i, __ATOMIC_SEQ_CST))
+#define atomic_sub(i, v)	((void)__atomic_sub_fetch(&(v)->counter, i, __ATOMIC_SEQ_CST))
+#define atomic_inc_return(v)	__atomic_add_fetch(&(v)->counter, 1, __ATOMIC_SEQ_CST)
+#define atomic_dec_return(v)	__atomic_sub_fetch(&(v)->counter, 1, __ATOMIC_SEQ_CST)
+#define atomic_dec_and_test(v)	(atomic_dec_return(v) == 0)
+#define atomic_xchg(v, i)	__atomic_exchange_n(&(v)->counter, i, __ATOMIC_SEQ_CST)
+#define cmpxchg(ptr, old, new) \
+	({ __typeof__(*(ptr)) __old = (old); \
+	   __atomic_compare_exchange_n(ptr, &__old, new, false, \
+		__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); __old; })
+#define atomic64_read(v)	atomic_read(v)
+#define atomic64_set(v, i)	atomic_set(v, i)
+#define atomic64_add(i, v)	atomic_add(i, v)
+#define atomic64_sub(i, v)	atomic_sub(i, v)
+#define atomic64_add_return(i, v) __atomic_add_fetch(&(v)->counter, i, __ATOMIC_SEQ_CST)
+#define atomic64_sub_return(i, v) __atomic_sub_fetch(&(v)->counter, i, __ATOMIC_SEQ_CST)
+
+struct kref {
+	atomic_t refcount;
+};
+
+#define kref_init(k)		atomic_set(&(k)->refcount, 1)
+#define kref_get(k)		atomic_inc(&(k)->refcount)
+#define kref_read(k)		atomic_read(&(k)->refcount)
+
+static inline bool kref_get_unless_zero(struct kref *kref)
+{
+	int old = atomic_read(&kref->refcount);
+
+	while (old) {
+		if (__atomic_compare_exchange_n(&kref->refcount.counter, &old,
+				old + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+			return true;
+	}
+	return false;
+}
+
+static inline int kref_put(struct kref *kref, void (*release)(struct kref *))
+{
+	if (atomic_dec_and_test(&kref->refcount)) {
+		release(kref);
+		return 1;
+	}
+	return 0;
+}
+
+/* time */
+static inline u64 shim_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#define jiffies			((unsigned long)(shim_now_ns() / 1000000ULL))
+#define msecs_to_jiffies(ms)	((unsigned long)(ms))
+#define usecs_to_jiffies(us)	((unsigned long)DIV_ROUND_UP(us, 1000))
+#define jiffies_to_msecs(j)	((unsigned int)(j))
+#define time_after(a, b)	((long)((b) - (a)) < 0)
+#define time_before(a, b)	time_after(b, a)
+#define time_after_eq(a, b)	((long)((a) - (b)) >= 0)
+#define NSEC_PER_USEC		1000L
+#define NSEC_PER_MSEC		1000000L
+#define NSEC_PER_SEC		1000000000L
+#define USEC_PER_MSEC		1000L
+#define USEC_PER_SEC		1000000L
+#define MSEC_PER_SEC		1000L
+#define ktime_get()		((ktime_t)shim_now_ns())
+#define ktime_get_ns()		shim_now_ns()
+#define ktime_get_boottime()	((ktime_t)shim_now_ns())
+#define ktime_to_ns(kt)		((s64)(kt))
+#define ktime_to_us(kt)		((s64)(kt) / 1000)
+#define ktime_to_ms(kt)		((s64)(kt) / 1000000)
+#define ktime_sub(a, b)		((a) - (b))
+#define ktime_us_delta(a, b)	ktime_to_us((a) - (b))
+#define ktime_ms_delta(a, b)	ktime_to_ms((a) - (b))
+#define ns_to_ktime(ns)		((ktime_t)(ns))
+
+struct timespec64 {
+	s64 tv_sec;
+	long tv_nsec;
+};
+
+static inline void ktime_get_real_ts64(struct timespec64 *ts)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_REALTIME, &t);
+	ts->tv_sec = t.tv_sec;
+	ts->tv_nsec = t.tv_nsec;
+}
+
+#define udelay(us)		usleep(us)
+#define usleep_range(min, max)	usleep(min)
+#define msleep(ms)		usleep((ms) * 1000)
+#define msleep_interruptible(ms) usleep((ms) * 1000)
+#define cpu_relax()		sched_yield_shim()
+#define cond_resched()		sched_yield_shim()
+#define schedule()		sched_yield_shim()
+int sched_yield_shim(void);
+
+/* locking */
+struct lock_class_key {
+	int dummy;
+};
+
+struct mutex {
+	pthread_mutex_t m;
+	volatile pthread_t owner;
+	volatile int locked;
+};
+
+#define mutex_init(lock) \
+	do { pthread_mutex_init(&(lock)->m, NULL); (lock)->locked = 0; } while (0)
+#define mutex_destroy(lock)	pthread_mutex_destroy(&(lock)->m)
+
+static inline void mutex_lock(struct mutex *lock)
+{
+	pthread_mutex_lock(&lock->m);
+	lock->owner = pthread_self();
+	lock->locked = 1;
+}
+
+static inline int mutex_trylock(struct mutex *lock)
+{
+	if (pthread_mutex_trylock(&lock->m))
+		return 0;
+	lock->owner = pthread_self();
+	lock->locked = 1;
+	return 1;
+}
+
+static inline void mutex_unlock(struct mutex *lock)
+{
+	lock->locked = 0;
+	pthread_mutex_unlock(&lock->m);
+}
+
+static inline bool mutex_is_locked(struct mutex *lock)
+{
+	return lock->locked;
+}
+
+#define lockdep_assert_held(lock) do { } while (0)
+#define lockdep_set_class(lock, key) do { } while (0)
+
+typedef struct mutex spinlock_t;
+#define spin_lock_init(lock)		mutex_init(lock)
+#define spin_lock(lock)			mutex_lock(lock)
+#define spin_unlock(lock)		mutex_unlock(lock)
+#define spin_lock_irq(lock)		mutex_lock(lock)
+#define spin_unlock_irq(lock)		mutex_unlock(lock)
+#define spin_lock_bh(lock)		mutex_lock(lock)
+#define spin_unlock_bh(lock)		mutex_unlock(lock)
+#define spin_lock_irqsave(lock, f)	do { (f) = 0; mutex_lock(lock); } while (0)
+#define spin_unlock_irqrestore(lock, f)	do { (void)(f); mutex_unlock(lock); } while (0)
+
+struct rcu_head {
+	void *next;
+	void (*func)(struct rcu_head *head);
+};
+
+#define call_rcu(head, fn)		(fn)(head)
+#define rcu_read_lock()			do { } while (0)
+#define rcu_read_unlock()		do { } while (0)
+#define synchronize_rcu()		do { } while (0)
+#define rcu_dereference(p)		(p)
+#define rcu_assign_pointer(p, v)	((p) = (v))
+#define RCU_INIT_POINTER(p, v)		((p) = (v))
+
+/* wait queues, completions */
+typedef struct {
+	pthread_mutex_t m;
+	pthread_cond_t c;
+} wait_queue_head_t;
+
+static inline void init_waitqueue_head(wait_queue_head_t *wq)
+{
+	pthread_mutex_init(&wq->m, NULL);
+	pthread_cond_init(&wq->c, NULL);
+}
+
+static inline void wake_up_all(wait_queue_head_t *wq)
+{
+	pthread_mutex_lock(&wq->m);
+	pthread_cond_broadcast(&wq->c);
+	pthread_mutex_unlock(&wq->m);
+}
+
+#define wake_up(wq)			wake_up_all(wq)
+#define wake_up_interruptible(wq)	wake_up_all(wq)
+
+/* the condition is rechecked at least every millisecond */
+#define wait_event_timeout(wq, condition, timeout) \
+({ \
+	long __ret = (long)(timeout) ? (long)(timeout) : 1; \
+	u64 __end = shim_now_ns() + (u64)(timeout) * 1000000ULL; \
+	while (!(condition)) { \
+		struct timespec __ts; \
+		if (shim_now_ns() >= __end) { \
+			__ret = (condition) ? 1 : 0; \
+			break; \
+		} \
+		clock_gettime(CLOCK_REALTIME, &__ts); \
+		__ts.tv_nsec += 1000000; \
+		if (__ts.tv_nsec >= 1000000000L) { \
+			__ts.tv_sec++; \
+			__ts.tv_nsec -= 1000000000L; \
+		} \
+		pthread_mutex_lock(&(wq).m); \
+		pthread_cond_timedwait(&(wq).c, &(wq).m, &__ts); \
+		pthread_mutex_unlock(&(wq).m); \
+	} \
+	__ret; \
+})
+#define wait_event(wq, condition)	wait_event_timeout(wq, condition, 1000000)
+
+struct completion {
+	unsigned int done;
+	wait_queue_head_t wait;
+};
+
+static inline void init_completion(struct completion *x)
+{
+	x->done = 0;
+	init_waitqueue_head(&x->wait);
+}
+
+#define reinit_completion(x)	((x)->done = 0)
+
+static inline void complete(struct completion *x)
+{
+	pthread_mutex_lock(&x->wait.m);
+	x->done++;
+	pthread_cond_broadcast(&x->wait.c);
+	pthread_mutex_unlock(&x->wait.m);
+}
+
+#define complete_all(x)		complete(x)
+
+static inline unsigned long wait_for_completion_timeout(struct completion *x,
+	unsigned long timeout)
+{
+	unsigned long ret = wait_event_timeout(x->wait, READ_ONCE(x->done), timeout);
+
+	if (ret) {
+		pthread_mutex_lock(&x->wait.m);
+		x->done--;
+		pthread_mutex_unlock(&x->wait.m);
+	}
+	return ret;
+}
+
+#define wait_for_completion(x)	wait_for_completion_timeout(x, 1000000)
+
+/* workqueues, run by one thread per queue in test/shim/kernel_shim.c */
+struct work_struct;
+typedef void (*work_func_t)(struct work_struct *work);
+
+struct workqueue_struct;
+
+struct work_struct {
+	work_func_t func;
+	struct list_head entry;
+	bool pending;
+	u64 due_ns;
+	struct workqueue_struct *wq;
+};
+
+struct delayed_work {
+	struct work_struct work;
+};
+
+#define INIT_WORK(w, fn) \
+	do { (w)->func = (fn); INIT_LIST_HEAD(&(w)->entry); \
+	     (w)->pending = false; (w)->wq = NULL; } while (0)
+#define INIT_DELAYED_WORK(dw, fn)	INIT_WORK(&(dw)->work, fn)
+#define to_delayed_work(w)		container_of(w, struct delayed_work, work)
+
+#define WQ_UNBOUND		0x2
+#define WQ_HIGHPRI		0x10
+#define WQ_MEM_RECLAIM		0x8
+
+struct workqueue_struct *alloc_workqueue(const char *fmt, unsigned int flags,
+	int max_active, ...);
+#define create_singlethread_workqueue(name)	alloc_workqueue(name, 0, 1)
+#define alloc_ordered_workqueue(name, flags, ...) alloc_workqueue(name, flags, 1)
+void destroy_workqueue(struct workqueue_struct *wq);
+void flush_workqueue(struct workqueue_struct *wq);
+bool queue_work(struct workqueue_struct *wq, struct work_struct *work);
+bool queue_delayed_work(struct workqueue_struct *wq, struct delayed_work *dwork,
+	unsigned long delay);
+bool mod_delayed_work(struct workqueue_struct *wq, struct delayed_work *dwork,
+	unsigned long delay);
+bool cancel_work_sync(struct work_struct *work);
+bool cancel_delayed_work(struct delayed_work *dwork);
+bool cancel_delayed_work_sync(struct delayed_work *dwork);
+bool flush_work(struct work_struct *work);
+bool flush_delayed_work(struct delayed_work *dwork);
+extern struct workqueue_struct *system_unbound_wq;
+extern struct workqueue_struct *system_wq;
+#define schedule_work(w)	queue_work(system_wq, w)
+#define schedule_delayed_work(dw, delay) queue_delayed_work(system_wq, dw, delay)
+#define delayed_work_pending(dw) READ_ONCE((dw)->work.pending)
+
+/* kernel threads */
+struct task_struct {
+	pthread_t thread;
+	int (*fn)(void *data);
+	void *data;
+	int ret;
+	volatile bool should_stop;
+};
+
+struct task_struct *kthread_run(int (*fn)(void *data), void *data,
+	const char *namefmt, ...);
+int kthread_stop(struct task_struct *task);
+bool kthread_should_stop(void);
+
+/* xarray, a flat table is enough for the handful of sessions tests use */
+#define XA_FLAGS_ALLOC		1
+#define XA_SHIM_SLOTS		64
+
+struct xarray {
+	unsigned long index[XA_SHIM_SLOTS];
+	void *entry[XA_SHIM_SLOTS];
+};
+
+#define xa_init_flags(xa, f)	memset(xa, 0, sizeof(*(xa)))
+#define xa_init(xa)		memset(xa, 0, sizeof(*(xa)))
+#define xa_destroy(xa)		memset(xa, 0, sizeof(*(xa)))
+#define xa_is_err(entry)	IS_ERR(entry)
+#define xa_err(entry)		(IS_ERR(entry) ? PTR_ERR(entry) : 0)
+#define xa_lock(xa)		do { } while (0)
+#define xa_unlock(xa)		do { } while (0)
+
+static inline void *xa_load(struct xarray *xa, unsigned long index)
+{
+	int i;
+
+	for (i = 0; i < XA_SHIM_SLOTS; i++)
+		if (xa->entry[i] && xa->index[i] == index)
+			return xa->entry[i];
+	return NULL;
+}
+
+static inline void *xa_erase(struct xarray *xa, unsigned long index)
+{
+	void *old;
+	int i;
+
+	for (i = 0; i < XA_SHIM_SLOTS; i++) {
+		if (xa->entry[i] && xa->index[i] == index) {
+			old = xa->entry[i];
+			xa->entry[i] = NULL;
+			return old;
+		}
+	}
+	return NULL;
+}
+
+static inline void *xa_store(struct xarray *xa, unsigned long index,
+	void *entry, gfp_t gfp)
+{
+	void *old = xa_erase(xa, index);
+	int i;
+
+	if (!entry)
+		return old;
+	for (i = 0; i < XA_SHIM_SLOTS; i++) {
+		if (!xa->entry[i]) {
+			xa->index[i] = index;
+			xa->entry[i] = entry;
+			return old;
+		}
+	}
+	return ERR_PTR(-ENOMEM);
+}
+
+static inline int xa_insert(struct xarray *xa, unsigned long index,
+	void *entry, gfp_t gfp)
+{
+	if (xa_load(xa, index))
+		return -EBUSY;
+	return PTR_ERR_OR_ZERO(xa_store(xa, index, entry, gfp));
+}
+
+#define __xa_store		xa_store
+#define __xa_erase		xa_erase
+
+/* kfifo, only embedded as a member */
+#define DECLARE_KFIFO_PTR(fifo, type) \
+	struct { type *buf; unsigned int in, out, mask; } fifo
+#define kfifo_alloc(fifo, size, gfp)	(-ENOMEM)
+#define kfifo_free(fifo)		do { } while (0)
+#define kfifo_len(fifo)			0u
+#define kfifo_avail(fifo)		0u
+#define kfifo_reset(fifo)		do { } while (0)
+#define kfifo_initialized(fifo)		0
+#define kfifo_in(fifo, buf, n)		({ (void)(buf); 0u; })
+#define kfifo_out(fifo, buf, n)		({ (void)(buf); 0u; })
+#define kfifo_out_peek(fifo, buf, n)	({ (void)(buf); 0u; })
+#define kfifo_skip_count(fifo, n)	do { } while (0)
+#define kfifo_to_user(fifo, to, len, copied) (*(copied) = 0, 0)
+
+/* sort */
+void sort(void *base, size_t num, size_t size,
+	int (*cmp)(const void *, const void *),
+	void (*swap_fn)(void *, void *, int));
+
+/* devices, resources and other opaque handles */
+struct device_node;
+struct bus_type;
+struct device_driver;
+struct device_dma_parameters {
+	unsigned int max_segment_size;
+	unsigned long segment_boundary_mask;
+};
+
+struct kobject {
+	const char *name;
+};
+
+struct device {
+	struct device_node *of_node;
+	void *driver_data;
+	struct device *parent;
+	struct kobject kobj;
+	struct device_driver *driver;
+	struct bus_type *bus;
+	struct device_dma_parameters *dma_parms;
+};
+
+struct attribute {
+	const char *name;
+	unsigned short mode;
+};
+
+struct attribute_group {
+	const char *name;
+	struct attribute **attrs;
+};
+
+struct property {
+	char *name;
+	int length;
+	void *value;
+	struct property *next;
+};
+
+#define IRQF_TRIGGER_HIGH		0x4
+#define IORESOURCE_MEM			0x200
+#define IORESOURCE_IRQ			0x400
+#define DMA_BIT_MASK(n)			(((n) == 64) ? ~0ULL : ((1ULL << (n)) - 1))
+#define for_each_property_of_node(dn, pp) \
+	for (pp = NULL; pp != NULL; pp = pp->next)
+#define set_bit(nr, addr)		(*(addr) |= BIT(nr))
+#define clear_bit(nr, addr)		(*(addr) &= ~BIT(nr))
+#define test_bit(nr, addr)		(!!(*(addr) & BIT(nr)))
+
+int sysfs_create_group(struct kobject *kobj, const struct attribute_group *grp);
+void sysfs_remove_group(struct kobject *kobj, const struct attribute_group *grp);
+void *devm_kzalloc(struct device *dev, size_t size, gfp_t gfp);
+void *devm_ioremap(struct device *dev, resource_size_t offset,
+	resource_size_t size);
+void devm_iounmap(struct device *dev, void *addr);
+int devm_request_threaded_irq(struct device *dev, unsigned int irq,
+	irqreturn_t (*handler)(int irq, void *data),
+	irqreturn_t (*thread_fn)(int irq, void *data),
+	unsigned long irqflags, const char *devname, void *dev_id);
+char *strnstr(const char *s1, const char *s2, size_t len);
+struct iommu_domain *iommu_get_domain_for_dev(struct device *dev);
+void iommu_dma_enable_best_fit_algo(struct device *dev);
+int dma_set_max_seg_size(struct device *dev, unsigned int size);
+int dma_set_seg_boundary(struct device *dev, unsigned long mask);
+int of_device_is_compatible(const struct device_node *device,
+	const char *compat);
+int of_platform_populate(struct device_node *root, const void *matches,
+	const void *lookup, struct device *parent);
+int of_property_read_string_index(const struct device_node *np,
+	const char *propname, int index, const char **output);
+int of_property_count_strings(const struct device_node *np,
+	const char *propname);
+const void *of_get_property(const struct device_node *node, const char *name,
+	int *lenp);
+struct platform_device;
+struct resource *platform_get_resource(struct platform_device *dev,
+	unsigned int type, unsigned int num);
+
+struct platform_device {
+	struct device dev;
+	const char *name;
+};
+
+struct of_device_id {
+	char compatible[128];
+	const void *data;
+};
+
+struct platform_driver {
+	int (*probe)(struct platform_device *pdev);
+	int (*remove)(struct platform_device *pdev);
+	struct {
+		const char *name;
+		const struct of_device_id *of_match_table;
+		const void *pm;
+	} driver;
+};
+
+struct resource {
+	resource_size_t start;
+	resource_size_t end;
+};
+
+struct dev_pm_ops {
+	int (*suspend)(struct device *dev);
+	int (*resume)(struct device *dev);
+};
+
+#define SET_SYSTEM_SLEEP_PM_OPS(suspend_fn, resume_fn) \
+	.suspend = suspend_fn, .resume = resume_fn,
+
+struct poll_table_struct;
+struct dma_buf;
+
+struct inode {
+	void *i_private;
+	unsigned long i_ino;
+};
+
+struct file {
+	void *private_data;
+	struct inode *f_inode;
+	long f_count;
+};
+
+struct dentry {
+	struct inode *d_inode;
+};
+
+struct file_operations {
+	void *owner;
+	int (*open)(struct inode *inode, struct file *file);
+	ssize_t (*read)(struct file *file, char __user *buf, size_t count,
+		loff_t *ppos);
+	ssize_t (*write)(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos);
+	int (*release)(struct inode *inode, struct file *file);
+	unsigned int (*poll)(struct file *file, struct poll_table_struct *pt);
+	long (*unlocked_ioctl)(struct file *file, unsigned int cmd,
+		unsigned long arg);
+};
+
+struct kernel_param;
+struct kernel_param_ops {
+	int (*set)(const char *val, const struct kernel_param *kp);
+	int (*get)(char *buffer, const struct kernel_param *kp);
+};
+
+struct kernel_param {
+	const char *name;
+	const struct kernel_param_ops *ops;
+	void *arg;
+};
+
+#define module_param_cb(name, ops, arg, perm)
+#define file_inode(f)			((f)->f_inode)
+#define file_count(f)			((f)->f_count)
+#define simple_open			NULL
+#define default_llseek			NULL
+
+struct dentry *debugfs_create_dir(const char *name, struct dentry *parent);
+struct dentry *debugfs_create_file(const char *name, unsigned short mode,
+	struct dentry *parent, void *data, const struct file_operations *fops);
+void debugfs_create_u32(const char *name, unsigned short mode,
+	struct dentry *parent, u32 *value);
+void debugfs_create_bool(const char *name, unsigned short mode,
+	struct dentry *parent, bool *value);
+void debugfs_create_u64(const char *name, unsigned short mode,
+	struct dentry *parent, u64 *value);
+void debugfs_create_x32(const char *name, unsigned short mode,
+	struct dentry *parent, u32 *value);
+void debugfs_remove_recursive(struct dentry *dentry);
+ssize_t simple_write_to_buffer(void *to, size_t available, loff_t *ppos,
+	const void __user *from, size_t count);
+ssize_t simple_read_from_buffer(void __user *to, size_t count, loff_t *ppos,
+	const void *from, size_t available);
+unsigned long copy_from_user(void *to, const void __user *from,
+	unsigned long n);
+unsigned long copy_to_user(void __user *to, const void *from,
+	unsigned long n);
+struct poll_table_struct;
+typedef struct poll_table_struct poll_table;
+struct vm_area_struct;
+struct dentry;
+struct clk;
+struct clk_hw;
+struct regulator;
+struct reset_control;
+struct icc_path;
+struct llcc_slice_desc;
+struct iommu_domain;
+struct firmware;
+struct dma_heap;
+struct mmrm_client;
+struct mmrm_client_data {
+	u32 num_hw_blocks;
+	u32 flags;
+};
+
+enum mmrm_client_type {
+	MMRM_CLIENT_CLOCK,
+};
+
+enum mmrm_client_domain {
+	MMRM_CLIENT_DOMAIN_VIDEO = 0x3,
+};
+
+enum mmrm_client_priority {
+	MMRM_CLIENT_PRIOR_HIGH = 0x1,
+	MMRM_CLIENT_PRIOR_LOW = 0x2,
+};
+
+enum mmrm_cb_type {
+	MMRM_CLIENT_RESOURCE_VALUE_CHANGE = 0x1,
+};
+
+struct mmrm_res_val_chng {
+	u32 old_val;
+	u32 new_val;
+};
+
+struct mmrm_client_notifier_data {
+	enum mmrm_cb_type cb_type;
+	union {
+		struct mmrm_res_val_chng val_chng;
+	} cb_data;
+	void *pvt_data;
+};
+
+struct mmrm_client_desc {
+	enum mmrm_client_type client_type;
+	union {
+		struct {
+			u32 client_domain;
+			u32 client_id;
+			char name[32];
+			struct clk *clk;
+		} desc;
+	} client_info;
+	enum mmrm_client_priority priority;
+	void *pvt_data;
+	int (*notifier_callback_fn)(struct mmrm_client_notifier_data *data);
+};
+
+struct mmrm_client *mmrm_client_register(struct mmrm_client_desc *desc);
+int mmrm_client_deregister(struct mmrm_client *client);
+int mmrm_client_set_value(struct mmrm_client *client,
+	struct mmrm_client_data *data, unsigned long val);
+
+struct llcc_slice_desc {
+	u32 slice_id;
+	size_t slice_size;
+};
+
+#define LLCC_VIDSC0		2
+#define LLCC_VIDSC1		3
+#define LLCC_VIDFW		17
+
+struct llcc_slice_desc *llcc_slice_getd(u32 uid);
+void llcc_slice_putd(struct llcc_slice_desc *desc);
+int llcc_slice_activate(struct llcc_slice_desc *desc);
+int llcc_slice_deactivate(struct llcc_slice_desc *desc);
+
+struct mem_buf_lend_kernel_arg {
+	unsigned int nr_acl_entries;
+	int *vmids;
+	int *perms;
+	u64 memparcel_hdl;
+};
+
+#define VMID_CP_BITSTREAM	0x19
+#define VMID_CP_PIXEL		0x1a
+#define VMID_CP_NON_PIXEL	0x1b
+#define PERM_READ		0x4
+#define PERM_WRITE		0x2
+#define PERM_EXEC		0x1
+
+int mem_buf_lend(struct dma_buf *dmabuf, struct mem_buf_lend_kernel_arg *arg);
+bool mem_buf_dma_buf_exclusive_owner(struct dma_buf *dmabuf);
+int mem_buf_dma_buf_copy_vmperm(struct dma_buf *dmabuf, int **vmids,
+	int **perms, int *nr_acl_entries);
+
+#define MEMREMAP_WC		4
+void *memremap(resource_size_t offset, size_t size, unsigned long flags);
+void memunmap(void *addr);
+
+struct firmware {
+	size_t size;
+	const u8 *data;
+};
+
+struct clk *clk_get(struct device *dev, const char *id);
+void clk_put(struct clk *clk);
+int clk_prepare_enable(struct clk *clk);
+void clk_disable_unprepare(struct clk *clk);
+long clk_round_rate(struct clk *clk, unsigned long rate);
+int clk_set_rate(struct clk *clk, unsigned long rate);
+bool __clk_is_enabled(struct clk *clk);
+struct reset_control *devm_reset_control_get(struct device *dev,
+	const char *id);
+int reset_control_assert(struct reset_control *rstc);
+int reset_control_deassert(struct reset_control *rstc);
+struct icc_path *of_icc_get(struct device *dev, const char *name);
+void icc_put(struct icc_path *path);
+int icc_set_bw(struct icc_path *path, u32 avg_bw, u32 peak_bw);
+struct regulator *regulator_get(struct device *dev, const char *id);
+void regulator_put(struct regulator *regulator);
+int regulator_enable(struct regulator *regulator);
+int regulator_disable(struct regulator *regulator);
+int regulator_is_enabled(struct regulator *regulator);
+int regulator_set_mode(struct regulator *regulator, unsigned int mode);
+unsigned int regulator_get_mode(struct regulator *regulator);
+int of_property_read_u32(const struct device_node *np, const char *name,
+	u32 *out);
+struct device_node *of_parse_phandle(const struct device_node *np,
+	const char *name, int index);
+int of_address_to_resource(struct device_node *np, int index,
+	struct resource *r);
+#define resource_size(r)	((r)->end - (r)->start + 1)
+int request_firmware(const struct firmware **fw, const char *name,
+	struct device *device);
+void release_firmware(const struct firmware *fw);
+void dev_coredumpv(struct device *dev, void *data, size_t datalen, gfp_t gfp);
+int qcom_scm_mem_protect_video_var(u32 cp_start, u32 cp_size,
+	u32 cp_nonpixel_start, u32 cp_nonpixel_size);
+int qcom_scm_pas_auth_and_reset(u32 peripheral);
+int qcom_scm_pas_shutdown(u32 peripheral);
+int qcom_mdt_load(struct device *dev, const struct firmware *fw,
+	const char *fw_name, int pas_id, void *mem_region,
+	phys_addr_t mem_phys, size_t mem_size, phys_addr_t *reloc_base);
+ssize_t qcom_mdt_get_size(const struct firmware *fw);
+void hex_dump_to_buffer(const void *buf, size_t len, int rowsize,
+	int groupsize, char *linebuf, size_t linebuflen, bool ascii);
+void disable_irq_nosync(unsigned int irq);
+void enable_irq(unsigned int irq);
+void disable_irq(unsigned int irq);
+void free_irq(unsigned int irq, void *dev_id);
+void synchronize_irq(unsigned int irq);
+void pm_stay_awake(struct device *dev);
+void pm_relax(struct device *dev);
+
+#define REGULATOR_MODE_FAST	0x1
+#define REGULATOR_MODE_NORMAL	0x2
+#define EBADHANDLE		521
+
+#define dev_get_drvdata(dev)		((dev)->driver_data)
+#define dev_set_drvdata(dev, d)		((dev)->driver_data = (d))
+#define dev_name(dev)			"msm_vidc"
+#define platform_get_drvdata(pdev)	dev_get_drvdata(&(pdev)->dev)
+#define platform_set_drvdata(pdev, d)	dev_set_drvdata(&(pdev)->dev, d)
+#define of_node_put(np)			do { } while (0)
+
+typedef u32 poll_t_shim;
+#define __poll_t		unsigned int
+#define POLLIN			0x1
+#define POLLOUT			0x4
+#define POLLERR			0x8
+#define POLLPRI			0x2
+#define POLLRDNORM		0x40
+#define POLLWRNORM		0x100
+
+/* scatterlists and dma-buf */
+struct scatterlist {
+	dma_addr_t dma_address;
+	unsigned int length;
+	unsigned int dma_length;
+};
+
+struct sg_table {
+	struct scatterlist *sgl;
+	unsigned int nents;
+	unsigned int orig_nents;
+};
+
+#define sg_dma_address(sg)	((sg)->dma_address)
+#define sg_dma_len(sg)		((sg)->dma_length)
+
+int sg_alloc_table(struct sg_table *table, unsigned int nents, gfp_t gfp);
+void sg_free_table(struct sg_table *table);
+
+enum dma_data_direction {
+	DMA_BIDIRECTIONAL = 0,
+	DMA_TO_DEVICE = 1,
+	DMA_FROM_DEVICE = 2,
+	DMA_NONE = 3,
+};
+
+#define DMA_ATTR_SKIP_CPU_SYNC		(1UL << 5)
+#define DMA_ATTR_DELAYED_UNMAP		(1UL << 16)
+#define DMA_ATTR_IOMMU_USE_UPSTREAM_HINT (1UL << 17)
+#define DMA_ATTR_IOMMU_USE_LLC_NWA	(1UL << 18)
+#define DMA_ATTR_QTI_SMMU_PROXY_MAP	(1UL << 19)
+
+struct dma_buf;
+struct dma_buf_attachment;
+
+struct dma_buf_ops {
+	int (*attach)(struct dma_buf *dmabuf, struct dma_buf_attachment *attach);
+	struct sg_table *(*map_dma_buf)(struct dma_buf_attachment *attach,
+		enum dma_data_direction dir);
+	void (*detach)(struct dma_buf *dmabuf, struct dma_buf_attachment *attach);
+	void (*unmap_dma_buf)(struct dma_buf_attachment *attach,
+		struct sg_table *table, enum dma_data_direction dir);
+	void (*release)(struct dma_buf *dmabuf);
+};
+
+struct dma_buf {
+	size_t size;
+	const struct dma_buf_ops *ops;
+	void *priv;
+	const char *name;
+	struct file *file;
+	struct kref refs;
+	void *vaddr;
+};
+
+struct dma_buf_attachment {
+	struct dma_buf *dmabuf;
+	struct device *dev;
+	unsigned long dma_map_attrs;
+	void *priv;
+};
+
+struct dma_buf_export_info {
+	const char *exp_name;
+	const struct dma_buf_ops *ops;
+	size_t size;
+	int flags;
+	void *priv;
+};
+
+struct dma_buf_map {
+	void *vaddr;
+	bool is_iomem;
+};
+
+#define DEFINE_DMA_BUF_EXPORT_INFO(name) struct dma_buf_export_info name = { 0 }
+
+struct dma_buf *dma_buf_export(const struct dma_buf_export_info *exp_info);
+int dma_buf_fd(struct dma_buf *dmabuf, int flags);
+struct dma_buf *dma_buf_get(int fd);
+void dma_buf_put(struct dma_buf *dmabuf);
+struct dma_buf_attachment *dma_buf_attach(struct dma_buf *dmabuf,
+	struct device *dev);
+void dma_buf_detach(struct dma_buf *dmabuf, struct dma_buf_attachment *attach);
+struct sg_table *dma_buf_map_attachment(struct dma_buf_attachment *attach,
+	enum dma_data_direction dir);
+void dma_buf_unmap_attachment(struct dma_buf_attachment *attach,
+	struct sg_table *table, enum dma_data_direction dir);
+int dma_buf_begin_cpu_access(struct dma_buf *dmabuf,
+	enum dma_data_direction dir);
+int dma_buf_end_cpu_access(struct dma_buf *dmabuf,
+	enum dma_data_direction dir);
+int dma_buf_begin_cpu_access_partial(struct dma_buf *dmabuf,
+	enum dma_data_direction dir, unsigned int offset, unsigned int len);
+int dma_buf_end_cpu_access_partial(struct dma_buf *dmabuf,
+	enum dma_data_direction dir, unsigned int offset, unsigned int len);
+void *dma_buf_vmap(struct dma_buf *dmabuf);
+void dma_buf_vunmap(struct dma_buf *dmabuf, void *vaddr);
+struct dma_heap *dma_heap_find(const char *name);
+void dma_heap_buffer_free(struct dma_buf *dmabuf);
+void dma_heap_put(struct dma_heap *heap);
+struct dma_buf *dma_heap_buffer_alloc(struct dma_heap *heap, size_t len,
+	unsigned int fd_flags, unsigned int heap_flags);
+/* drops the reference a dma_buf_fd() holds */
+int close_fd(unsigned int fd);
+#ifndef O_RDWR
+#define O_RDWR			02
+#endif
+#ifndef O_CLOEXEC
+#define O_CLOEXEC		02000000
+#endif
+
+/* mmio */
+#define readl_relaxed(addr)		(*(volatile u32 *)(addr))
+#define readl(addr)			(*(volatile u32 *)(addr))
+#define writel_relaxed(val, addr)	(*(volatile u32 *)(addr) = (val))
+#define writel(val, addr)		(*(volatile u32 *)(addr) = (val))
+#define readl_relaxed_poll_timeout(addr, val, cond, sleep_us, timeout_us) \
+({ \
+	u64 __end = shim_now_ns() + (u64)(timeout_us) * 1000ULL; \
+	for (;;) { \
+		(val) = readl_relaxed(addr); \
+		if (cond) \
+			break; \
+		if ((timeout_us) && shim_now_ns() > __end) \
+			break; \
+		if (sleep_us) \
+			usleep(sleep_us); \
+	} \
+	(cond) ? 0 : -ETIMEDOUT; \
+})
+
+/* tracepoints compile to nothing */
+#define TP_PROTO(args...)		args
+#define TP_ARGS(args...)		args
+#define TP_STRUCT__entry(args...)
+#define TP_fast_assign(args...)
+#define TP_printk(fmt, args...)
+#define DECLARE_EVENT_CLASS(name, proto, args, tstruct, assign, print)
+#define DEFINE_EVENT(template, name, proto, args) \
+	static inline void trace_##name(proto) { }
+#define TRACE_EVENT(name, proto, args, tstruct, assign, print) \
+	static inline void trace_##name(proto) { }
+
+/* v4l2 and vb2, only the members the driver touches */
+#define V4L2_CTRL_FLAG_EXECUTE_ON_WRITE_SHIM 0x0200
+#define VFL_TYPE_VIDEO		0
+#define VFL_DIR_M2M		2
+#define V4L2_FL_USES_V4L2_FH	1
+
+struct media_device;
+struct media_request;
+struct v4l2_m2m_dev;
+struct v4l2_m2m_ctx;
+struct v4l2_subscribed_event;
+
+struct v4l2_device {
+	char name[36];
+	struct device *dev;
+	struct media_device *mdev;
+};
+
+struct v4l2_file_operations;
+struct v4l2_ioctl_ops;
+
+struct video_device {
+	const struct v4l2_file_operations *fops;
+	struct device dev;
+	struct v4l2_device *v4l2_dev;
+	char name[32];
+	int minor;
+	u32 device_caps;
+	int vfl_dir;
+	const struct v4l2_ioctl_ops *ioctl_ops;
+	void (*release)(struct video_device *vdev);
+	unsigned long flags;
+};
+
+struct v4l2_fh {
+	struct list_head list;
+	wait_queue_head_t wait;
+	struct video_device *vdev;
+	struct v4l2_ctrl_handler *ctrl_handler;
+	struct v4l2_m2m_ctx *m2m_ctx;
+};
+
+struct v4l2_ctrl;
+
+struct v4l2_ctrl_ops {
+	int (*g_volatile_ctrl)(struct v4l2_ctrl *ctrl);
+	int (*try_ctrl)(struct v4l2_ctrl *ctrl);
+	int (*s_ctrl)(struct v4l2_ctrl *ctrl);
+};
+
+struct v4l2_ctrl_handler {
+	struct mutex _lock;
+	struct mutex *lock;
+	struct list_head ctrls;
+	int error;
+};
+
+union v4l2_ctrl_ptr {
+	s32 *p_s32;
+	s64 *p_s64;
+	u8 *p_u8;
+	u16 *p_u16;
+	u32 *p_u32;
+	char *p_char;
+	void *p;
+};
+
+struct v4l2_ctrl {
+	struct list_head node;
+	struct v4l2_ctrl_handler *handler;
+	u32 id;
+	const char *name;
+	enum v4l2_ctrl_type type;
+	s64 minimum, maximum, default_value;
+	u64 step;
+	u32 elems;
+	u32 flags;
+	u64 menu_skip_mask;
+	void *priv;
+	s32 val;
+	struct {
+		s32 val;
+	} cur;
+	union v4l2_ctrl_ptr p_new;
+	union v4l2_ctrl_ptr p_cur;
+};
+
+struct v4l2_ctrl_config {
+	const struct v4l2_ctrl_ops *ops;
+	u32 id;
+	const char *name;
+	enum v4l2_ctrl_type type;
+	s64 min;
+	s64 max;
+	u64 step;
+	s64 def;
+	u32 dims[4];
+	u32 elem_size;
+	u32 flags;
+	u64 menu_skip_mask;
+	const char * const *qmenu;
+	const s64 *qmenu_int;
+};
+
+struct vb2_queue;
+struct vb2_buffer;
+
+struct vb2_ops {
+	int (*queue_setup)(struct vb2_queue *q, unsigned int *num_buffers,
+		unsigned int *num_planes, unsigned int sizes[],
+		struct device *alloc_devs[]);
+	int (*start_streaming)(struct vb2_queue *q, unsigned int count);
+	void (*stop_streaming)(struct vb2_queue *q);
+	void (*buf_queue)(struct vb2_buffer *vb);
+	void (*buf_cleanup)(struct vb2_buffer *vb);
+	int (*buf_out_validate)(struct vb2_buffer *vb);
+	void (*buf_request_complete)(struct vb2_buffer *vb);
+};
+
+struct vb2_mem_ops {
+	void *(*alloc)(struct device *dev, unsigned long attrs, unsigned long size,
+		enum dma_data_direction dma_dir, gfp_t gfp_flags);
+	void (*put)(void *buf_priv);
+	void *(*attach_dmabuf)(struct device *dev, struct dma_buf *dbuf,
+		unsigned long size, enum dma_data_direction dma_dir);
+	void (*detach_dmabuf)(void *buf_priv);
+	int (*map_dmabuf)(void *buf_priv);
+	void (*unmap_dmabuf)(void *buf_priv);
+};
+
+#define VB2_MAX_FRAME		64
+#define VB2_MAX_PLANES		8
+
+enum vb2_memory {
+	VB2_MEMORY_UNKNOWN = 0,
+	VB2_MEMORY_MMAP = 1,
+	VB2_MEMORY_USERPTR = 2,
+	VB2_MEMORY_DMABUF = 4,
+};
+
+enum vb2_io_modes {
+	VB2_MMAP = 1,
+	VB2_USERPTR = 2,
+	VB2_READ = 4,
+	VB2_WRITE = 8,
+	VB2_DMABUF = 16,
+};
+
+enum vb2_buffer_state {
+	VB2_BUF_STATE_DEQUEUED,
+	VB2_BUF_STATE_IN_REQUEST,
+	VB2_BUF_STATE_PREPARING,
+	VB2_BUF_STATE_QUEUED,
+	VB2_BUF_STATE_ACTIVE,
+	VB2_BUF_STATE_DONE,
+	VB2_BUF_STATE_ERROR,
+};
+
+struct vb2_plane {
+	void *mem_priv;
+	struct dma_buf *dbuf;
+	unsigned int dbuf_mapped;
+	unsigned int bytesused;
+	unsigned int length;
+	unsigned int min_length;
+	union {
+		unsigned int offset;
+		unsigned long userptr;
+		int fd;
+	} m;
+	unsigned int data_offset;
+};
+
+struct vb2_buffer {
+	struct vb2_queue *vb2_queue;
+	unsigned int index;
+	unsigned int type;
+	unsigned int memory;
+	unsigned int num_planes;
+	u64 timestamp;
+	struct media_request *request;
+	enum vb2_buffer_state state;
+	struct list_head queued_entry;
+	struct list_head done_entry;
+	struct vb2_plane planes[VB2_MAX_PLANES];
+};
+
+struct vb2_v4l2_buffer {
+	struct vb2_buffer vb2_buf;
+	__u32 flags;
+	__u32 field;
+	struct v4l2_timecode timecode;
+	__u32 sequence;
+};
+
+#define to_vb2_v4l2_buffer(vb)	container_of(vb, struct vb2_v4l2_buffer, vb2_buf)
+
+struct vb2_queue {
+	unsigned int type;
+	unsigned int io_modes;
+	struct device *dev;
+	unsigned int bidirectional:1;
+	unsigned int fileio_read_once:1;
+	unsigned int fileio_write_immediately:1;
+	unsigned int allow_zero_bytesused:1;
+	unsigned int quirk_poll_must_check_waiting_for_buffers:1;
+	unsigned int supports_requests:1;
+	unsigned int requires_requests:1;
+	unsigned int uses_qbuf:1;
+	unsigned int uses_requests:1;
+	unsigned int allow_cache_hints:1;
+	unsigned int non_coherent_mem:1;
+	unsigned int copy_timestamp:1;
+	struct mutex *lock;
+	void *owner;
+	const struct vb2_ops *ops;
+	const struct vb2_mem_ops *mem_ops;
+	const void *buf_ops;
+	void *drv_priv;
+	u32 subsystem_flags;
+	unsigned int buf_struct_size;
+	u32 timestamp_flags;
+	gfp_t gfp_flags;
+	u32 min_buffers_needed;
+	struct device *alloc_devs[VB2_MAX_PLANES];
+	struct vb2_buffer *bufs[VB2_MAX_FRAME];
+	unsigned int num_buffers;
+	struct list_head queued_list;
+	unsigned int queued_count;
+	struct list_head done_list;
+	spinlock_t done_lock;
+	wait_queue_head_t done_wq;
+	unsigned int streaming:1;
+};
+
+int vb2_queue_init(struct vb2_queue *q);
+void vb2_queue_release(struct vb2_queue *q);
+void vb2_buffer_done(struct vb2_buffer *vb, enum vb2_buffer_state state);
+struct vb2_buffer *vb2_get_buffer(struct vb2_queue *q, unsigned int index);
+void *vb2_get_drv_priv(struct vb2_queue *q);
+void vb2_clear_last_buffer_dequeued(struct vb2_queue *q);
+int vb2_reqbufs(struct vb2_queue *q, struct v4l2_requestbuffers *req);
+int vb2_qbuf(struct vb2_queue *q, struct media_device *mdev,
+	struct v4l2_buffer *b);
+int vb2_dqbuf(struct vb2_queue *q, struct v4l2_buffer *b, bool nonblocking);
+int vb2_streamon(struct vb2_queue *q, enum v4l2_buf_type type);
+int vb2_streamoff(struct vb2_queue *q, enum v4l2_buf_type type);
+int v4l2_s_ctrl(struct v4l2_fh *fh, struct v4l2_ctrl_handler *hdl,
+	struct v4l2_control *ctrl);
+int v4l2_g_ctrl(struct v4l2_ctrl_handler *hdl, struct v4l2_control *ctrl);
+void poll_wait(struct file *filp, wait_queue_head_t *wait_address,
+	struct poll_table_struct *p);
+void *vb2_plane_vaddr(struct vb2_buffer *vb, unsigned int plane_no);
+static inline bool vb2_is_streaming(struct vb2_queue *q)
+{
+	return q->streaming;
+}
+
+void v4l2_fh_init(struct v4l2_fh *fh, struct video_device *vdev);
+void v4l2_fh_add(struct v4l2_fh *fh);
+void v4l2_fh_del(struct v4l2_fh *fh);
+void v4l2_fh_exit(struct v4l2_fh *fh);
+void v4l2_event_queue_fh(struct v4l2_fh *fh, const struct v4l2_event *ev);
+int v4l2_event_dequeue(struct v4l2_fh *fh, struct v4l2_event *event,
+	int nonblocking);
+int v4l2_event_pending(struct v4l2_fh *fh);
+int v4l2_event_subscribe(struct v4l2_fh *fh,
+	const struct v4l2_event_subscription *sub, unsigned int elems,
+	const void *ops);
+int v4l2_event_unsubscribe(struct v4l2_fh *fh,
+	const struct v4l2_event_subscription *sub);
+int v4l2_ctrl_handler_init(struct v4l2_ctrl_handler *hdl,
+	unsigned int nr_of_controls_hint);
+void v4l2_ctrl_handler_free(struct v4l2_ctrl_handler *hdl);
+struct v4l2_ctrl *v4l2_ctrl_new_custom(struct v4l2_ctrl_handler *hdl,
+	const struct v4l2_ctrl_config *cfg, void *priv);
+struct v4l2_ctrl *v4l2_ctrl_new_std(struct v4l2_ctrl_handler *hdl,
+	const struct v4l2_ctrl_ops *ops, u32 id, s64 min, s64 max, u64 step,
+	s64 def);
+struct v4l2_ctrl *v4l2_ctrl_new_std_menu(struct v4l2_ctrl_handler *hdl,
+	const struct v4l2_ctrl_ops *ops, u32 id, u8 max, u64 mask, u8 def);
+struct v4l2_ctrl *v4l2_ctrl_find(struct v4l2_ctrl_handler *hdl, u32 id);
+int v4l2_ctrl_handler_setup(struct v4l2_ctrl_handler *hdl);
+int v4l2_ctrl_s_ctrl(struct v4l2_ctrl *ctrl, s32 val);
+s32 v4l2_ctrl_g_ctrl(struct v4l2_ctrl *ctrl);
+void v4l2_ctrl_lock(struct v4l2_ctrl *ctrl);
+void v4l2_ctrl_unlock(struct v4l2_ctrl *ctrl);
+int v4l2_device_register(struct device *dev, struct v4l2_device *v4l2_dev);
+void v4l2_device_unregister(struct v4l2_device *v4l2_dev);
+int video_register_device(struct video_device *vdev, int type, int nr);
+void video_unregister_device(struct video_device *vdev);
+void video_set_drvdata(struct video_device *vdev, void *data);
+void *video_drvdata(struct file *file);
+struct video_device *video_devdata(struct file *file);
+
+/* remaining platform services the driver sources reference */
+int qcom_scm_set_remote_state(u32 state, u32 id);
+
+#endif /* _MSM_VIDC_KERNEL_SHIM_H_ */
@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Copyright (c) 2021, The Linux Foundation. All rights reserved.
+ */
+
+/*
+ * Host runner for the KUnit suites, prints KTAP and returns non-zero if
+ * any case failed. An optional name runs only the suite of that name.
+ * The entry point is in kunit_main.c so the harnesses linking the
+ * driver objects can bring their own.
+ */
+
+#include <kunit/test.h>
+
+#define KUNIT_SHIM_MAX_SUITES	32
+
+struct kunit_resource {
+	struct kunit_resource *next;
+};
+
+static struct kunit_suite *kunit_suites[KUNIT_SHIM_MAX_SUITES];
+static int kunit_num_suites;
+
+void kunit_shim_register(struct kunit_suite **suites)
+{
+	for (; *suites; suites++) {
+		if (kunit_num_suites == KUNIT_SHIM_MAX_SUITES) {
+			fprintf(stderr, "kunit: too many suites\n");
+			abort();
+		}
+		kunit_suites[kunit_num_suites++] = *suites;
+	}
+}
+
+void *kunit_kzalloc(struct kunit *test, size_t size, gfp_t gfp)
+{
+	struct kunit_resource *res;
+
+	res = calloc(1, sizeof(*res) + size);
+	if (!res)
+		return NULL;
+
+	res->next = test->resources;
+	test->resources = res;
+
+	return res + 1;
+}
+
+void kunit_shim_fail(struct kunit *test, bool assert, const char *file,
+	int line, const char *fmt, ...)
+{
+	va_list args;
+
+	printf("    # %s: %s failed at %s:%d\n    # ", test->name,
+		assert ? "ASSERTION" : "EXPECTATION", file, line);
+	va_start(args, fmt);
+	vprintf(fmt, args);
+	va_end(args);
+	printf("\n");
+	fflush(stdout);
+
+	__atomic_store_n(&test->failed, 1, __ATOMIC_SEQ_CST);
+	if (assert)
+		longjmp(test->abort, 1);
+}
+
+static void kunit_free_resources(struct kunit *test)
+{
+	struct kunit_resource *res, *next;
+
+	for (res = test->resources; res; res = next) {
+		next = res->next;
+		free(res);
+	}
+	test->resources = NULL;
+}
+
+static int kunit_run_suite(struct kunit_suite *suite, int index)
+{
+	struct kunit_case *tc;
+	int num_cases = 0, failed = 0, i = 0;
+
+	for (tc = suite->test_cases; tc->run_case; tc++)
+		num_cases++;
+
+	printf("    # Subtest: %s\n    1..%d\n", suite->name, num_cases);
+	for (tc = suite->test_cases; tc->run_case; tc++) {
+		struct kunit test = { .name = tc->name };
+
+		fflush(stdout);
+		if (!setjmp(test.abort)) {
+			if (suite->init && suite->init(&test)) {
+				test.failed = 1;
+				printf("    # %s: init failed\n", tc->name);
+			} else {
+				tc->run_case(&test);
+			}
+		}
+		if (suite->exit)
+			suite->exit(&test);
+		kunit_free_resources(&test);
+
+		failed |= test.failed;
+		printf("    %s %d %s\n", test.failed ? "not ok" : "ok", ++i,
+			tc->name);
+	}
+	printf("%s %d %s\n", failed ? "not ok" : "ok", index, suite->name);
+
+	return failed;
+}
+
+int kunit_shim_run(const char *name)
+{
+	int i, n = 0, failed = 0;
+
+	printf("KTAP version 1\n1..%d\n", name ? 1 : kunit_num_suites);
+	for (i = 0; i < kunit_num_suites; i++) {
+		if (name && strcmp(name, kunit_suites[i]->name))
+			continue;
+		failed |= kunit_run_suite(kunit_suites[i], ++n);
+	}
+	fflush(stdout);
+
+	return failed;
+}
@@ -0,0 +1,136 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (c) 2021, The Linux Foundation. All rights reserved.
+ */
+
+/*
+ * The subset of the KUnit API the driver suites use, so the same suite
+ * sources run in the kernel and in the host build. Failed assertions
+ * abort the case through longjmp and must only be used on the thread
+ * running the case, expectations may be used from any thread.
+ */
+
+#ifndef _MSM_VIDC_SHIM_KUNIT_TEST_H_
+#define _MSM_VIDC_SHIM_KUNIT_TEST_H_
+
+#include <setjmp.h>
+
+struct kunit_resource;
+
+struct kunit {
+	const char *name;
+	void *priv;
+	int failed;
+	jmp_buf abort;
+	struct kunit_resource *resources;
+};
+
+struct kunit_case {
+	void (*run_case)(struct kunit *test);
+	const char *name;
+};
+
+struct kunit_suite {
+	const char *name;
+	int (*init)(struct kunit *test);
+	void (*exit)(struct kunit *test);
+	struct kunit_case *test_cases;
+};
+
+#define KUNIT_CASE(test_name)	{ .run_case = test_name, .name = #test_name }
+
+void kunit_shim_register(struct kunit_suite **suites);
+int kunit_shim_run(const char *name);
+void *kunit_kzalloc(struct kunit *test, size_t size, gfp_t gfp);
+void kunit_shim_fail(struct kunit *test, bool assert, const char *file,
+	int line, const char *fmt, ...) __printf(5, 6);
+
+#define kunit_info(test, fmt, ...) \
+	printf("    # %s: " fmt, (test)->name, ##__VA_ARGS__)
+#define kunit_err(test, fmt, ...) \
+	printf("    # %s: " fmt, (test)->name, ##__VA_ARGS__)
+
+#define __kunit_test_suites(id, ...) \
+	static struct kunit_suite *__kunit_suites_##id[] = { __VA_ARGS__, NULL }; \
+	static void __attribute__((constructor)) __kunit_register_##id(void) \
+	{ \
+		kunit_shim_register(__kunit_suites_##id); \
+	}
+#define _kunit_test_suites(id, ...)	__kunit_test_suites(id, __VA_ARGS__)
+#define kunit_test_suites(...)	_kunit_test_suites(__COUNTER__, __VA_ARGS__)
+#define kunit_test_suite(suite)	kunit_test_suites(&suite)
+
+/* the expression text is taken by the public macros, before expansion */
+#define __KUNIT_BINARY(test, assert, left, op, right, text) \
+do { \
+	long long __left = (long long)(left); \
+	long long __right = (long long)(right); \
+	if (!(__left op __right)) \
+		kunit_shim_fail(test, assert, __FILE__, __LINE__, \
+			"%s, %lld vs %lld", text, __left, __right); \
+} while (0)
+
+#define __KUNIT_BOOL(test, assert, cond, want, text) \
+do { \
+	if ((bool)(cond) != (bool)(want)) \
+		kunit_shim_fail(test, assert, __FILE__, __LINE__, \
+			"%s is %s", text, (want) ? "false" : "true"); \
+} while (0)
+
+#define KUNIT_FAIL(test, fmt, ...) \
+	kunit_shim_fail(test, false, __FILE__, __LINE__, fmt, ##__VA_ARGS__)
+
+#define KUNIT_EXPECT_TRUE(test, cond)	__KUNIT_BOOL(test, false, cond, true, #cond)
+#define KUNIT_EXPECT_FALSE(test, cond)	__KUNIT_BOOL(test, false, cond, false, #cond)
+#define KUNIT_EXPECT_EQ(test, l, r) \
+	__KUNIT_BINARY(test, false, l, ==, r, #l " == " #r)
+#define KUNIT_EXPECT_NE(test, l, r) \
+	__KUNIT_BINARY(test, false, l, !=, r, #l " != " #r)
+#define KUNIT_EXPECT_LT(test, l, r) \
+	__KUNIT_BINARY(test, false, l, <, r, #l " < " #r)
+#define KUNIT_EXPECT_LE(test, l, r) \
+	__KUNIT_BINARY(test, false, l, <=, r, #l " <= " #r)
+#define KUNIT_EXPECT_GT(test, l, r) \
+	__KUNIT_BINARY(test, false, l, >, r, #l " > " #r)
+#define KUNIT_EXPECT_GE(test, l, r) \
+	__KUNIT_BINARY(test, false, l, >=, r, #l " >= " #r)
+#define KUNIT_EXPECT_PTR_EQ(test, l, r) \
+	__KUNIT_BINARY(test, false, (uintptr_t)(l), ==, (uintptr_t)(r), \
+		#l " == " #r)
+#define KUNIT_EXPECT_PTR_NE(test, l, r) \
+	__KUNIT_BINARY(test, false, (uintptr_t)(l), !=, (uintptr_t)(r), \
+		#l " != " #r)
+#define KUNIT_EXPECT_NULL(test, p) \
+	__KUNIT_BOOL(test, false, (p) == NULL, true, #p " == NULL")
+#define KUNIT_EXPECT_NOT_NULL(test, p) \
+	__KUNIT_BOOL(test, false, (p) != NULL, true, #p " != NULL")
+#define KUNIT_EXPECT_NOT_ERR_OR_NULL(test, p) \
+	__KUNIT_BOOL(test, false, IS_ERR_OR_NULL(p), false, \
+		"IS_ERR_OR_NULL(" #p ")")
+
+#define KUNIT_ASSERT_TRUE(test, cond)	__KUNIT_BOOL(test, true, cond, true, #cond)
+#define KUNIT_ASSERT_FALSE(test, cond)	__KUNIT_BOOL(test, true, cond, false, #cond)
+#define KUNIT_ASSERT_EQ(test, l, r) \
+	__KUNIT_BINARY(test, true, l, ==, r, #l " == " #r)
+#define KUNIT_ASSERT_NE(test, l, r) \
+	__KUNIT_BINARY(test, true, l, !=, r, #l " != " #r)
+#define KUNIT_ASSERT_LT(test, l, r) \
+	__KUNIT_BINARY(test, true, l, <, r, #l " < " #r)
+#define KUNIT_ASSERT_LE(test, l, r) \
+	__KUNIT_BINARY(test, true, l, <=, r, #l " <= " #r)
+#define KUNIT_ASSERT_GT(test, l, r) \
+	__KUNIT_BINARY(test, true, l, >, r, #l " > " #r)
+#define KUNIT_ASSERT_GE(test, l, r) \
+	__KUNIT_BINARY(test, true, l, >=, r, #l " >= " #r)
+#define KUNIT_ASSERT_PTR_EQ(test, l, r) \
+	__KUNIT_BINARY(test, true, (uintptr_t)(l), ==, (uintptr_t)(r), \
+		#l " == " #r)
+#define KUNIT_ASSERT_NULL(test, p) \
+	__KUNIT_BOOL(test, true, (p) == NULL, true, #p " == NULL")
+#define KUNIT_ASSERT_NOT_NULL(test, p) \
+	__KUNIT_BOOL(test, true, (p) != NULL, true, #p " != NULL")
+#define KUNIT_ASSERT_NOT_ERR_OR_NULL(test, p) \
+	__KUNIT_BOOL(test, true, IS_ERR_OR_NULL(p), false, \
+		"IS_ERR_OR_NULL(" #p ")")
+
+#endif // _MSM_VIDC_SHIM_KUNIT_TEST_H_
@@ -0,0 +1,11 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Copyright (c) 2021, The Linux Foundation. All rights reserved.
+ */
+
+#include <kunit/test.h>
+
+int main(int argc, char **argv)
+{
+	return kunit_shim_run(argc > 1 ? argv[1] : NULL) ? 1 : 0;
+}